@@ -0,0 +1,170 @@
+// Allocations of the channel-id hot paths, which compare UTF-8 ids straight
+// from the channel slots. Each case runs the current code and the QString
+// round-trip it replaced, reconstructed here as the legacy reference. The
+// current paths must not allocate; the run fails if one does.
+//
+//   hue_bench_conversions [--iterations=1000000]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "bench_options.h"
+#include "hue_aggregates.h"
+#include "hue_membership.h"
+#include "hue_model.h"
+#include "memory_probe.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+struct Measurement {
+    double nsPerCall = 0.0;
+    double allocationsPerCall = 0.0;
+};
+
+// Keeps the compiler from dropping the measured calls.
+volatile std::uint64_t g_sink = 0;
+
+Measurement measure(int iterations, const std::function<std::uint64_t(int)> &call)
+{
+    std::uint64_t sink = 0;
+    const HeapCounters before = heapCounters();
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        sink += call(i);
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    const HeapCounters delta = heapDelta(before, heapCounters());
+    g_sink = g_sink + sink;
+
+    Measurement result;
+    result.nsPerCall = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+        / iterations;
+    result.allocationsPerCall = static_cast<double>(delta.allocations) / iterations;
+    return result;
+}
+
+QJsonObject measurementJson(const Measurement &measurement)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("nsPerCall"), measurement.nsPerCall);
+    result.insert(QStringLiteral("allocationsPerCall"), measurement.allocationsPerCall);
+    return result;
+}
+
+// Channel ids as they sit in a light's and a sensor's slots. All fit the
+// small-string buffer of std::string; QString always allocates.
+const std::vector<std::string> &slotIds()
+{
+    static const std::vector<std::string> ids = {
+        "on", "bri", "ct", "color", "effect", "motion", "temperature", "illuminance", "button1", "battery",
+    };
+    return ids;
+}
+
+bool legacyTracksChannel(const QString &channelExternalId)
+{
+    return channelExternalId == QLatin1String("on")
+        || channelExternalId == QLatin1String("bri")
+        || channelExternalId == QLatin1String("motion");
+}
+
+std::optional<bool> legacyParseBoolText(const std::string &text)
+{
+    const QString normalized = QString::fromStdString(text).trimmed().toLower();
+    if (normalized == QLatin1String("1") || normalized == QLatin1String("true") || normalized == QLatin1String("on"))
+        return true;
+    if (normalized == QLatin1String("0") || normalized == QLatin1String("false") || normalized == QLatin1String("off"))
+        return false;
+    return std::nullopt;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const BenchOptions options(argc, argv);
+    const int iterations = std::max(1, options.intValue("iterations", 1000000));
+
+    const std::vector<std::string> &ids = slotIds();
+    const auto idCount = static_cast<int>(ids.size());
+    QJsonObject cases;
+    QJsonArray failures;
+    auto record = [&](const char *name, const Measurement &current, const Measurement &legacy) {
+        QJsonObject item;
+        item.insert(QStringLiteral("current"), measurementJson(current));
+        item.insert(QStringLiteral("legacy"), measurementJson(legacy));
+        cases.insert(QString::fromLatin1(name), item);
+        if (current.allocationsPerCall > 0.0)
+            failures.append(QStringLiteral("%1 allocates %2 times per call").arg(QLatin1String(name)).arg(current.allocationsPerCall));
+    };
+
+    MembershipIndex membership;
+    membership.setMembers(QStringLiteral("room-1"), QStringList{QStringLiteral("device-1")});
+    GroupAggregator aggregator(membership);
+    aggregator.refreshGroups(QStringList{QStringLiteral("room-1")});
+
+    // Filtering every slot update for aggregate-relevant channels.
+    record("tracksChannel",
+           measure(iterations, [&](int i) { return aggregator.tracksChannel(ids[i % idCount]) ? 1U : 0U; }),
+           measure(iterations, [&](int i) {
+               return legacyTracksChannel(QString::fromStdString(ids[i % idCount])) ? 1U : 0U;
+           }));
+
+    // A light reporting the value it already had: no group changes, so any
+    // allocation would be the channel id.
+    const QString device = QStringLiteral("device-1");
+    const std::string on = "on";
+    aggregator.updateDevice(device, on, 1.0);
+    record("updateDevice",
+           measure(iterations, [&](int) { return static_cast<std::uint64_t>(aggregator.updateDevice(device, on, 1.0).size()); }),
+           measure(iterations, [&](int) {
+               const QString channel = QString::fromStdString(on);
+               return static_cast<std::uint64_t>(
+                   aggregator.updateDevice(device, channel.toStdString(), 1.0).size() + channel.size());
+           }));
+
+    // String scalars of channel.invoke requests.
+    const std::vector<std::string> texts = {" true", "off", "On ", "0", "maybe"};
+    const auto textCount = static_cast<int>(texts.size());
+    record("parseBoolText",
+           measure(iterations, [&](int i) { return parseBoolText(texts[i % textCount]).value_or(false) ? 1U : 0U; }),
+           measure(iterations, [&](int i) {
+               return legacyParseBoolText(texts[i % textCount]).value_or(false) ? 1U : 0U;
+           }));
+
+    // Matching a button's control_id against the device's button channels.
+    record("buttonChannel",
+           measure(iterations, [&](int i) {
+               const std::string candidate = "button" + std::to_string(1 + i % 4);
+               return static_cast<std::uint64_t>(std::count(ids.cbegin(), ids.cend(), candidate));
+           }),
+           measure(iterations, [&](int i) {
+               const QString candidate = QStringLiteral("button%1").arg(1 + i % 4);
+               std::uint64_t matches = 0;
+               for (const std::string &id : ids)
+                   matches += QString::fromStdString(id) == candidate ? 1U : 0U;
+               return matches;
+           }));
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("conversions"));
+    report.insert(QStringLiteral("iterations"), iterations);
+    report.insert(QStringLiteral("cases"), cases);
+    report.insert(QStringLiteral("failures"), failures);
+    printReport(report);
+    return failures.isEmpty() ? 0 : 1;
+}
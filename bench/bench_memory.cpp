@@ -0,0 +1,81 @@
+// Per-device heap footprint of the parsed bridge snapshot with pooled
+// product records, against the same devices holding their own copies of
+// manufacturer, model, firmware and effect descriptors.
+//
+//   hue_bench_memory [--devices=500] [--variants=4]
+
+#include <algorithm>
+
+#include <QJsonObject>
+#include <QString>
+
+#include "bench_options.h"
+#include "hue_fixture.h"
+#include "hue_model.h"
+#include "memory_probe.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+QJsonObject heapJson(const HeapCounters &delta, int devices)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("liveBytes"), static_cast<qint64>(delta.liveBytes));
+    result.insert(QStringLiteral("allocations"), static_cast<qint64>(delta.allocations - delta.frees));
+    result.insert(QStringLiteral("bytesPerDevice"), devices > 0 ? static_cast<double>(delta.liveBytes) / devices : 0.0);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const BenchOptions options(argc, argv);
+    FixtureOptions fixtureOptions;
+    fixtureOptions.lights = std::max(1, options.intValue("devices", 500));
+    fixtureOptions.productVariants = options.intValue("variants", fixtureOptions.productVariants);
+    const BridgeFixture fixture(fixtureOptions);
+    const int devices = static_cast<int>(fixture.deviceCount());
+
+    // The pooled snapshot is built first, so it also pays for creating the
+    // shared product and channel descriptor records.
+    HeapCounters start = heapCounters();
+    const Snapshot pooled = fixture.snapshot();
+    const HeapCounters pooledDelta = heapDelta(start, heapCounters());
+
+    start = heapCounters();
+    Snapshot unpooled = fixture.snapshot();
+    for (DeviceEntry &entry : unpooled.devices) {
+        entry.device = materializeDevice(entry);
+        entry.product.reset();
+    }
+    const HeapCounters unpooledDelta = heapDelta(start, heapCounters());
+
+    std::size_t entryBytes = 0;
+    for (const DeviceEntry &entry : pooled.devices)
+        entryBytes += deviceEntryBytes(entry);
+    const ModelPoolStats pools = modelPoolStats();
+
+    QJsonObject accounted;
+    accounted.insert(QStringLiteral("deviceEntryBytes"), static_cast<qint64>(entryBytes));
+    accounted.insert(QStringLiteral("productRecords"), static_cast<qint64>(pools.productRecords));
+    accounted.insert(QStringLiteral("productRecordBytes"), static_cast<qint64>(pools.productRecordBytes));
+    accounted.insert(QStringLiteral("channelDescriptors"), static_cast<qint64>(pools.channelDescriptors));
+    accounted.insert(QStringLiteral("channelDescriptorBytes"), static_cast<qint64>(pools.channelDescriptorBytes));
+
+    const double saved = static_cast<double>(unpooledDelta.liveBytes - pooledDelta.liveBytes);
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("memory"));
+    report.insert(QStringLiteral("devices"), devices);
+    report.insert(QStringLiteral("productVariants"), fixtureOptions.productVariants);
+    report.insert(QStringLiteral("pooled"), heapJson(pooledDelta, devices));
+    report.insert(QStringLiteral("unpooled"), heapJson(unpooledDelta, devices));
+    report.insert(QStringLiteral("savedBytesPerDevice"), saved / devices);
+    report.insert(QStringLiteral("savedPercent"),
+                  unpooledDelta.liveBytes > 0 ? 100.0 * saved / static_cast<double>(unpooledDelta.liveBytes) : 0.0);
+    report.insert(QStringLiteral("accounted"), accounted);
+    printReport(report);
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Creation cost of a burst of requests. Each round issues --requests PUTs
+// without returning to the event loop, then aborts them: once on a bare
+// QNetworkAccessManager, once through HttpClient with its shared deadline
+// tracker, and once with a QTimer per reply as the client used to do. The
+// differences to the bare round are what each approach adds per request;
+// the HttpClient figure also covers building the request.
+//
+//   hue_bench_requests [--requests=10000] [--rounds=5]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+
+#include "bench_options.h"
+#include "hue_fixture.h"
+#include "hue_http.h"
+#include "memory_probe.h"
+#include "mock_bridge.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+constexpr int kTimeoutMs = 10000;
+
+struct Round {
+    double nsPerRequest = 0.0;
+    double allocationsPerRequest = 0.0;
+};
+
+void releaseReplies()
+{
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    QCoreApplication::processEvents();
+}
+
+Round measure(int requests, const std::function<void()> &issue, const std::function<void()> &abort)
+{
+    const HeapCounters before = heapCounters();
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; ++i)
+        issue();
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    const HeapCounters delta = heapDelta(before, heapCounters());
+    abort();
+    releaseReplies();
+
+    Round round;
+    round.nsPerRequest = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+        / requests;
+    round.allocationsPerRequest = static_cast<double>(delta.allocations) / requests;
+    return round;
+}
+
+// Best of all rounds, which filters out scheduler noise.
+Round best(const std::vector<Round> &rounds)
+{
+    Round result = rounds.front();
+    for (const Round &round : rounds) {
+        result.nsPerRequest = std::min(result.nsPerRequest, round.nsPerRequest);
+        result.allocationsPerRequest = std::min(result.allocationsPerRequest, round.allocationsPerRequest);
+    }
+    return result;
+}
+
+QJsonObject roundJson(const Round &round)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("nsPerRequest"), round.nsPerRequest);
+    result.insert(QStringLiteral("allocationsPerRequest"), round.allocationsPerRequest);
+    return result;
+}
+
+QJsonObject overheadJson(const Round &round, const Round &bare)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("nsPerRequest"), round.nsPerRequest - bare.nsPerRequest);
+    result.insert(QStringLiteral("allocationsPerRequest"), round.allocationsPerRequest - bare.allocationsPerRequest);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const BenchOptions options(argc, argv);
+    const int requests = std::max(1, options.intValue("requests", 10000));
+    const int rounds = std::max(1, options.intValue("rounds", 5));
+
+    FixtureOptions fixtureOptions;
+    fixtureOptions.lights = 1;
+    BridgeFixture fixture(fixtureOptions);
+    MockBridge bridge(fixture);
+    if (!bridge.listen())
+        return 2;
+
+    const ConnectionSettings settings = bridge.settings();
+    const QString lightId = fixture.ids(QStringLiteral("light")).value(0);
+    const QString path = QStringLiteral("/clip/v2/resource/light/%1").arg(lightId);
+    const QByteArray payload = QByteArrayLiteral(R"({"on":{"on":true}})");
+
+    QUrl url;
+    url.setScheme(QStringLiteral("http"));
+    url.setHost(settings.ip);
+    url.setPort(settings.port);
+    url.setPath(path);
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+    request.setRawHeader("hue-application-key", settings.appKey.toUtf8());
+
+    QNetworkAccessManager manager;
+    std::vector<QNetworkReply *> replies;
+    replies.reserve(static_cast<std::size_t>(requests));
+    auto abortReplies = [&replies]() {
+        for (QNetworkReply *reply : replies) {
+            reply->abort();
+            reply->deleteLater();
+        }
+        replies.clear();
+    };
+
+    std::vector<Round> bare;
+    std::vector<Round> tracked;
+    std::vector<Round> timerPerRequest;
+    for (int round = 0; round < rounds; ++round) {
+        bare.push_back(measure(
+            requests,
+            [&]() { replies.push_back(manager.sendCustomRequest(request, QByteArrayLiteral("PUT"), payload)); },
+            abortReplies));
+
+        HttpClient client(&manager);
+        tracked.push_back(measure(
+            requests,
+            [&]() { client.putJsonAsync(settings, path, payload); },
+            [&client]() { client.abortAll(); }));
+
+        timerPerRequest.push_back(measure(
+            requests,
+            [&]() {
+                QNetworkReply *reply = manager.sendCustomRequest(request, QByteArrayLiteral("PUT"), payload);
+                auto *timer = new QTimer(reply);
+                timer->setSingleShot(true);
+                QObject::connect(timer, &QTimer::timeout, reply, &QNetworkReply::abort);
+                QObject::connect(reply, &QNetworkReply::finished, timer, &QTimer::stop);
+                timer->start(kTimeoutMs);
+                replies.push_back(reply);
+            },
+            abortReplies));
+    }
+
+    const Round bareBest = best(bare);
+    const Round trackedBest = best(tracked);
+    const Round timerBest = best(timerPerRequest);
+
+    QJsonObject overhead;
+    overhead.insert(QStringLiteral("sharedTracker"), overheadJson(trackedBest, bareBest));
+    overhead.insert(QStringLiteral("timerPerRequest"), overheadJson(timerBest, bareBest));
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("requests"));
+    report.insert(QStringLiteral("requests"), requests);
+    report.insert(QStringLiteral("rounds"), rounds);
+    report.insert(QStringLiteral("bare"), roundJson(bareBest));
+    report.insert(QStringLiteral("sharedTracker"), roundJson(trackedBest));
+    report.insert(QStringLiteral("timerPerRequest"), roundJson(timerBest));
+    report.insert(QStringLiteral("overhead"), overhead);
+    printReport(report);
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Resident memory growth per 100 devices. Each step renders a bridge of
+// 100 more devices into poll response bodies, parses them the way a poll
+// does (chunked, element by element) and measures what the parsed snapshot
+// keeps resident. The slope over all steps is the capacity planning figure.
+//
+//   hue_bench_rss [--steps=10] [--seed=1]
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+#include "bench_options.h"
+#include "hue_fixture.h"
+#include "hue_json_stream.h"
+#include "hue_model.h"
+#include "memory_probe.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+constexpr int kStepDevices = 100;
+constexpr qsizetype kChunkBytes = 16 * 1024;
+
+constexpr const char *kResourceTypes[] = {
+    "device", "light", "motion", "tamper", "temperature", "light_level", "device_power",
+    "button", "relative_rotary", "zigbee_connectivity", "room", "zone", "scene",
+};
+
+QHash<QString, QByteArray> responseBodies(const BridgeFixture &fixture)
+{
+    QHash<QString, QByteArray> bodies;
+    for (const char *type : kResourceTypes) {
+        const QString name = QString::fromLatin1(type);
+        QJsonObject body;
+        body.insert(QStringLiteral("errors"), QJsonArray{});
+        body.insert(QStringLiteral("data"), fixture.resources(name));
+        bodies.insert(name, QJsonDocument(body).toJson(QJsonDocument::Compact));
+    }
+    return bodies;
+}
+
+QJsonArray parseBody(const QByteArray &body)
+{
+    QJsonArray items;
+    JsonArraySplitter splitter(QByteArrayLiteral("data"), [&items](const QByteArray &element) {
+        const QJsonDocument doc = QJsonDocument::fromJson(element);
+        if (!doc.isObject())
+            return false;
+        items.append(doc.object());
+        return true;
+    });
+    for (qsizetype offset = 0; offset < body.size(); offset += kChunkBytes)
+        splitter.feed(body.constData() + offset, std::min(kChunkBytes, body.size() - offset));
+    return items;
+}
+
+std::unique_ptr<Snapshot> parseSnapshot(const QHash<QString, QByteArray> &bodies)
+{
+    QHash<QString, QJsonArray> data;
+    for (auto it = bodies.cbegin(); it != bodies.cend(); ++it)
+        data.insert(it.key(), parseBody(it.value()));
+    return std::make_unique<Snapshot>(buildSnapshot(data.value(QStringLiteral("device")),
+                                                    data.value(QStringLiteral("light")),
+                                                    data.value(QStringLiteral("motion")),
+                                                    data.value(QStringLiteral("tamper")),
+                                                    data.value(QStringLiteral("temperature")),
+                                                    data.value(QStringLiteral("light_level")),
+                                                    data.value(QStringLiteral("device_power")),
+                                                    data.value(QStringLiteral("button")),
+                                                    data.value(QStringLiteral("relative_rotary")),
+                                                    data.value(QStringLiteral("zigbee_connectivity")),
+                                                    data.value(QStringLiteral("room")),
+                                                    data.value(QStringLiteral("zone")),
+                                                    data.value(QStringLiteral("scene"))));
+}
+
+// Least-squares slope of ys over xs.
+double slope(const std::vector<double> &xs, const std::vector<double> &ys)
+{
+    const double n = static_cast<double>(xs.size());
+    double sumX = 0.0;
+    double sumY = 0.0;
+    double sumXY = 0.0;
+    double sumXX = 0.0;
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+        sumX += xs[i];
+        sumY += ys[i];
+        sumXY += xs[i] * ys[i];
+        sumXX += xs[i] * xs[i];
+    }
+    const double denominator = n * sumXX - sumX * sumX;
+    return denominator != 0.0 ? (n * sumXY - sumX * sumY) / denominator : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const BenchOptions options(argc, argv);
+    const int steps = std::max(2, options.intValue("steps", 10));
+    const auto seed = static_cast<std::uint32_t>(options.intValue("seed", 1));
+
+    std::vector<double> deviceCounts;
+    std::vector<double> rssDeltas;
+    std::vector<double> heapDeltas;
+    QJsonArray points;
+    for (int step = 1; step <= steps; ++step) {
+        QHash<QString, QByteArray> bodies;
+        {
+            const BridgeFixture fixture(buildingOptions(step * kStepDevices, seed));
+            bodies = responseBodies(fixture);
+        }
+
+        releaseFreeMemory();
+        const std::size_t rssBefore = residentBytes();
+        const HeapCounters heapBefore = heapCounters();
+
+        std::unique_ptr<Snapshot> snapshot = parseSnapshot(bodies);
+        releaseFreeMemory();
+        const double rss = static_cast<double>(residentBytes()) - static_cast<double>(rssBefore);
+        const double heap = static_cast<double>(heapDelta(heapBefore, heapCounters()).liveBytes);
+        const int devices = static_cast<int>(snapshot->devices.size());
+
+        deviceCounts.push_back(devices);
+        rssDeltas.push_back(rss);
+        heapDeltas.push_back(heap);
+
+        QJsonObject point;
+        point.insert(QStringLiteral("devices"), devices);
+        point.insert(QStringLiteral("rssBytes"), rss);
+        point.insert(QStringLiteral("heapBytes"), heap);
+        points.append(point);
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("rss"));
+    report.insert(QStringLiteral("rssBytesPer100Devices"), slope(deviceCounts, rssDeltas) * kStepDevices);
+    report.insert(QStringLiteral("heapBytesPer100Devices"), slope(deviceCounts, heapDeltas) * kStepDevices);
+    report.insert(QStringLiteral("steps"), points);
+    printReport(report);
+    return 0;
+}
@@ -0,0 +1,184 @@
+// Throughput and latency of the SPSC rings behind ChannelDeltaQueue, with
+// the real record type and capacities. "singleThread" is the uncontended
+// cost of a push/pop pair. "throughput" streams --records deltas from a
+// producer to a consumer thread through the interactive ring,
+// "telemetryThroughput" does the same through the smaller telemetry ring,
+// and "latency" paces one delta every --interval-ns and measures push-to-pop
+// time. A full ring makes the producer wait, as the queue pushes back.
+// Every run also checks that records arrive in order and without gaps; a
+// violation fails the run.
+//
+//   hue_bench_spsc [--records=10000000] [--latency-records=200000]
+//                  [--interval-ns=2000]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include "bench_options.h"
+#include "hue_delta_queue.h"
+#include "hue_latency.h"
+#include "hue_spsc.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+using InteractiveRing = SpscRing<ChannelDelta, ChannelDeltaQueue::kInteractiveCapacity>;
+using TelemetryRing = SpscRing<ChannelDelta, ChannelDeltaQueue::kTelemetryCapacity>;
+
+// integer carries the sequence number, eventTs the send time.
+ChannelDelta delta(std::int64_t sequence, std::int64_t sentNs = 0)
+{
+    ChannelDelta result;
+    result.deviceHandle = static_cast<std::uint32_t>(sequence & 0xff);
+    result.channelSlot = 1;
+    result.integer = sequence;
+    result.eventTs = sentNs;
+    return result;
+}
+
+std::int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+double secondsSince(std::chrono::steady_clock::time_point started)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+QJsonObject singleThread(std::int64_t records)
+{
+    static InteractiveRing ring;
+    ChannelDelta out;
+    std::int64_t mismatches = 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (std::int64_t i = 0; i < records; ++i) {
+        ring.tryPush(delta(i));
+        if (!ring.tryPop(&out) || out.integer != i)
+            ++mismatches;
+    }
+    const double seconds = secondsSince(started);
+
+    QJsonObject result;
+    result.insert(QStringLiteral("nsPerPair"), seconds * 1e9 / static_cast<double>(records));
+    result.insert(QStringLiteral("orderViolations"), static_cast<qint64>(mismatches));
+    return result;
+}
+
+template <typename Ring>
+QJsonObject throughput(std::int64_t records)
+{
+    static Ring ring;
+    std::int64_t fullSpins = 0;
+    std::int64_t gaps = 0;
+
+    const auto started = std::chrono::steady_clock::now();
+    std::thread consumer([&ring, &gaps, records]() {
+        ChannelDelta out;
+        for (std::int64_t expected = 0; expected < records;) {
+            if (!ring.tryPop(&out)) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (out.integer != expected)
+                ++gaps;
+            expected = out.integer + 1;
+        }
+    });
+    for (std::int64_t i = 0; i < records; ++i) {
+        while (!ring.tryPush(delta(i))) {
+            ++fullSpins;
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    const double seconds = secondsSince(started);
+
+    QJsonObject result;
+    result.insert(QStringLiteral("recordsPerSecond"), static_cast<double>(records) / seconds);
+    result.insert(QStringLiteral("nsPerRecord"), seconds * 1e9 / static_cast<double>(records));
+    result.insert(QStringLiteral("producerFullSpins"), static_cast<qint64>(fullSpins));
+    result.insert(QStringLiteral("orderViolations"), static_cast<qint64>(gaps));
+    return result;
+}
+
+QJsonObject latency(std::int64_t records, std::int64_t intervalNs)
+{
+    static InteractiveRing ring;
+    LatencyHistogram histogram;
+    std::int64_t gaps = 0;
+
+    std::thread consumer([&]() {
+        ChannelDelta out;
+        for (std::int64_t expected = 0; expected < records;) {
+            if (!ring.tryPop(&out))
+                continue;
+            histogram.record(steadyNs() - out.eventTs);
+            if (out.integer != expected)
+                ++gaps;
+            expected = out.integer + 1;
+        }
+    });
+    std::int64_t dueNs = steadyNs();
+    for (std::int64_t i = 0; i < records; ++i) {
+        while (steadyNs() < dueNs) {
+        }
+        while (!ring.tryPush(delta(i, steadyNs()))) {
+        }
+        dueNs += intervalNs;
+    }
+    consumer.join();
+
+    QJsonObject result;
+    result.insert(QStringLiteral("p50Ns"), static_cast<qint64>(histogram.quantile(0.50)));
+    result.insert(QStringLiteral("p99Ns"), static_cast<qint64>(histogram.quantile(0.99)));
+    result.insert(QStringLiteral("p999Ns"), static_cast<qint64>(histogram.quantile(0.999)));
+    result.insert(QStringLiteral("maxNs"), static_cast<qint64>(histogram.max()));
+    result.insert(QStringLiteral("orderViolations"), static_cast<qint64>(gaps));
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const BenchOptions options(argc, argv);
+    const std::int64_t records = std::max(1, options.intValue("records", 10000000));
+    const std::int64_t latencyRecords = std::max(1, options.intValue("latency-records", 200000));
+    const std::int64_t intervalNs = std::max(0, options.intValue("interval-ns", 2000));
+
+    QJsonObject cases;
+    cases.insert(QStringLiteral("singleThread"), singleThread(records));
+    cases.insert(QStringLiteral("throughput"), throughput<InteractiveRing>(records));
+    cases.insert(QStringLiteral("telemetryThroughput"), throughput<TelemetryRing>(records));
+    cases.insert(QStringLiteral("latency"), latency(latencyRecords, intervalNs));
+
+    QJsonArray failures;
+    for (auto it = cases.constBegin(); it != cases.constEnd(); ++it) {
+        const QJsonObject item = it.value().toObject();
+        if (item.value(QStringLiteral("orderViolations")).toInteger() > 0)
+            failures.append(QStringLiteral("%1 delivered records out of order or with gaps").arg(it.key()));
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("spsc"));
+    report.insert(QStringLiteral("records"), static_cast<qint64>(records));
+    report.insert(QStringLiteral("interactiveCapacity"), static_cast<qint64>(InteractiveRing::capacity()));
+    report.insert(QStringLiteral("telemetryCapacity"), static_cast<qint64>(TelemetryRing::capacity()));
+    report.insert(QStringLiteral("cases"), cases);
+    report.insert(QStringLiteral("failures"), failures);
+    printReport(report);
+    return failures.isEmpty() ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+// Replays a representative workload against the mock bridge with stageTiming
+// on and reports the per-stage times: initial sync, event bursts, scene and
+// room command storms, device churn and a host reconnect halfway through. It
+// is the PGO training run (target hue_pgo_train) and the before/after
+// comparison: pass the report of one build as --baseline to the other.
+//
+//   hue_bench_stages [--devices=200] [--rounds=40] [--events=100]
+//                    [--storm=40] [--seed=1] [--baseline=report.json]
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+
+#include "bench_options.h"
+#include "bridge_traffic.h"
+#include "hue_fixture.h"
+#include "instance_driver.h"
+#include "mock_bridge.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+constexpr int kRoundMs = 200;
+constexpr int kSettleTimeoutMs = 10000;
+constexpr int kPollIntervalMs = 1000;
+
+void pumpEvents(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+bool settle(const InstanceDriver &driver)
+{
+    for (int waited = 0; waited < kSettleTimeoutMs; waited += kRoundMs) {
+        if (driver.connected() && driver.deviceCount() > 0)
+            return true;
+        pumpEvents(kRoundMs);
+    }
+    return false;
+}
+
+// memoryFootprint rounds avgUs to whole microseconds; recompute it.
+QJsonObject stageReport(const QJsonObject &stages)
+{
+    QJsonObject result;
+    for (auto it = stages.constBegin(); it != stages.constEnd(); ++it) {
+        const QJsonObject stage = it.value().toObject();
+        const double count = stage.value(QStringLiteral("count")).toDouble();
+        const double totalUs = stage.value(QStringLiteral("totalUs")).toDouble();
+        QJsonObject item;
+        item.insert(QStringLiteral("count"), count);
+        item.insert(QStringLiteral("totalUs"), totalUs);
+        item.insert(QStringLiteral("avgUs"), count > 0.0 ? totalUs / count : 0.0);
+        item.insert(QStringLiteral("maxUs"), stage.value(QStringLiteral("maxUs")));
+        result.insert(it.key(), item);
+    }
+    return result;
+}
+
+QJsonObject compare(const QJsonObject &baseline, const QJsonObject &report)
+{
+    const QJsonObject before = baseline.value(QStringLiteral("stages")).toObject();
+    const QJsonObject after = report.value(QStringLiteral("stages")).toObject();
+    QJsonObject stages;
+    for (auto it = after.constBegin(); it != after.constEnd(); ++it) {
+        if (!before.contains(it.key()))
+            continue;
+        const double beforeUs = before.value(it.key()).toObject().value(QStringLiteral("avgUs")).toDouble();
+        const double afterUs = it.value().toObject().value(QStringLiteral("avgUs")).toDouble();
+        QJsonObject item;
+        item.insert(QStringLiteral("baselineAvgUs"), beforeUs);
+        item.insert(QStringLiteral("avgUs"), afterUs);
+        if (beforeUs > 0.0)
+            item.insert(QStringLiteral("change"), (afterUs - beforeUs) / beforeUs);
+        stages.insert(it.key(), item);
+    }
+    return stages;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const BenchOptions options(argc, argv);
+    const int devices = std::max(20, options.intValue("devices", 200));
+    const int rounds = std::max(2, options.intValue("rounds", 40));
+    const int events = std::max(0, options.intValue("events", 100));
+    const int storm = std::max(0, options.intValue("storm", 40));
+    const auto seed = static_cast<std::uint32_t>(options.intValue("seed", 1));
+    const QString baselinePath = options.stringValue("baseline");
+
+    QJsonObject baseline;
+    if (!baselinePath.isEmpty()) {
+        QFile file(baselinePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::cerr << "hue-bench-stages cannot read " << baselinePath.toStdString() << '\n';
+            return 2;
+        }
+        baseline = QJsonDocument::fromJson(file.readAll()).object();
+    }
+
+    BridgeFixture fixture(buildingOptions(devices, seed));
+    MockBridge bridge(fixture);
+    QString error;
+    if (!bridge.listen(&error)) {
+        std::cerr << "hue-bench-stages mock bridge: " << error.toStdString() << '\n';
+        return 2;
+    }
+
+    QJsonObject meta = bridge.meta();
+    meta.insert(QStringLiteral("stageTiming"), true);
+    meta.insert(QStringLiteral("pollIntervalMs"), kPollIntervalMs);
+
+    InstanceDriver driver;
+    driver.start();
+    driver.configure(meta);
+    if (!settle(driver)) {
+        std::cerr << "hue-bench-stages instance never synced with the mock bridge" << '\n';
+        return 2;
+    }
+
+    BridgeTraffic traffic(fixture, bridge, driver, seed);
+    for (int round = 1; round <= rounds; ++round) {
+        traffic.step(events);
+        if (round % 5 == 0)
+            traffic.commandStorm(storm);
+        if (round % 10 == 0)
+            traffic.churn();
+        if (round == rounds / 2) {
+            driver.reconnectHost(meta);
+            if (!settle(driver)) {
+                std::cerr << "hue-bench-stages instance did not resync after the reconnect" << '\n';
+                return 1;
+            }
+        }
+        pumpEvents(kRoundMs);
+    }
+
+    const QJsonObject stageTiming = driver.memoryFootprint().value(QStringLiteral("stageTiming")).toObject();
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("stages"));
+    report.insert(QStringLiteral("devices"), static_cast<qint64>(fixture.deviceCount()));
+    report.insert(QStringLiteral("rounds"), rounds);
+    report.insert(QStringLiteral("eventsPerRound"), events);
+    report.insert(QStringLiteral("stormCommands"), storm);
+    report.insert(QStringLiteral("stages"), stageReport(stageTiming.value(QStringLiteral("stages")).toObject()));
+    if (!baseline.isEmpty())
+        report.insert(QStringLiteral("comparison"), compare(baseline, report));
+    printReport(report);
+    return 0;
+}
@@ -0,0 +1,254 @@
+// Cost of the coroutine task layer against the callback chains it replaced.
+// "frames" runs multi-step flows whose steps complete synchronously, so only
+// the coroutine frames (or std::function hops) are measured. "requests" runs
+// --flows flows of --steps sequential GETs against the mock bridge, once as a
+// Task awaiting each request and once as nested requestAsync callbacks.
+//
+//   hue_bench_tasks [--flows=1000] [--steps=3] [--rounds=5]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QObject>
+#include <QTimer>
+
+#include "bench_options.h"
+#include "hue_fixture.h"
+#include "hue_http.h"
+#include "hue_task.h"
+#include "memory_probe.h"
+#include "mock_bridge.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+constexpr int kTimeoutMs = 10000;
+constexpr int kRunLimitMs = 120000;
+
+struct Round {
+    double nsPerFlow = 0.0;
+    double allocationsPerFlow = 0.0;
+    int failedFlows = 0;
+};
+
+// Starts every flow, then spins the event loop until the last one reports.
+Round measure(int flows, const std::function<void(std::function<void(bool)>)> &startFlow)
+{
+    int pending = flows;
+    int failed = 0;
+    QEventLoop loop;
+    auto finished = [&](bool ok) {
+        if (!ok)
+            ++failed;
+        if (--pending == 0)
+            loop.quit();
+    };
+
+    const HeapCounters before = heapCounters();
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < flows; ++i)
+        startFlow(finished);
+    if (pending > 0) {
+        QTimer::singleShot(kRunLimitMs, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    const HeapCounters delta = heapDelta(before, heapCounters());
+
+    Round round;
+    round.nsPerFlow = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+        / flows;
+    round.allocationsPerFlow = static_cast<double>(delta.allocations) / flows;
+    round.failedFlows = failed + pending;
+    return round;
+}
+
+Round best(const std::vector<Round> &rounds)
+{
+    Round result = rounds.front();
+    for (const Round &round : rounds) {
+        result.nsPerFlow = std::min(result.nsPerFlow, round.nsPerFlow);
+        result.allocationsPerFlow = std::min(result.allocationsPerFlow, round.allocationsPerFlow);
+        result.failedFlows = std::max(result.failedFlows, round.failedFlows);
+    }
+    return result;
+}
+
+QJsonObject roundJson(const Round &round, int steps)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("nsPerFlow"), round.nsPerFlow);
+    result.insert(QStringLiteral("nsPerStep"), round.nsPerFlow / steps);
+    result.insert(QStringLiteral("allocationsPerFlow"), round.allocationsPerFlow);
+    result.insert(QStringLiteral("allocationsPerStep"), round.allocationsPerFlow / steps);
+    result.insert(QStringLiteral("failedFlows"), round.failedFlows);
+    return result;
+}
+
+QJsonObject overheadJson(const Round &coroutine, const Round &callback, int steps)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("nsPerStep"), (coroutine.nsPerFlow - callback.nsPerFlow) / steps);
+    result.insert(QStringLiteral("allocationsPerStep"),
+                  (coroutine.allocationsPerFlow - callback.allocationsPerFlow) / steps);
+    return result;
+}
+
+// Synchronous flows: the step stands in for a lookup that is already cached.
+Task<int> frameStep(int value)
+{
+    co_return value + 1;
+}
+
+Task<int> frameFlow(int steps)
+{
+    int value = 0;
+    for (int i = 0; i < steps; ++i)
+        value = co_await frameStep(value);
+    co_return value;
+}
+
+void frameStepCallback(int value, const std::function<void(int)> &done)
+{
+    done(value + 1);
+}
+
+void frameFlowCallback(int steps, int value, std::function<void(int)> done)
+{
+    if (steps == 0) {
+        done(value);
+        return;
+    }
+    frameStepCallback(value, [steps, done = std::move(done)](int next) mutable {
+        frameFlowCallback(steps - 1, next, std::move(done));
+    });
+}
+
+// Bridge flows: each step is one GET, as in resolveLightResource. The token
+// is shared by all flows like an instance's task token.
+Task<bool> requestFlow(const HttpClient &http, ConnectionSettings settings, QString path, int steps, CancelToken token)
+{
+    bool ok = true;
+    for (int i = 0; i < steps; ++i) {
+        const HttpResult result = co_await awaitRequest(http,
+                                                        settings,
+                                                        QByteArrayLiteral("GET"),
+                                                        path,
+                                                        {},
+                                                        true,
+                                                        kTimeoutMs,
+                                                        token);
+        ok = ok && result.ok;
+    }
+    co_return ok;
+}
+
+void requestFlowCallback(const HttpClient &http,
+                         const ConnectionSettings &settings,
+                         const QString &path,
+                         int steps,
+                         bool ok,
+                         std::function<void(bool)> done)
+{
+    if (steps == 0) {
+        done(ok);
+        return;
+    }
+    const QNetworkReply *reply = http.requestAsync(
+        settings,
+        QByteArrayLiteral("GET"),
+        path,
+        {},
+        true,
+        kTimeoutMs,
+        [&http, settings, path, steps, ok, done](const HttpResult &result) {
+            requestFlowCallback(http, settings, path, steps - 1, ok && result.ok, done);
+        });
+    if (!reply)
+        done(false);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const BenchOptions options(argc, argv);
+    const int flows = std::max(1, options.intValue("flows", 1000));
+    const int steps = std::max(1, options.intValue("steps", 3));
+    const int rounds = std::max(1, options.intValue("rounds", 5));
+
+    FixtureOptions fixtureOptions;
+    fixtureOptions.lights = 1;
+    BridgeFixture fixture(fixtureOptions);
+    MockBridge bridge(fixture);
+    if (!bridge.listen())
+        return 2;
+
+    const ConnectionSettings settings = bridge.settings();
+    const QString path =
+        QStringLiteral("/clip/v2/resource/light/%1").arg(fixture.ids(QStringLiteral("light")).value(0));
+
+    QNetworkAccessManager manager;
+    HttpClient http(&manager);
+    QObject context;
+    const CancelToken token;
+
+    std::vector<Round> frameCoroutine;
+    std::vector<Round> frameCallback;
+    std::vector<Round> requestCoroutine;
+    std::vector<Round> requestCallback;
+    for (int round = 0; round < rounds; ++round) {
+        frameCoroutine.push_back(measure(flows, [&](std::function<void(bool)> finished) {
+            frameFlow(steps).start(&context, [finished, steps](int value) { finished(value == steps); });
+        }));
+        frameCallback.push_back(measure(flows, [&](std::function<void(bool)> finished) {
+            frameFlowCallback(steps, 0, [finished, steps](int value) { finished(value == steps); });
+        }));
+        requestCoroutine.push_back(measure(flows, [&](std::function<void(bool)> finished) {
+            requestFlow(http, settings, path, steps, token).start(&context, finished);
+        }));
+        requestCallback.push_back(measure(flows, [&](std::function<void(bool)> finished) {
+            requestFlowCallback(http, settings, path, steps, true, finished);
+        }));
+    }
+
+    const Round frameCoroutineBest = best(frameCoroutine);
+    const Round frameCallbackBest = best(frameCallback);
+    const Round requestCoroutineBest = best(requestCoroutine);
+    const Round requestCallbackBest = best(requestCallback);
+
+    QJsonObject frames;
+    frames.insert(QStringLiteral("coroutine"), roundJson(frameCoroutineBest, steps));
+    frames.insert(QStringLiteral("callback"), roundJson(frameCallbackBest, steps));
+    frames.insert(QStringLiteral("overhead"), overheadJson(frameCoroutineBest, frameCallbackBest, steps));
+
+    QJsonObject requests;
+    requests.insert(QStringLiteral("coroutine"), roundJson(requestCoroutineBest, steps));
+    requests.insert(QStringLiteral("callback"), roundJson(requestCallbackBest, steps));
+    requests.insert(QStringLiteral("overhead"), overheadJson(requestCoroutineBest, requestCallbackBest, steps));
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("tasks"));
+    report.insert(QStringLiteral("flows"), flows);
+    report.insert(QStringLiteral("steps"), steps);
+    report.insert(QStringLiteral("rounds"), rounds);
+    report.insert(QStringLiteral("frames"), frames);
+    report.insert(QStringLiteral("requests"), requests);
+    printReport(report);
+
+    const bool failed = frameCoroutineBest.failedFlows > 0 || frameCallbackBest.failedFlows > 0
+        || requestCoroutineBest.failedFlows > 0 || requestCallbackBest.failedFlows > 0;
+    return failed ? 1 : 0;
+}
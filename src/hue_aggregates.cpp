@@ -0,0 +1,144 @@
+#include "hue_aggregates.h"
+
+#include <algorithm>
+
+namespace phicore::hue::ipc {
+
+GroupAggregator::GroupAggregator(const MembershipIndex &membership)
+    : m_membership(membership)
+{
+}
+
+void GroupAggregator::refreshGroups(const QStringList &groupExternalIds)
+{
+    for (const QString &groupExternalId : groupExternalIds) {
+        if (!m_membership.contains(groupExternalId)) {
+            m_totals.remove(groupExternalId);
+            continue;
+        }
+        Totals totals;
+        for (const QString &deviceExternalId : m_membership.members(groupExternalId)) {
+            const auto contribution = m_contributions.constFind(deviceExternalId);
+            if (contribution != m_contributions.cend())
+                apply(&totals, contribution.value(), 1);
+        }
+        m_totals.insert(groupExternalId, totals);
+    }
+}
+
+void GroupAggregator::clear()
+{
+    m_contributions.clear();
+    m_totals.clear();
+}
+
+bool GroupAggregator::tracksChannel(std::string_view channelExternalId) const
+{
+    return channelExternalId == "on" || channelExternalId == "bri" || channelExternalId == "motion";
+}
+
+QStringList GroupAggregator::updateDevice(const QString &deviceExternalId,
+                                          std::string_view channelExternalId,
+                                          double value)
+{
+    const Contribution before = m_contributions.value(deviceExternalId);
+    Contribution after = before;
+    if (!assign(&after, channelExternalId, value) || after == before)
+        return {};
+    m_contributions.insert(deviceExternalId, after);
+    return applyChange(deviceExternalId, before, after);
+}
+
+QStringList GroupAggregator::replaceDevice(const QString &deviceExternalId,
+                                           const std::vector<std::pair<std::string_view, double>> &channelValues)
+{
+    Contribution after;
+    for (const auto &[channelExternalId, value] : channelValues)
+        assign(&after, channelExternalId, value);
+
+    const Contribution before = m_contributions.value(deviceExternalId);
+    if (after == before)
+        return {};
+    if (after == Contribution{})
+        m_contributions.remove(deviceExternalId);
+    else
+        m_contributions.insert(deviceExternalId, after);
+    return applyChange(deviceExternalId, before, after);
+}
+
+QStringList GroupAggregator::removeDevice(const QString &deviceExternalId)
+{
+    const auto it = m_contributions.constFind(deviceExternalId);
+    if (it == m_contributions.cend())
+        return {};
+    const Contribution before = it.value();
+    m_contributions.erase(it);
+    return applyChange(deviceExternalId, before, Contribution{});
+}
+
+AggregateValues GroupAggregator::values(const QString &groupExternalId) const
+{
+    AggregateValues out;
+    const auto it = m_totals.constFind(groupExternalId);
+    if (it == m_totals.cend())
+        return out;
+
+    const Totals &totals = it.value();
+    out.hasLights = totals.lights > 0;
+    out.anyOn = totals.on > 0;
+    out.averageBrightness = totals.brightnessCount > 0 ? totals.brightnessSum / totals.brightnessCount : 0.0;
+    out.hasMotionSensors = totals.motionSensors > 0;
+    out.motion = totals.motion > 0;
+    return out;
+}
+
+bool GroupAggregator::assign(Contribution *contribution, std::string_view channelExternalId, double value)
+{
+    if (channelExternalId == "on") {
+        contribution->hasOn = true;
+        contribution->on = value != 0.0;
+    } else if (channelExternalId == "bri") {
+        contribution->hasBrightness = true;
+        contribution->brightness = std::clamp(value, 0.0, 100.0);
+    } else if (channelExternalId == "motion") {
+        contribution->hasMotion = true;
+        contribution->motion = value != 0.0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void GroupAggregator::apply(Totals *totals, const Contribution &contribution, int sign)
+{
+    if (contribution.hasOn) {
+        totals->lights += sign;
+        if (contribution.on) {
+            totals->on += sign;
+            if (contribution.hasBrightness) {
+                totals->brightnessCount += sign;
+                totals->brightnessSum += sign * contribution.brightness;
+            }
+        }
+    }
+    if (contribution.hasMotion) {
+        totals->motionSensors += sign;
+        if (contribution.motion)
+            totals->motion += sign;
+    }
+}
+
+QStringList GroupAggregator::applyChange(const QString &deviceExternalId,
+                                         const Contribution &before,
+                                         const Contribution &after)
+{
+    const QStringList groups = m_membership.groupsForDevice(deviceExternalId);
+    for (const QString &groupExternalId : groups) {
+        Totals &totals = m_totals[groupExternalId];
+        apply(&totals, before, -1);
+        apply(&totals, after, 1);
+    }
+    return groups;
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "hue_membership.h"
+
+namespace phicore::hue::ipc {
+
+struct AggregateValues {
+    bool hasLights = false;
+    bool anyOn = false;
+    double averageBrightness = 0.0;
+    bool hasMotionSensors = false;
+    bool motion = false;
+
+    bool operator==(const AggregateValues &other) const = default;
+};
+
+// Per room/zone aggregate state. Member contributions are cached per device
+// and applied as deltas through the membership index's device -> groups
+// direction, so a single channel change only touches the groups that contain
+// the device.
+class GroupAggregator
+{
+public:
+    explicit GroupAggregator(const MembershipIndex &membership);
+
+    // Recomputes the totals of groups whose membership changed.
+    void refreshGroups(const QStringList &groupExternalIds);
+    void clear();
+
+    // Channel ids are compared as UTF-8, straight from the channel slots.
+    QStringList updateDevice(const QString &deviceExternalId, std::string_view channelExternalId, double value);
+    // Sets the device's whole contribution from a snapshot; a tracked
+    // channel missing from channelValues no longer counts.
+    QStringList replaceDevice(const QString &deviceExternalId,
+                              const std::vector<std::pair<std::string_view, double>> &channelValues);
+    QStringList removeDevice(const QString &deviceExternalId);
+
+    bool tracksChannel(std::string_view channelExternalId) const;
+    AggregateValues values(const QString &groupExternalId) const;
+
+private:
+    struct Contribution {
+        bool hasOn = false;
+        bool on = false;
+        bool hasBrightness = false;
+        double brightness = 0.0;
+        bool hasMotion = false;
+        bool motion = false;
+
+        bool operator==(const Contribution &other) const = default;
+    };
+
+    struct Totals {
+        int lights = 0;
+        int on = 0;
+        int brightnessCount = 0;
+        double brightnessSum = 0.0;
+        int motionSensors = 0;
+        int motion = 0;
+    };
+
+    static bool assign(Contribution *contribution, std::string_view channelExternalId, double value);
+    static void apply(Totals *totals, const Contribution &contribution, int sign);
+    QStringList applyChange(const QString &deviceExternalId, const Contribution &before, const Contribution &after);
+
+    const MembershipIndex &m_membership;
+    QHash<QString, Contribution> m_contributions;
+    QHash<QString, Totals> m_totals;
+};
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,597 @@
+#include "hue_bridge_session.h"
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkRequest>
+#include <QStringList>
+#include <QUrl>
+#if QT_CONFIG(ssl)
+#include <QSslConfiguration>
+#include <QSslSocket>
+#endif
+
+#include "hue_clock.h"
+#include "hue_footprint.h"
+#include "hue_json_stream.h"
+#include "hue_stage_timer.h"
+
+namespace phicore::hue::ipc {
+
+namespace {
+
+constexpr int kTickIntervalMs = 250;
+constexpr int kEventStreamFastRetryMs = 2000;
+constexpr int kEventStreamFastRetryAttempts = 5;
+constexpr int kEventStreamPollIntervalMs = 60000;
+
+std::mutex g_registryMutex;
+QHash<QString, std::weak_ptr<BridgeSession>> g_registry;
+
+std::int64_t nowMs()
+{
+    return wallClockMs();
+}
+
+QString extractHueError(const QByteArray &payload)
+{
+    const QJsonDocument doc = QJsonDocument::fromJson(payload);
+    if (!doc.isObject())
+        return {};
+
+    const QJsonArray errors = doc.object().value(QStringLiteral("errors")).toArray();
+    if (!errors.isEmpty()) {
+        const QString description = errors.first().toObject().value(QStringLiteral("description")).toString();
+        if (!description.isEmpty())
+            return description;
+    }
+    return {};
+}
+
+QString sortedNames(const QSet<QString> &names)
+{
+    QStringList list(names.cbegin(), names.cend());
+    list.sort();
+    return list.join(QLatin1Char(','));
+}
+
+QString filterKey(const SyncFilter &filter)
+{
+    return sortedNames(filter.resourceTypes) + QLatin1Char('|') + sortedNames(filter.channelIds);
+}
+
+} // namespace
+
+std::shared_ptr<BridgeSession> BridgeSession::acquire(const ConnectionSettings &settings)
+{
+    const QString key = keyFor(settings);
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    if (std::shared_ptr<BridgeSession> existing = g_registry.value(key).lock())
+        return existing;
+
+    std::shared_ptr<BridgeSession> session(new BridgeSession(settings), [](BridgeSession *s) { s->release(); });
+    g_registry.insert(key, session);
+    return session;
+}
+
+QString BridgeSession::keyFor(const ConnectionSettings &settings)
+{
+    const int port = settings.port > 0 ? settings.port : (settings.useTls ? 443 : 80);
+    return QStringLiteral("%1://%2:%3#%4")
+        .arg(settings.useTls ? QStringLiteral("https") : QStringLiteral("http"),
+             HttpClient::effectiveHost(settings).toLower())
+        .arg(port)
+        .arg(settings.appKey.trimmed());
+}
+
+BridgeSession::BridgeSession(const ConnectionSettings &settings)
+    : m_key(keyFor(settings))
+    , m_settings(settings)
+{
+    if (m_settings.port <= 0)
+        m_settings.port = m_settings.useTls ? 443 : 80;
+
+    m_tickTimer.setInterval(kTickIntervalMs);
+    m_tickTimer.setSingleShot(false);
+    QObject::connect(&m_tickTimer, &QTimer::timeout, &m_tickTimer, [this]() {
+        tick();
+    });
+}
+
+BridgeSession::~BridgeSession()
+{
+    m_tickTimer.stop();
+    stopEventStream();
+    m_http.abortAll();
+
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    auto it = g_registry.find(m_key);
+    if (it != g_registry.end() && it->expired())
+        g_registry.erase(it);
+}
+
+void BridgeSession::release()
+{
+    // The last owner let go from inside a poll's nested event loop; the poll
+    // still runs on this object, so deletion waits until it has unwound.
+    if (m_polling) {
+        m_released = true;
+        return;
+    }
+    delete this;
+}
+
+std::uint64_t BridgeSession::subscribe(BridgeSubscriber subscriber)
+{
+    const std::uint64_t id = m_nextSubscriberId++;
+    auto inserted = m_subscribers.emplace(id, std::move(subscriber));
+    const BridgeSubscriber &added = inserted.first->second;
+
+    // A late subscriber needs the current snapshot, not the next interval's.
+    m_nextPollDueMs = 0;
+    if (m_connected && added.onConnectionState)
+        deliver(added, [fn = added.onConnectionState]() { fn(true); });
+    if (!m_tickTimer.isActive())
+        m_tickTimer.start();
+    return id;
+}
+
+void BridgeSession::unsubscribe(std::uint64_t id)
+{
+    m_subscribers.erase(id);
+    if (!m_subscribers.empty())
+        return;
+    m_tickTimer.stop();
+    stopEventStream();
+    m_http.abortAll();
+    setConnected(false);
+}
+
+void BridgeSession::updateSubscriber(std::uint64_t id,
+                                     const SyncFilter &filter,
+                                     int pollIntervalMs,
+                                     int retryIntervalMs)
+{
+    auto it = m_subscribers.find(id);
+    if (it == m_subscribers.end())
+        return;
+    BridgeSubscriber &subscriber = it->second;
+    if (filterKey(subscriber.filter) != filterKey(filter))
+        m_nextPollDueMs = 0;
+    subscriber.filter = filter;
+    subscriber.pollIntervalMs = pollIntervalMs;
+    subscriber.retryIntervalMs = retryIntervalMs;
+}
+
+void BridgeSession::requestPoll()
+{
+    // While shedding, on-demand polls still run, but at most once per
+    // configured interval.
+    if (m_loadShedder.active() && m_lastPollMs > 0) {
+        const std::int64_t earliest = m_lastPollMs + std::max(1000, pollIntervalMs());
+        if (earliest > nowMs()) {
+            if (m_nextPollDueMs > earliest) {
+                m_nextPollDueMs = earliest;
+                m_loadShedder.noteThrottledPollRequest();
+            }
+            return;
+        }
+    }
+    m_nextPollDueMs = 0;
+}
+
+bool BridgeSession::eventStreamShared() const
+{
+    return m_eventStreamReply && m_eventStreamReply->manager() == &m_requestNetwork;
+}
+
+std::size_t BridgeSession::bufferBytes() const
+{
+    return heapBytes(m_eventStreamLineBuffer) + heapBytes(m_eventStreamDataBuffer);
+}
+
+void BridgeSession::tick()
+{
+    // A poll spins a nested event loop per request; do not re-enter it.
+    if (m_polling || m_subscribers.empty())
+        return;
+
+    const std::int64_t now = nowMs();
+    if (m_loadShedder.update(m_http.bridgeLoad(), now)) {
+        std::cerr << "hue-ipc bridge load shedding " << (m_loadShedder.active() ? "started" : "ended")
+                  << " (load ratio " << m_loadShedder.ratio() << ")" << '\n';
+        // Recovery brings the next poll back to the normal schedule.
+        if (!m_loadShedder.active())
+            m_nextPollDueMs = std::min(m_nextPollDueMs, m_lastPollMs + effectivePollIntervalMs());
+    }
+    pumpEventStream(now);
+
+    if (!m_eventStreamReply && now >= m_nextEventStreamRetryDueMs)
+        startEventStream();
+
+    if (m_nextPollDueMs > now)
+        return;
+    poll(now);
+
+    if (m_released)
+        QTimer::singleShot(0, QCoreApplication::instance(), [this]() { delete this; });
+}
+
+void BridgeSession::poll(std::int64_t now)
+{
+    m_polling = true;
+    m_lastPollMs = now;
+
+    BridgePoll result;
+    const SyncFilter filter = unionFilter();
+
+    QHash<QString, QJsonArray> data;
+    const QStringList required = {
+        QStringLiteral("device"), QStringLiteral("light"), QStringLiteral("room"),
+        QStringLiteral("zone"), QStringLiteral("scene"),
+    };
+    const QStringList optional = {
+        QStringLiteral("motion"), QStringLiteral("tamper"), QStringLiteral("temperature"),
+        QStringLiteral("light_level"), QStringLiteral("device_power"), QStringLiteral("button"),
+        QStringLiteral("relative_rotary"), QStringLiteral("zigbee_connectivity"),
+    };
+
+    if (HttpClient::effectiveHost(m_settings).isEmpty()) {
+        result.error = QStringLiteral("Bridge host is empty");
+    } else if (m_settings.appKey.trimmed().isEmpty()) {
+        result.error = QStringLiteral("Hue application key missing");
+    } else {
+        result.ok = true;
+        for (const QString &type : required) {
+            if (!filter.resourceEnabled(type))
+                continue;
+            if (!fetchResourceArray(type, &data[type], &result.error)) {
+                result.ok = false;
+                break;
+            }
+        }
+        for (const QString &type : optional) {
+            if (!result.ok)
+                break;
+            if (!filter.resourceNeeded(type))
+                continue;
+            // A missing service list leaves its channels without values but
+            // does not fail the poll. Logged when a type starts or stops
+            // failing, counted every time.
+            QString error;
+            if (fetchResourceArray(type, &data[type], &error)) {
+                if (m_failingOptional.remove(type))
+                    std::cerr << "hue-ipc poll fetch recovered: " << type.toStdString() << '\n';
+                continue;
+            }
+            data[type] = QJsonArray{};
+            ++m_optionalFetchFailures;
+            if (!m_failingOptional.contains(type)) {
+                m_failingOptional.insert(type);
+                std::cerr << "hue-ipc poll fetch failed: " << type.toStdString() << ' ' << error.toStdString()
+                          << '\n';
+            }
+        }
+    }
+
+    m_polling = false;
+    const int retry = retryIntervalMs();
+    if (!result.ok) {
+        setConnected(false);
+        m_nextPollDueMs = now + std::max(1000, retry);
+        for (const auto &[id, subscriber] : m_subscribers) {
+            if (subscriber.onPoll)
+                deliver(subscriber, [fn = subscriber.onPoll, result]() { fn(result); });
+        }
+        return;
+    }
+
+    // Parse once per distinct filter; identical configurations share it.
+    QHash<QString, std::shared_ptr<const Snapshot>> snapshots;
+    for (const auto &[id, subscriber] : m_subscribers) {
+        const QString key = filterKey(subscriber.filter);
+        std::shared_ptr<const Snapshot> snapshot = snapshots.value(key);
+        if (!snapshot) {
+            const SyncFilter &own = subscriber.filter;
+            auto arrayFor = [&data, &own](const QString &type) {
+                return own.resourceNeeded(type) ? data.value(type) : QJsonArray{};
+            };
+            snapshot = std::make_shared<const Snapshot>(buildSnapshot(arrayFor(QStringLiteral("device")),
+                                                                      arrayFor(QStringLiteral("light")),
+                                                                      arrayFor(QStringLiteral("motion")),
+                                                                      arrayFor(QStringLiteral("tamper")),
+                                                                      arrayFor(QStringLiteral("temperature")),
+                                                                      arrayFor(QStringLiteral("light_level")),
+                                                                      arrayFor(QStringLiteral("device_power")),
+                                                                      arrayFor(QStringLiteral("button")),
+                                                                      arrayFor(QStringLiteral("relative_rotary")),
+                                                                      arrayFor(QStringLiteral("zigbee_connectivity")),
+                                                                      arrayFor(QStringLiteral("room")),
+                                                                      arrayFor(QStringLiteral("zone")),
+                                                                      arrayFor(QStringLiteral("scene")),
+                                                                      own));
+            snapshots.insert(key, snapshot);
+        }
+
+        if (!subscriber.onPoll)
+            continue;
+        BridgePoll delivered;
+        delivered.ok = true;
+        delivered.snapshot = std::move(snapshot);
+        delivered.buttonData = subscriber.filter.resourceNeeded(QStringLiteral("button"))
+            ? data.value(QStringLiteral("button"))
+            : QJsonArray{};
+        deliver(subscriber, [fn = subscriber.onPoll, delivered = std::move(delivered)]() { fn(delivered); });
+    }
+
+    setConnected(true);
+    if (m_loadShedder.active())
+        m_loadShedder.noteStretchedPoll();
+    m_nextPollDueMs = now + effectivePollIntervalMs();
+}
+
+int BridgeSession::effectivePollIntervalMs() const
+{
+    const int interval = m_eventStreamActive
+        ? std::max(pollIntervalMs(), kEventStreamPollIntervalMs)
+        : pollIntervalMs();
+    return m_loadShedder.pollIntervalMs(std::max(1000, interval));
+}
+
+bool BridgeSession::fetchResourceArray(const QString &resourceType, QJsonArray *outData, QString *error)
+{
+    if (!outData)
+        return false;
+
+    // Elements are parsed one by one while the rest of the body is still in
+    // flight; only the element being received is ever buffered.
+    QJsonArray items;
+    JsonArraySplitter splitter(QByteArrayLiteral("data"), [&items](const QByteArray &element) {
+        const QJsonDocument doc = QJsonDocument::fromJson(element);
+        if (!doc.isObject())
+            return false;
+        items.append(doc.object());
+        return true;
+    });
+
+    StageTimer fetchTimer(Stage::FetchWall);
+    const HttpResult result = m_http.getStreaming(m_settings,
+                                                  QStringLiteral("/clip/v2/resource/%1").arg(resourceType),
+                                                  [&splitter](const QByteArray &chunk) {
+                                                      StageTimer parseTimer(Stage::JsonParse);
+                                                      return splitter.feed(chunk);
+                                                  });
+    fetchTimer.stop();
+    m_peakElementBytes = std::max(m_peakElementBytes, splitter.peakElementBytes());
+    if (splitter.failed()) {
+        if (error)
+            *error = QStringLiteral("Hue %1 response is not valid JSON").arg(resourceType);
+        return false;
+    }
+    if (!result.ok) {
+        QString message = extractHueError(result.payload);
+        if (message.isEmpty())
+            message = result.error;
+        if (message.isEmpty())
+            message = QStringLiteral("Failed to fetch Hue resource %1").arg(resourceType);
+        if (error)
+            *error = message;
+        return false;
+    }
+
+    if (!splitter.complete()) {
+        if (error)
+            *error = QStringLiteral("Hue %1 response has no data array").arg(resourceType);
+        return false;
+    }
+
+    *outData = std::move(items);
+    return true;
+}
+
+void BridgeSession::startEventStream()
+{
+    if (m_eventStreamReply || m_subscribers.empty())
+        return;
+
+    const QString host = HttpClient::effectiveHost(m_settings);
+    if (host.isEmpty() || m_settings.appKey.trimmed().isEmpty()) {
+        m_nextEventStreamRetryDueMs = nowMs() + std::max(1000, retryIntervalMs());
+        return;
+    }
+
+    const bool useTls = m_settings.useTls;
+
+    QUrl url;
+    url.setScheme(useTls ? QStringLiteral("https") : QStringLiteral("http"));
+    url.setHost(host);
+    url.setPort(m_settings.port);
+    url.setPath(QStringLiteral("/eventstream/clip/v2"));
+
+    QNetworkRequest request(url);
+    request.setRawHeader("Accept", "text/event-stream");
+    request.setRawHeader("hue-application-key", m_settings.appKey.toUtf8());
+    request.setRawHeader("User-Agent", "phi-adapter-hue-ipc/1.0");
+
+    // Over HTTP/2 the eventstream is one more stream on the request
+    // connection instead of a second TLS session to the bridge.
+    const bool http2 = useTls && m_http.http2Active();
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2);
+
+#if QT_CONFIG(ssl)
+    if (useTls) {
+        QSslConfiguration ssl = QSslConfiguration::defaultConfiguration();
+        ssl.setPeerVerifyMode(QSslSocket::VerifyNone);
+        request.setSslConfiguration(ssl);
+    }
+#endif
+
+    QNetworkAccessManager &network = http2 ? m_requestNetwork : m_eventStreamNetwork;
+    m_eventStreamReply = network.get(request);
+    if (!m_eventStreamReply)
+        m_nextEventStreamRetryDueMs = nowMs() + std::max(1000, retryIntervalMs());
+}
+
+void BridgeSession::stopEventStream()
+{
+    if (!m_eventStreamReply)
+        return;
+
+    m_eventStreamReply->abort();
+    m_eventStreamReply->deleteLater();
+    m_eventStreamReply = nullptr;
+    m_eventStreamLineBuffer.clear();
+    m_eventStreamDataBuffer.clear();
+    m_eventStreamActive = false;
+    m_nextEventStreamRetryDueMs = 0;
+    m_eventStreamRetryCount = 0;
+}
+
+void BridgeSession::pumpEventStream(std::int64_t now)
+{
+    if (!m_eventStreamReply)
+        return;
+
+    const QByteArray chunk = m_eventStreamReply->readAll();
+    if (!chunk.isEmpty()) {
+        setConnected(true);
+        m_eventStreamActive = true;
+        m_eventStreamRetryCount = 0;
+        m_nextEventStreamRetryDueMs = now + std::max(1000, retryIntervalMs());
+        m_eventStreamLineBuffer.append(chunk);
+
+        StageTimer sseTimer(Stage::SseParse);
+        while (true) {
+            const int newline = m_eventStreamLineBuffer.indexOf('\n');
+            if (newline < 0)
+                break;
+
+            QByteArray line = m_eventStreamLineBuffer.left(newline);
+            m_eventStreamLineBuffer.remove(0, newline + 1);
+            if (!line.isEmpty() && line.endsWith('\r'))
+                line.chop(1);
+
+            if (line.isEmpty()) {
+                if (!m_eventStreamDataBuffer.isEmpty()) {
+                    dispatchEventPayload(m_eventStreamDataBuffer, now);
+                    m_eventStreamDataBuffer.clear();
+                }
+                continue;
+            }
+
+            if (line.startsWith("data:")) {
+                QByteArray payload = line.mid(5);
+                if (!payload.isEmpty() && payload.at(0) == ' ')
+                    payload.remove(0, 1);
+                if (!m_eventStreamDataBuffer.isEmpty())
+                    m_eventStreamDataBuffer.append('\n');
+                m_eventStreamDataBuffer.append(payload);
+            }
+        }
+    }
+
+    if (!m_eventStreamReply || !m_eventStreamReply->isFinished())
+        return;
+
+    const bool hasError = m_eventStreamReply->error() != QNetworkReply::NoError;
+    if (hasError) {
+        std::cerr << "hue-ipc eventstream error: "
+                  << m_eventStreamReply->errorString().toStdString()
+                  << '\n';
+    } else {
+        std::cerr << "hue-ipc eventstream finished" << '\n';
+    }
+
+    m_eventStreamReply->deleteLater();
+    m_eventStreamReply = nullptr;
+    m_eventStreamLineBuffer.clear();
+    m_eventStreamDataBuffer.clear();
+    m_eventStreamActive = false;
+
+    if (hasError)
+        setConnected(false);
+
+    int retryDelayMs = retryIntervalMs();
+    if (m_eventStreamRetryCount < kEventStreamFastRetryAttempts) {
+        ++m_eventStreamRetryCount;
+        retryDelayMs = kEventStreamFastRetryMs;
+    }
+    m_nextEventStreamRetryDueMs = now + std::max(1000, retryDelayMs);
+}
+
+void BridgeSession::dispatchEventPayload(const QByteArray &jsonData, std::int64_t now)
+{
+    StageTimer parseTimer(Stage::EventParse);
+    QJsonParseError parseError{};
+    const QJsonDocument doc = QJsonDocument::fromJson(jsonData, &parseError);
+    parseTimer.stop();
+    if (parseError.error != QJsonParseError::NoError)
+        return;
+
+    QJsonArray events;
+    if (doc.isArray())
+        events = doc.array();
+    else if (doc.isObject())
+        events.append(doc.object());
+    if (events.isEmpty())
+        return;
+
+    for (const auto &[id, subscriber] : m_subscribers) {
+        if (subscriber.onEvents)
+            deliver(subscriber, [fn = subscriber.onEvents, events, now]() { fn(events, now); });
+    }
+}
+
+void BridgeSession::setConnected(bool connected)
+{
+    if (m_connected == connected)
+        return;
+    m_connected = connected;
+    for (const auto &[id, subscriber] : m_subscribers) {
+        if (subscriber.onConnectionState)
+            deliver(subscriber, [fn = subscriber.onConnectionState, connected]() { fn(connected); });
+    }
+}
+
+SyncFilter BridgeSession::unionFilter() const
+{
+    // An empty set means "everything", so it absorbs any other filter.
+    SyncFilter merged;
+    bool allResources = false;
+    bool allChannels = false;
+    for (const auto &[id, subscriber] : m_subscribers) {
+        if (subscriber.filter.resourceTypes.isEmpty())
+            allResources = true;
+        if (subscriber.filter.channelIds.isEmpty())
+            allChannels = true;
+        merged.resourceTypes.unite(subscriber.filter.resourceTypes);
+        merged.channelIds.unite(subscriber.filter.channelIds);
+    }
+    if (allResources)
+        merged.resourceTypes.clear();
+    if (allChannels)
+        merged.channelIds.clear();
+    return merged;
+}
+
+int BridgeSession::pollIntervalMs() const
+{
+    int interval = 0;
+    for (const auto &[id, subscriber] : m_subscribers)
+        interval = interval == 0 ? subscriber.pollIntervalMs : std::min(interval, subscriber.pollIntervalMs);
+    return interval > 0 ? interval : 5000;
+}
+
+int BridgeSession::retryIntervalMs() const
+{
+    int interval = 0;
+    for (const auto &[id, subscriber] : m_subscribers)
+        interval = interval == 0 ? subscriber.retryIntervalMs : std::min(interval, subscriber.retryIntervalMs);
+    return interval > 0 ? interval : 10000;
+}
+
+} // namespace phicore::hue::ipc
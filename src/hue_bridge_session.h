@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+#include "hue_http.h"
+#include "hue_load_shed.h"
+#include "hue_model.h"
+
+namespace phicore::hue::ipc {
+
+struct BridgePoll {
+    bool ok = false;
+    QString error;
+    std::shared_ptr<const Snapshot> snapshot;
+    QJsonArray buttonData;
+};
+
+// One subscriber per adapter instance. Callbacks are queued onto context and
+// dropped once context is destroyed, so an instance can detach at any time.
+struct BridgeSubscriber {
+    QObject *context = nullptr;
+    SyncFilter filter;
+    int pollIntervalMs = 5000;
+    int retryIntervalMs = 10000;
+    std::function<void(const BridgePoll &)> onPoll;
+    std::function<void(const QJsonArray &events, std::int64_t receivedMs)> onEvents;
+    std::function<void(bool connected)> onConnectionState;
+};
+
+// Bridge traffic shared by every instance that targets the same endpoint and
+// application key: one eventstream, one poll schedule and one parsed snapshot
+// per distinct sync filter. The key includes the application key because the
+// eventstream and polls are authorised with it; instances using different
+// keys for one bridge get separate sessions. Sessions live on the thread that
+// created them.
+class BridgeSession
+{
+public:
+    static std::shared_ptr<BridgeSession> acquire(const ConnectionSettings &settings);
+    static QString keyFor(const ConnectionSettings &settings);
+
+    std::uint64_t subscribe(BridgeSubscriber subscriber);
+    void unsubscribe(std::uint64_t id);
+    // A reconfigured instance keeps its subscription; a new filter is
+    // polled at once.
+    void updateSubscriber(std::uint64_t id, const SyncFilter &filter, int pollIntervalMs, int retryIntervalMs);
+    void requestPoll();
+
+    // Synchronous one-off fetch through the shared client, outside the poll.
+    bool fetchResourceArray(const QString &resourceType, QJsonArray *outData, QString *error);
+
+    HttpClient &http() { return m_http; }
+    const HttpClient &http() const { return m_http; }
+    std::size_t subscriberCount() const { return m_subscribers.size(); }
+    bool eventStreamShared() const;
+    std::size_t bufferBytes() const;
+    // Largest single resource buffered while streaming a poll response.
+    std::size_t peakResponseElementBytes() const { return m_peakElementBytes; }
+    // Optional service lists (motion, button, ...) that a poll failed to fetch.
+    std::uint64_t optionalFetchFailures() const { return m_optionalFetchFailures; }
+    // Session-wide like the HTTP client; the instance configured last sets
+    // the policy.
+    LoadShedder &loadShedder() { return m_loadShedder; }
+    const LoadShedder &loadShedder() const { return m_loadShedder; }
+    // Poll interval currently in effect, including load shedding.
+    int effectivePollIntervalMs() const;
+
+private:
+    explicit BridgeSession(const ConnectionSettings &settings);
+    ~BridgeSession();
+
+    void release();
+
+    void tick();
+    void poll(std::int64_t now);
+    void startEventStream();
+    void stopEventStream();
+    void pumpEventStream(std::int64_t now);
+    void dispatchEventPayload(const QByteArray &jsonData, std::int64_t now);
+    void setConnected(bool connected);
+    SyncFilter unionFilter() const;
+    int pollIntervalMs() const;
+    int retryIntervalMs() const;
+
+    template <typename Fn>
+    void deliver(const BridgeSubscriber &subscriber, Fn &&fn)
+    {
+        if (subscriber.context)
+            QMetaObject::invokeMethod(subscriber.context, std::forward<Fn>(fn), Qt::QueuedConnection);
+    }
+
+    QString m_key;
+    ConnectionSettings m_settings;
+    QNetworkAccessManager m_requestNetwork;
+    QNetworkAccessManager m_eventStreamNetwork;
+    HttpClient m_http{&m_requestNetwork};
+    LoadShedder m_loadShedder;
+    QTimer m_tickTimer;
+
+    std::map<std::uint64_t, BridgeSubscriber> m_subscribers;
+    std::uint64_t m_nextSubscriberId = 1;
+
+    bool m_connected = false;
+    bool m_polling = false;
+    bool m_released = false;
+    std::int64_t m_nextPollDueMs = 0;
+    std::int64_t m_lastPollMs = 0;
+    std::int64_t m_nextEventStreamRetryDueMs = 0;
+    int m_eventStreamRetryCount = 0;
+    bool m_eventStreamActive = false;
+    QNetworkReply *m_eventStreamReply = nullptr;
+    QByteArray m_eventStreamLineBuffer;
+    QByteArray m_eventStreamDataBuffer;
+    std::size_t m_peakElementBytes = 0;
+    std::uint64_t m_optionalFetchFailures = 0;
+    QSet<QString> m_failingOptional;
+};
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,33 @@
+#include "hue_clock.h"
+
+#ifdef PHI_ADAPTER_HUE_TESTING
+#include <atomic>
+#endif
+
+#include <QDateTime>
+
+namespace phicore::hue::ipc {
+
+#ifdef PHI_ADAPTER_HUE_TESTING
+namespace {
+std::atomic<std::int64_t> g_offsetMs{0};
+}
+
+std::int64_t wallClockMs()
+{
+    return QDateTime::currentMSecsSinceEpoch() + g_offsetMs.load(std::memory_order_relaxed);
+}
+
+void advanceWallClock(std::int64_t ms)
+{
+    if (ms > 0)
+        g_offsetMs.fetch_add(ms, std::memory_order_relaxed);
+}
+#else
+std::int64_t wallClockMs()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+#endif
+
+} // namespace phicore::hue::ipc
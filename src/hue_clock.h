@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+namespace phicore::hue::ipc {
+
+// Wall clock behind the poll schedule, event timers and published
+// timestamps. Request deadlines and latency use the steady clock.
+std::int64_t wallClockMs();
+
+#ifdef PHI_ADAPTER_HUE_TESTING
+// Moves the wall clock forward so tests cover days of bridge traffic in
+// minutes. Only phi_adapter_hue_core_testing has it.
+void advanceWallClock(std::int64_t ms);
+#endif
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,78 @@
+#include "hue_delta_queue.h"
+
+#include <algorithm>
+
+#include "hue_footprint.h"
+
+namespace phicore::hue::ipc {
+
+std::uint32_t ChannelDeltaQueue::handleFor(const QString &deviceExternalId)
+{
+    const auto it = m_handles.constFind(deviceExternalId);
+    if (it != m_handles.cend())
+        return it.value();
+    const auto handle = static_cast<std::uint32_t>(m_deviceIds.size());
+    m_deviceIds.push_back(deviceExternalId);
+    m_handles.insert(deviceExternalId, handle);
+    return handle;
+}
+
+const QString &ChannelDeltaQueue::deviceFor(std::uint32_t handle) const
+{
+    static const QString none;
+    return handle < m_deviceIds.size() ? m_deviceIds[handle] : none;
+}
+
+bool ChannelDeltaQueue::push(const ChannelDelta &delta)
+{
+    Stats &stats = m_stats[static_cast<std::size_t>(delta.priority)];
+    const bool pushed = delta.priority == DeltaPriority::Telemetry ? m_telemetry.tryPush(delta)
+                                                                   : m_interactive.tryPush(delta);
+    if (!pushed) {
+        ++stats.backpressured;
+        return false;
+    }
+    ++stats.pushed;
+    stats.highWater = std::max(stats.highWater, size(delta.priority));
+    return true;
+}
+
+bool ChannelDeltaQueue::pop(ChannelDelta *out)
+{
+    if (m_interactive.tryPop(out)) {
+        ++m_stats[static_cast<std::size_t>(DeltaPriority::Interactive)].delivered;
+        return true;
+    }
+    if (m_telemetry.tryPop(out)) {
+        ++m_stats[static_cast<std::size_t>(DeltaPriority::Telemetry)].delivered;
+        return true;
+    }
+    return false;
+}
+
+std::size_t ChannelDeltaQueue::size(DeltaPriority priority) const
+{
+    return priority == DeltaPriority::Telemetry ? m_telemetry.size() : m_interactive.size();
+}
+
+std::size_t ChannelDeltaQueue::bytes() const
+{
+    std::size_t total = sizeof(m_interactive) + sizeof(m_telemetry)
+        + m_deviceIds.capacity() * sizeof(QString) + hashBytes(m_handles);
+    for (const QString &id : m_deviceIds)
+        total += heapBytes(id);
+    return total;
+}
+
+void ChannelDeltaQueue::clear()
+{
+    ChannelDelta discarded;
+    while (m_interactive.tryPop(&discarded)) {
+    }
+    while (m_telemetry.tryPop(&discarded)) {
+    }
+    m_deviceIds.clear();
+    m_handles.clear();
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+#include "hue_spsc.h"
+
+namespace phicore::hue::ipc {
+
+enum class DeltaPriority : std::uint8_t {
+    // Light, button and dial changes.
+    Interactive,
+    // Sensor and connectivity readings; drained after interactive records.
+    Telemetry,
+    Count
+};
+
+constexpr std::size_t kDeltaPriorityCount = static_cast<std::size_t>(DeltaPriority::Count);
+
+// Fixed-size channel change handed from the delta applier to the IPC sender.
+struct ChannelDelta {
+    enum Kind : std::uint8_t { Bool, Integer, Number };
+
+    std::uint32_t deviceHandle = 0;
+    std::uint16_t channelSlot = 0;
+    Kind kind = Integer;
+    DeltaPriority priority = DeltaPriority::Interactive;
+    // Bool and Integer values.
+    std::int64_t integer = 0;
+    double number = 0.0;
+    std::int64_t eventTs = 0;
+    std::int64_t enqueuedUs = 0;
+};
+
+// Pair of SPSC rings, one per priority. Neither drops records: a full ring
+// pushes back and the caller drains. Device ids are interned to handles
+// by the producer; the handle table only grows until clear(), which must
+// not race with either side.
+class ChannelDeltaQueue
+{
+public:
+    static constexpr std::size_t kInteractiveCapacity = 256;
+    static constexpr std::size_t kTelemetryCapacity = 128;
+
+    struct Stats {
+        std::uint64_t pushed = 0;
+        std::uint64_t delivered = 0;
+        std::uint64_t backpressured = 0;
+        std::size_t highWater = 0;
+    };
+
+    std::uint32_t handleFor(const QString &deviceExternalId);
+    const QString &deviceFor(std::uint32_t handle) const;
+
+    // Returns false when the record's ring is full; the caller has to drain
+    // and try again.
+    bool push(const ChannelDelta &delta);
+    // Interactive records first.
+    bool pop(ChannelDelta *out);
+
+    std::size_t size(DeltaPriority priority) const;
+    bool empty() const { return size(DeltaPriority::Interactive) == 0 && size(DeltaPriority::Telemetry) == 0; }
+    const Stats &stats(DeltaPriority priority) const { return m_stats[static_cast<std::size_t>(priority)]; }
+    std::size_t handleCount() const { return m_deviceIds.size(); }
+    std::size_t bytes() const;
+    void clear();
+
+private:
+    SpscRing<ChannelDelta, kInteractiveCapacity> m_interactive;
+    SpscRing<ChannelDelta, kTelemetryCapacity> m_telemetry;
+    std::vector<QString> m_deviceIds;
+    QHash<QString, std::uint32_t> m_handles;
+    // Each counter is written by one side only.
+    std::array<Stats, kDeltaPriorityCount> m_stats{};
+};
+
+} // namespace phicore::hue::ipc
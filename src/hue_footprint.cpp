@@ -0,0 +1,45 @@
+#include "hue_footprint.h"
+
+#include <algorithm>
+
+namespace phicore::hue::ipc {
+
+void FootprintReport::add(const QString &name, std::size_t entries, std::size_t bytes, bool shared)
+{
+    QJsonObject item = m_structures.value(name).toObject();
+    item.insert(QStringLiteral("entries"), static_cast<qint64>(entries));
+    item.insert(QStringLiteral("bytes"), static_cast<qint64>(bytes));
+    if (shared)
+        item.insert(QStringLiteral("shared"), true);
+    m_structures.insert(name, item);
+    m_entries.insert(name, entries);
+
+    if (shared)
+        m_sharedBytes += bytes;
+    else
+        m_instanceBytes += bytes;
+}
+
+void FootprintReport::addDetail(const QString &name, const QString &key, std::size_t bytes)
+{
+    QJsonObject item = m_structures.value(name).toObject();
+    item.insert(key, static_cast<qint64>(bytes));
+    m_structures.insert(name, item);
+}
+
+void FootprintReport::applyHighWater(const QHash<QString, std::size_t> &highWater)
+{
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        addDetail(it.key(), QStringLiteral("highWaterEntries"), std::max(it.value(), highWater.value(it.key())));
+}
+
+QJsonObject FootprintReport::toJson() const
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("instanceBytes"), static_cast<qint64>(m_instanceBytes));
+    result.insert(QStringLiteral("sharedBytes"), static_cast<qint64>(m_sharedBytes));
+    result.insert(QStringLiteral("structures"), m_structures);
+    return result;
+}
+
+} // namespace phicore::hue::ipc
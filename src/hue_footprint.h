@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace phicore::hue::ipc {
+
+// Approximate heap accounting. The numbers follow the container layouts of
+// libstdc++ and Qt 6 closely enough for capacity planning, not for exact
+// allocator statistics.
+constexpr std::size_t kQtArrayHeaderBytes = 16;
+constexpr std::size_t kHashNodeOverheadBytes = 8;
+
+// Trivially copyable values cannot own heap storage.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+constexpr std::size_t heapBytes(const T &)
+{
+    return 0;
+}
+
+// Any other type needs an overload of its own next to its definition, where
+// argument-dependent lookup finds it; silently counting 0 would hide it.
+template <typename T>
+std::size_t heapBytes(const T &) = delete;
+
+inline std::size_t heapBytes(const std::string &value)
+{
+    // Short strings live in the inline buffer.
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+}
+
+inline std::size_t heapBytes(const QString &value)
+{
+    return value.isDetached() && value.capacity() > 0
+        ? kQtArrayHeaderBytes + static_cast<std::size_t>(value.capacity()) * sizeof(QChar)
+        : 0;
+}
+
+inline std::size_t heapBytes(const QByteArray &value)
+{
+    return value.isDetached() && value.capacity() > 0
+        ? kQtArrayHeaderBytes + static_cast<std::size_t>(value.capacity())
+        : 0;
+}
+
+inline std::size_t heapBytes(const QStringList &value)
+{
+    std::size_t total = kQtArrayHeaderBytes + static_cast<std::size_t>(value.capacity()) * sizeof(QString);
+    for (const QString &item : value)
+        total += heapBytes(item);
+    return total;
+}
+
+template <typename T>
+std::size_t heapBytes(const std::vector<T> &value)
+{
+    std::size_t total = value.capacity() * sizeof(T);
+    for (const T &item : value)
+        total += heapBytes(item);
+    return total;
+}
+
+template <typename K, typename V>
+std::size_t hashBytes(const QHash<K, V> &hash)
+{
+    std::size_t total = static_cast<std::size_t>(hash.capacity())
+        + static_cast<std::size_t>(hash.size()) * (sizeof(K) + sizeof(V) + kHashNodeOverheadBytes);
+    for (auto it = hash.cbegin(); it != hash.cend(); ++it)
+        total += heapBytes(it.key()) + heapBytes(it.value());
+    return total;
+}
+
+template <typename K>
+std::size_t setBytes(const QSet<K> &set)
+{
+    std::size_t total = static_cast<std::size_t>(set.capacity())
+        + static_cast<std::size_t>(set.size()) * (sizeof(K) + kHashNodeOverheadBytes);
+    for (const K &key : set)
+        total += heapBytes(key);
+    return total;
+}
+
+class FootprintReport
+{
+public:
+    void add(const QString &name, std::size_t entries, std::size_t bytes, bool shared = false);
+    void addDetail(const QString &name, const QString &key, std::size_t bytes);
+    void applyHighWater(const QHash<QString, std::size_t> &highWater);
+
+    std::size_t instanceBytes() const { return m_instanceBytes; }
+    std::size_t sharedBytes() const { return m_sharedBytes; }
+    QJsonObject toJson() const;
+
+private:
+    QJsonObject m_structures;
+    QHash<QString, std::size_t> m_entries;
+    std::size_t m_instanceBytes = 0;
+    std::size_t m_sharedBytes = 0;
+};
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,349 @@
+#include "hue_history.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+namespace phicore::hue::ipc {
+
+namespace {
+
+// Worst case for one sample: 4 + 64 timestamp bits, 2 + 5 + 6 + 64 value bits.
+constexpr std::size_t kMaxSampleBits = 145;
+
+std::uint64_t doubleBits(double value)
+{
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsToDouble(std::uint64_t bits)
+{
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::uint64_t zigzag(std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1u);
+}
+
+class BitReader
+{
+public:
+    BitReader(const std::vector<std::uint8_t> &data, std::size_t bitCount)
+        : m_data(data)
+        , m_bitCount(bitCount)
+    {
+    }
+
+    bool readBit()
+    {
+        if (m_pos >= m_bitCount)
+            return false;
+        const bool bit = (m_data[m_pos >> 3] >> (7 - (m_pos & 7))) & 1u;
+        ++m_pos;
+        return bit;
+    }
+
+    std::uint64_t readBits(int bits)
+    {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bits; ++i)
+            value = (value << 1) | (readBit() ? 1u : 0u);
+        return value;
+    }
+
+private:
+    const std::vector<std::uint8_t> &m_data;
+    std::size_t m_bitCount = 0;
+    std::size_t m_pos = 0;
+};
+
+} // namespace
+
+HistorySeries::HistorySeries(std::size_t blockBytes)
+    : m_blockBytes(std::max<std::size_t>(blockBytes, (kMaxSampleBits + 7) / 8 * 2))
+{
+}
+
+bool HistorySeries::append(std::int64_t tsMs, double value)
+{
+    if (!m_blocks.empty() && tsMs < m_blocks.back().lastTs)
+        return false;
+    encode(openBlock(), tsMs, value);
+    return true;
+}
+
+double HistorySeries::lastValue() const
+{
+    return m_blocks.empty() ? 0.0 : bitsToDouble(m_blocks.back().lastBits);
+}
+
+std::int64_t HistorySeries::oldestTs() const
+{
+    return m_blocks.empty() ? std::numeric_limits<std::int64_t>::max() : m_blocks.front().firstTs;
+}
+
+std::size_t HistorySeries::sampleCount() const
+{
+    std::size_t count = 0;
+    for (const Block &block : m_blocks)
+        count += block.count;
+    return count;
+}
+
+bool HistorySeries::dropOldestBlock()
+{
+    if (m_blocks.empty())
+        return false;
+    m_blocks.pop_front();
+    return true;
+}
+
+std::vector<HistorySample> HistorySeries::query(std::int64_t fromMs, std::int64_t toMs) const
+{
+    std::vector<HistorySample> out;
+    for (const Block &block : m_blocks) {
+        if (block.lastTs < fromMs || block.firstTs > toMs)
+            continue;
+        decode(block, &out, fromMs, toMs);
+    }
+    return out;
+}
+
+HistorySeries::Block &HistorySeries::openBlock()
+{
+    if (m_blocks.empty() || m_blocks.back().bitCount + kMaxSampleBits > m_blockBytes * 8) {
+        Block block;
+        block.data.assign(m_blockBytes, 0);
+        m_blocks.push_back(std::move(block));
+    }
+    return m_blocks.back();
+}
+
+void HistorySeries::writeBits(Block &block, std::uint64_t value, int bits)
+{
+    for (int i = bits - 1; i >= 0; --i) {
+        if ((value >> i) & 1u)
+            block.data[block.bitCount >> 3] |= static_cast<std::uint8_t>(0x80u >> (block.bitCount & 7));
+        ++block.bitCount;
+    }
+}
+
+void HistorySeries::encode(Block &block, std::int64_t tsMs, double value)
+{
+    const std::uint64_t bits = doubleBits(value);
+
+    if (block.count == 0) {
+        writeBits(block, static_cast<std::uint64_t>(tsMs), 64);
+        writeBits(block, bits, 64);
+        block.firstTs = tsMs;
+        block.lastTs = tsMs;
+        block.lastDelta = 0;
+        block.lastBits = bits;
+        block.leading = -1;
+        block.count = 1;
+        return;
+    }
+
+    const std::int64_t delta = tsMs - block.lastTs;
+    const std::int64_t dod = delta - block.lastDelta;
+    const std::uint64_t zz = zigzag(dod);
+    if (dod == 0) {
+        writeBits(block, 0b0, 1);
+    } else if (zz < (1u << 7)) {
+        writeBits(block, 0b10, 2);
+        writeBits(block, zz, 7);
+    } else if (zz < (1u << 9)) {
+        writeBits(block, 0b110, 3);
+        writeBits(block, zz, 9);
+    } else if (zz < (1u << 12)) {
+        writeBits(block, 0b1110, 4);
+        writeBits(block, zz, 12);
+    } else {
+        writeBits(block, 0b1111, 4);
+        writeBits(block, zz, 64);
+    }
+
+    const std::uint64_t xored = bits ^ block.lastBits;
+    if (xored == 0) {
+        writeBits(block, 0b0, 1);
+    } else {
+        const int leading = std::min(std::countl_zero(xored), 31);
+        const int trailing = std::countr_zero(xored);
+        if (block.leading >= 0 && leading >= block.leading && trailing >= block.trailing) {
+            const int meaningful = 64 - block.leading - block.trailing;
+            writeBits(block, 0b10, 2);
+            writeBits(block, xored >> block.trailing, meaningful);
+        } else {
+            const int meaningful = 64 - leading - trailing;
+            writeBits(block, 0b11, 2);
+            writeBits(block, static_cast<std::uint64_t>(leading), 5);
+            writeBits(block, static_cast<std::uint64_t>(meaningful & 63), 6);
+            writeBits(block, xored >> trailing, meaningful);
+            block.leading = leading;
+            block.trailing = trailing;
+        }
+    }
+
+    block.lastTs = tsMs;
+    block.lastDelta = delta;
+    block.lastBits = bits;
+    ++block.count;
+}
+
+void HistorySeries::decode(const Block &block,
+                           std::vector<HistorySample> *out,
+                           std::int64_t fromMs,
+                           std::int64_t toMs) const
+{
+    if (block.count == 0)
+        return;
+
+    BitReader reader(block.data, block.bitCount);
+    std::int64_t ts = static_cast<std::int64_t>(reader.readBits(64));
+    std::uint64_t bits = reader.readBits(64);
+    std::int64_t delta = 0;
+    int leading = 0;
+    int trailing = 0;
+
+    auto push = [&]() {
+        if (ts >= fromMs && ts <= toMs)
+            out->push_back(HistorySample{ts, bitsToDouble(bits)});
+    };
+    push();
+
+    for (std::uint32_t i = 1; i < block.count; ++i) {
+        std::int64_t dod = 0;
+        if (reader.readBit()) {
+            int width = 64;
+            if (!reader.readBit())
+                width = 7;
+            else if (!reader.readBit())
+                width = 9;
+            else if (!reader.readBit())
+                width = 12;
+            dod = unzigzag(reader.readBits(width));
+        }
+        delta += dod;
+        ts += delta;
+
+        if (reader.readBit()) {
+            if (reader.readBit()) {
+                leading = static_cast<int>(reader.readBits(5));
+                int meaningful = static_cast<int>(reader.readBits(6));
+                if (meaningful == 0)
+                    meaningful = 64;
+                trailing = 64 - leading - meaningful;
+            }
+            const int meaningful = 64 - leading - trailing;
+            bits ^= reader.readBits(meaningful) << trailing;
+        }
+        push();
+    }
+}
+
+bool SensorHistory::recordsChannel(const std::string &channelExternalId)
+{
+    return channelExternalId == "motion"
+        || channelExternalId == "temperature"
+        || channelExternalId == "illuminance";
+}
+
+void SensorHistory::setBudgetBytesPerDevice(std::size_t bytes)
+{
+    if (bytes == m_budgetBytes)
+        return;
+    m_budgetBytes = bytes;
+    if (m_budgetBytes == 0) {
+        clear();
+        return;
+    }
+    for (auto it = m_devices.begin(); it != m_devices.end(); ++it)
+        enforceBudget(it.value());
+}
+
+void SensorHistory::record(const QString &deviceExternalId,
+                           const std::string &channelExternalId,
+                           std::int64_t tsMs,
+                           double value)
+{
+    if (m_budgetBytes == 0 || !recordsChannel(channelExternalId))
+        return;
+
+    DeviceHistory &history = m_devices[deviceExternalId];
+    auto seriesIt = history.series.find(channelExternalId);
+    if (seriesIt == history.series.end()) {
+        const std::size_t blockBytes = std::clamp<std::size_t>(m_budgetBytes / 8, 64, 512);
+        seriesIt = history.series.emplace(channelExternalId, HistorySeries(blockBytes)).first;
+    }
+
+    HistorySeries &series = seriesIt->second;
+    if (series.hasLast() && series.lastValue() == value)
+        return;
+
+    const std::size_t before = series.bytes();
+    if (!series.append(tsMs, value))
+        return;
+    history.bytes += series.bytes() - before;
+    enforceBudget(history);
+}
+
+std::vector<HistorySample> SensorHistory::query(const QString &deviceExternalId,
+                                                const std::string &channelExternalId,
+                                                std::int64_t fromMs,
+                                                std::int64_t toMs) const
+{
+    const auto deviceIt = m_devices.constFind(deviceExternalId);
+    if (deviceIt == m_devices.cend())
+        return {};
+    const auto seriesIt = deviceIt->series.find(channelExternalId);
+    if (seriesIt == deviceIt->series.end())
+        return {};
+    return seriesIt->second.query(fromMs, toMs);
+}
+
+void SensorHistory::removeDevice(const QString &deviceExternalId)
+{
+    m_devices.remove(deviceExternalId);
+}
+
+void SensorHistory::clear()
+{
+    m_devices.clear();
+}
+
+std::size_t SensorHistory::bytes() const
+{
+    std::size_t total = 0;
+    for (auto it = m_devices.cbegin(); it != m_devices.cend(); ++it)
+        total += it->bytes;
+    return total;
+}
+
+void SensorHistory::enforceBudget(DeviceHistory &history)
+{
+    while (history.bytes > m_budgetBytes) {
+        HistorySeries *oldest = nullptr;
+        for (auto &[channel, series] : history.series) {
+            if (!series.empty() && (!oldest || series.oldestTs() < oldest->oldestTs()))
+                oldest = &series;
+        }
+        if (!oldest)
+            break;
+        const std::size_t before = oldest->bytes();
+        oldest->dropOldestBlock();
+        history.bytes -= before - oldest->bytes();
+    }
+}
+
+} // namespace phicore::hue::ipc
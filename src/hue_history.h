@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+namespace phicore::hue::ipc {
+
+struct HistorySample {
+    std::int64_t tsMs = 0;
+    double value = 0.0;
+};
+
+// Gorilla-style compressed time series: delta-of-delta timestamps and XOR
+// encoded doubles, stored in fixed-size blocks that can be dropped oldest first.
+class HistorySeries
+{
+public:
+    explicit HistorySeries(std::size_t blockBytes = 256);
+
+    bool append(std::int64_t tsMs, double value);
+    std::vector<HistorySample> query(std::int64_t fromMs, std::int64_t toMs) const;
+
+    bool empty() const { return m_blocks.empty(); }
+    bool hasLast() const { return !m_blocks.empty(); }
+    double lastValue() const;
+    std::int64_t oldestTs() const;
+    std::size_t bytes() const { return m_blocks.size() * m_blockBytes; }
+    std::size_t sampleCount() const;
+    bool dropOldestBlock();
+
+private:
+    struct Block {
+        std::vector<std::uint8_t> data;
+        std::size_t bitCount = 0;
+        std::uint32_t count = 0;
+        std::int64_t firstTs = 0;
+        std::int64_t lastTs = 0;
+        std::int64_t lastDelta = 0;
+        std::uint64_t lastBits = 0;
+        int leading = -1;
+        int trailing = 0;
+    };
+
+    Block &openBlock();
+    void writeBits(Block &block, std::uint64_t value, int bits);
+    void encode(Block &block, std::int64_t tsMs, double value);
+    void decode(const Block &block, std::vector<HistorySample> *out, std::int64_t fromMs, std::int64_t toMs) const;
+
+    std::size_t m_blockBytes = 256;
+    std::deque<Block> m_blocks;
+};
+
+class SensorHistory
+{
+public:
+    static bool recordsChannel(const std::string &channelExternalId);
+
+    void setBudgetBytesPerDevice(std::size_t bytes);
+    std::size_t budgetBytesPerDevice() const { return m_budgetBytes; }
+
+    void record(const QString &deviceExternalId,
+                const std::string &channelExternalId,
+                std::int64_t tsMs,
+                double value);
+    std::vector<HistorySample> query(const QString &deviceExternalId,
+                                     const std::string &channelExternalId,
+                                     std::int64_t fromMs,
+                                     std::int64_t toMs) const;
+
+    void removeDevice(const QString &deviceExternalId);
+    void clear();
+    std::size_t bytes() const;
+    std::size_t deviceCount() const { return static_cast<std::size_t>(m_devices.size()); }
+
+private:
+    struct DeviceHistory {
+        std::map<std::string, HistorySeries> series;
+        std::size_t bytes = 0;
+    };
+
+    void enforceBudget(DeviceHistory &history);
+
+    std::size_t m_budgetBytes = 4096;
+    QHash<QString, DeviceHistory> m_devices;
+};
+
+} // namespace phicore::hue::ipc
@@ -1,10 +1,19 @@
 #include "hue_http.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <map>
+#include <utility>
+
 #include <QEventLoop>
+#include <QHash>
 #include <QJsonDocument>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QRegularExpression>
 #include <QTimer>
 #include <QUrl>
 #if QT_CONFIG(ssl)
@@ -12,15 +21,440 @@
 #include <QSslSocket>
 #endif
 
+#include "hue_latency.h"
+
 namespace phicore::hue::ipc {
 
 namespace {
-constexpr int kDefaultRequestTimeoutMs = 10000;
+constexpr char kTimedOutProperty[] = "hueTimedOut";
+
+std::int64_t steadyNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
 }
 
+// Collapses resource ids so that e.g. every PUT /clip/v2/resource/light/<id>
+// shares one latency record.
+QString endpointKey(const QByteArray &method, const QString &path)
+{
+    static const QRegularExpression idPattern(
+        QStringLiteral("/[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}(?=/|$)"));
+    QString normalized = path;
+    normalized.replace(idPattern, QStringLiteral("/{id}"));
+    return QString::fromLatin1(method) + QLatin1Char(' ') + normalized;
+}
+}
+
+// Deadlines of all in-flight replies, ordered by expiry and driven by a
+// single timer that is only re-armed when the earliest deadline changes.
+// Completed requests feed the per-endpoint latency used for timeouts.
+class HttpClient::RequestTracker
+{
+public:
+    RequestTracker()
+    {
+        m_timer.setSingleShot(true);
+        QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this]() { expire(); });
+    }
+
+    void track(QNetworkReply *reply, const QString &endpoint, int connectTimeoutMs, int responseTimeoutMs)
+    {
+        InFlight inFlight;
+        inFlight.endpoint = endpoint;
+        inFlight.connectTimeoutMs = connectTimeoutMs;
+        inFlight.responseTimeoutMs = responseTimeoutMs;
+        // QNAM queues requests behind its six connections per host. The
+        // fallback covers the wait for a connection (one maxTimeoutMs, the
+        // longest the request ahead may take), the connect and the response,
+        // so a reply that never signals still ends. The connect and response
+        // deadlines below only ever move it earlier.
+        const std::int64_t now = steadyNowMs();
+        inFlight.fallbackMs = now + m_policy.maxTimeoutMs + connectTimeoutMs + responseTimeoutMs;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+        inFlight.key = schedule(reply, inFlight.fallbackMs);
+        inFlight.scheduled = true;
+        QObject::connect(reply, &QNetworkReply::socketStartedConnecting, &m_timer, [this, reply]() {
+            markConnecting(reply);
+        });
+        QObject::connect(reply, &QNetworkReply::requestSent, &m_timer, [this, reply]() { markSent(reply); });
+#else
+        inFlight.sent = true;
+        inFlight.sentMs = now;
+        inFlight.key = schedule(reply, std::min(inFlight.fallbackMs, inFlight.sentMs + responseTimeoutMs));
+        inFlight.scheduled = true;
+#endif
+        QObject::connect(reply, &QNetworkReply::metaDataChanged, &m_timer, [this, reply]() { markFirstByte(reply); });
+        m_inFlight.insert(reply, inFlight);
+        if (http2Active())
+            m_transport.maxConcurrentStreams = std::max(m_transport.maxConcurrentStreams, size());
+        QObject::connect(reply, &QNetworkReply::finished, &m_timer, [this, reply]() { complete(reply); });
+        QObject::connect(reply, &QObject::destroyed, &m_timer, [this, reply]() { untrack(reply); });
+    }
+
+    void abortAll()
+    {
+        const QList<QNetworkReply *> replies = m_inFlight.keys();
+        m_deadlines.clear();
+        m_inFlight.clear();
+        m_timer.stop();
+        for (QNetworkReply *reply : replies)
+            reply->abort();
+    }
+
+    std::size_t size() const { return static_cast<std::size_t>(m_inFlight.size()); }
+
+    // A reconfigure gives HTTP/2 another chance after an earlier fallback.
+    void setHttp2Allowed(bool allowed)
+    {
+        m_transport.http2Allowed = allowed;
+        m_transport.http2FellBack = false;
+    }
+    bool http2Active() const { return m_transport.http2Allowed && !m_transport.http2FellBack; }
+    const TransportStats &transport() const { return m_transport; }
+
+    void setPolicy(const TimeoutPolicy &policy) { m_policy = policy; }
+    const TimeoutPolicy &policy() const { return m_policy; }
+
+    int timeoutFor(const QString &endpoint) const
+    {
+        const auto it = m_endpoints.constFind(endpoint);
+        if (it == m_endpoints.cend() || it->samples < static_cast<std::uint64_t>(m_policy.minSamples))
+            return m_policy.maxTimeoutMs;
+        const double basis = std::max({static_cast<double>(it->current.quantile(0.99)),
+                                       static_cast<double>(it->previousP99Ms),
+                                       it->ewmaMs});
+        const auto timeout = static_cast<int>(std::ceil(basis * m_policy.p99Multiplier));
+        return std::clamp(timeout, m_policy.minTimeoutMs, std::max(m_policy.minTimeoutMs, m_policy.maxTimeoutMs));
+    }
+
+    std::vector<EndpointLatency> endpointLatency() const
+    {
+        std::vector<EndpointLatency> out;
+        out.reserve(static_cast<std::size_t>(m_endpoints.size()));
+        for (auto it = m_endpoints.cbegin(); it != m_endpoints.cend(); ++it) {
+            EndpointLatency latency;
+            latency.endpoint = it.key();
+            latency.samples = it->samples;
+            latency.ewmaMs = it->ewmaMs;
+            latency.baselineMs = it->baselineMs;
+            latency.p99Ms = std::max(it->current.quantile(0.99), it->previousP99Ms);
+            latency.timeoutMs = timeoutFor(it.key());
+            out.push_back(std::move(latency));
+        }
+        return out;
+    }
+
+    // The ratio as of now. Without fresh samples it decays toward 1, but
+    // never below the wait of a request still missing its headers, so a
+    // tick can judge recovery without waiting for a stretched poll.
+    BridgeLoad load() const
+    {
+        const std::int64_t now = steadyNowMs();
+        BridgeLoad current = m_load;
+        current.ratio = decayedRatio(now);
+        for (const InFlight &inFlight : m_inFlight) {
+            if (!inFlight.sent || inFlight.firstByte)
+                continue;
+            const auto it = m_endpoints.constFind(inFlight.endpoint);
+            if (it == m_endpoints.cend() || it->firstByteSamples < static_cast<std::uint64_t>(m_policy.minSamples))
+                continue;
+            const double waiting = static_cast<double>(now - inFlight.sentMs) / std::max(it->baselineMs, kBaselineFloorMs);
+            current.ratio = std::max(current.ratio, waiting);
+        }
+        return current;
+    }
+
+private:
+    using Key = std::pair<std::int64_t, std::uint64_t>;
+
+    static constexpr double kEwmaAlpha = 0.2;
+    // The baseline follows slowly and never by more than kBaselineMaxStep
+    // times itself per sample, so a congested bridge cannot teach it that
+    // congestion is normal.
+    static constexpr double kBaselineAlpha = 0.01;
+    static constexpr double kBaselineMaxStep = 2.0;
+    static constexpr double kBaselineFloorMs = 20.0;
+    static constexpr double kLoadHalfLifeMs = 5000.0;
+    static constexpr std::uint64_t kLatencyWindowSamples = 512;
+
+    struct InFlight {
+        Key key;
+        QString endpoint;
+        std::int64_t sentMs = 0;
+        std::int64_t fallbackMs = 0;
+        int connectTimeoutMs = 0;
+        int responseTimeoutMs = 0;
+        bool scheduled = false;
+        bool connecting = false;
+        bool sent = false;
+        bool firstByte = false;
+    };
+
+    // Full response times drive the timeouts. The load ratio uses the time
+    // to the response headers instead, which a large poll body does not
+    // stretch.
+    struct EndpointStats {
+        LatencyHistogram current;
+        std::int64_t previousP99Ms = 0;
+        double ewmaMs = 0.0;
+        std::uint64_t samples = 0;
+        double baselineMs = 0.0;
+        std::uint64_t firstByteSamples = 0;
+    };
+
+    Key schedule(QNetworkReply *reply, std::int64_t deadlineMs)
+    {
+        const Key key{deadlineMs, ++m_sequence};
+        const bool earliest = m_deadlines.empty() || key < m_deadlines.begin()->first;
+        m_deadlines.emplace(key, reply);
+        if (earliest)
+            rearm();
+        return key;
+    }
+
+    void unschedule(const Key &key)
+    {
+        const bool earliest = !m_deadlines.empty() && m_deadlines.begin()->first == key;
+        m_deadlines.erase(key);
+        if (earliest)
+            rearm();
+    }
+
+    // Moves the reply's deadline, never past its fallback.
+    void reschedule(QNetworkReply *reply, InFlight &inFlight, std::int64_t deadlineMs)
+    {
+        deadlineMs = std::min(deadlineMs, inFlight.fallbackMs);
+        if (inFlight.scheduled) {
+            if (inFlight.key.first == deadlineMs)
+                return;
+            unschedule(inFlight.key);
+        }
+        inFlight.key = schedule(reply, deadlineMs);
+        inFlight.scheduled = true;
+    }
+
+    void markConnecting(QNetworkReply *reply)
+    {
+        auto it = m_inFlight.find(reply);
+        if (it == m_inFlight.end() || it->sent || it->connecting)
+            return;
+        it->connecting = true;
+        reschedule(reply, *it, steadyNowMs() + std::min(it->connectTimeoutMs, it->responseTimeoutMs));
+    }
+
+    void markSent(QNetworkReply *reply)
+    {
+        auto it = m_inFlight.find(reply);
+        if (it == m_inFlight.end() || it->sent)
+            return;
+        it->sent = true;
+        it->sentMs = steadyNowMs();
+        reschedule(reply, *it, it->sentMs + it->responseTimeoutMs);
+    }
+
+    // Response headers arrived. Without a requestSent signal (the request
+    // went out with its headers) this is also the send time.
+    void markFirstByte(QNetworkReply *reply)
+    {
+        markSent(reply);
+        auto it = m_inFlight.find(reply);
+        if (it == m_inFlight.end() || it->firstByte)
+            return;
+        it->firstByte = true;
+        recordFirstByte(it->endpoint, steadyNowMs() - it->sentMs);
+    }
+
+    void complete(QNetworkReply *reply)
+    {
+        auto it = m_inFlight.find(reply);
+        if (it == m_inFlight.end())
+            return;
+        // Time spent queued in QNAM is not the bridge's.
+        if (reply->error() == QNetworkReply::NoError && it->sent)
+            recordLatency(it->endpoint, steadyNowMs() - it->sentMs);
+        noteTransport(reply);
+        untrack(reply);
+    }
+
+    void noteTransport(QNetworkReply *reply)
+    {
+        if (reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) {
+            ++m_transport.http2Replies;
+            return;
+        }
+        ++m_transport.http1Replies;
+
+        // Only a failed HTTP/2 negotiation counts; a bridge that closes the
+        // connection (reboot, idle timeout) says nothing about the protocol.
+        const QNetworkReply::NetworkError error = reply->error();
+        const bool protocolError = error == QNetworkReply::ProtocolFailure
+            || error == QNetworkReply::ProtocolUnknownError;
+        const bool triedHttp2 = reply->request().attribute(QNetworkRequest::Http2AllowedAttribute).toBool();
+        if (http2Active() && triedHttp2 && protocolError && m_transport.http2Replies == 0)
+            m_transport.http2FellBack = true;
+    }
+
+    void untrack(QNetworkReply *reply)
+    {
+        auto it = m_inFlight.find(reply);
+        if (it == m_inFlight.end())
+            return;
+        const Key key = it->key;
+        const bool scheduled = it->scheduled;
+        m_inFlight.erase(it);
+        if (scheduled)
+            unschedule(key);
+    }
+
+    void recordLatency(const QString &endpoint, std::int64_t latencyMs)
+    {
+        EndpointStats &stats = m_endpoints[endpoint];
+        if (stats.current.count() >= kLatencyWindowSamples) {
+            stats.previousP99Ms = stats.current.quantile(0.99);
+            stats.current.clear();
+        }
+        stats.current.record(latencyMs);
+        const double sample = static_cast<double>(latencyMs);
+        stats.ewmaMs = stats.samples == 0 ? sample : stats.ewmaMs + kEwmaAlpha * (sample - stats.ewmaMs);
+        ++stats.samples;
+    }
+
+    void recordFirstByte(const QString &endpoint, std::int64_t firstByteMs)
+    {
+        EndpointStats &stats = m_endpoints[endpoint];
+        const double sample = static_cast<double>(firstByteMs);
+        if (stats.firstByteSamples >= static_cast<std::uint64_t>(m_policy.minSamples)) {
+            const std::int64_t now = steadyNowMs();
+            const double ratio = sample / std::max(stats.baselineMs, kBaselineFloorMs);
+            const double previous = decayedRatio(now);
+            m_load.ratio = m_load.samples == 0 ? ratio : previous + kEwmaAlpha * (ratio - previous);
+            ++m_load.samples;
+            m_loadSampleMs = now;
+        }
+        // Plain mean until the endpoint has enough samples to judge load.
+        const double baselineAlpha = stats.firstByteSamples < static_cast<std::uint64_t>(m_policy.minSamples)
+            ? 1.0 / static_cast<double>(stats.firstByteSamples + 1)
+            : kBaselineAlpha;
+        const double step = stats.firstByteSamples == 0
+            ? sample
+            : std::min(sample, stats.baselineMs * kBaselineMaxStep);
+        stats.baselineMs += baselineAlpha * (step - stats.baselineMs);
+        ++stats.firstByteSamples;
+    }
+
+    // Halves the distance of the sampled ratio to 1 every kLoadHalfLifeMs
+    // since the last sample.
+    double decayedRatio(std::int64_t nowMs) const
+    {
+        if (m_load.samples == 0 || nowMs <= m_loadSampleMs)
+            return m_load.ratio;
+        const double idleMs = static_cast<double>(nowMs - m_loadSampleMs);
+        return 1.0 + (m_load.ratio - 1.0) * std::exp2(-idleMs / kLoadHalfLifeMs);
+    }
+
+    void expire()
+    {
+        const std::int64_t now = steadyNowMs();
+        while (!m_deadlines.empty() && m_deadlines.begin()->first.first <= now) {
+            QNetworkReply *reply = m_deadlines.begin()->second;
+            m_deadlines.erase(m_deadlines.begin());
+            const auto it = m_inFlight.constFind(reply);
+            if (it != m_inFlight.cend()) {
+                // A slow but alive bridge pushes its own timeout up; a
+                // missed connect deadline says nothing about latency. A
+                // bridge that never answered counts as at least this slow.
+                if (it->sent) {
+                    recordLatency(it->endpoint, now - it->sentMs);
+                    if (!it->firstByte)
+                        recordFirstByte(it->endpoint, now - it->sentMs);
+                }
+                m_inFlight.erase(it);
+            }
+            if (!reply->isFinished()) {
+                reply->setProperty(kTimedOutProperty, true);
+                reply->abort();
+            }
+        }
+        rearm();
+    }
+
+    void rearm()
+    {
+        if (m_deadlines.empty()) {
+            m_timer.stop();
+            return;
+        }
+        const std::int64_t delay = m_deadlines.begin()->first.first - steadyNowMs();
+        m_timer.start(static_cast<int>(std::max<std::int64_t>(0, delay)));
+    }
+
+    std::map<Key, QNetworkReply *> m_deadlines;
+    QHash<QNetworkReply *, InFlight> m_inFlight;
+    QHash<QString, EndpointStats> m_endpoints;
+    TimeoutPolicy m_policy;
+    TransportStats m_transport;
+    BridgeLoad m_load;
+    std::int64_t m_loadSampleMs = 0;
+    std::uint64_t m_sequence = 0;
+    QTimer m_timer;
+};
+
 HttpClient::HttpClient(QNetworkAccessManager *manager)
     : m_manager(manager)
+    , m_tracker(std::make_unique<RequestTracker>())
+{
+}
+
+HttpClient::~HttpClient()
+{
+    abortAll();
+}
+
+void HttpClient::abortAll()
+{
+    m_tracker->abortAll();
+}
+
+std::size_t HttpClient::inFlightCount() const
+{
+    return m_tracker->size();
+}
+
+void HttpClient::setTimeoutPolicy(const TimeoutPolicy &policy)
+{
+    m_tracker->setPolicy(policy);
+}
+
+const TimeoutPolicy &HttpClient::timeoutPolicy() const
+{
+    return m_tracker->policy();
+}
+
+std::vector<EndpointLatency> HttpClient::endpointLatency() const
+{
+    return m_tracker->endpointLatency();
+}
+
+void HttpClient::setHttp2Allowed(bool allowed)
+{
+    m_tracker->setHttp2Allowed(allowed);
+}
+
+bool HttpClient::http2Active() const
+{
+    return m_tracker->http2Active();
+}
+
+BridgeLoad HttpClient::bridgeLoad() const
+{
+    return m_tracker->load();
+}
+
+TransportStats HttpClient::transportStats() const
 {
+    return m_tracker->transport();
 }
 
 QString HttpClient::effectiveHost(const ConnectionSettings &settings)
@@ -40,6 +474,53 @@ HttpResult HttpClient::get(const ConnectionSettings &settings,
     return request(settings, QByteArrayLiteral("GET"), path, {}, includeAppKey, accept, timeoutMs);
 }
 
+HttpResult HttpClient::getStreaming(const ConnectionSettings &settings,
+                                    const QString &path,
+                                    const ChunkHandler &onChunk,
+                                    bool includeAppKey,
+                                    int timeoutMs) const
+{
+    HttpResult result;
+    QNetworkReply *reply = startRequest(settings,
+                                        QByteArrayLiteral("GET"),
+                                        path,
+                                        {},
+                                        includeAppKey,
+                                        QByteArrayLiteral("application/json"),
+                                        timeoutMs,
+                                        &result.error);
+    if (!reply)
+        return result;
+
+    bool rejected = false;
+    auto drain = [reply, &onChunk, &rejected]() {
+        if (rejected)
+            return;
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status < 200 || status >= 300)
+            return;
+        const QByteArray chunk = reply->readAll();
+        if (!chunk.isEmpty() && !onChunk(chunk)) {
+            rejected = true;
+            reply->abort();
+        }
+    };
+
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::readyRead, &loop, drain);
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    if (!reply->isFinished())
+        loop.exec();
+    drain();
+
+    result = takeResult(reply);
+    if (rejected) {
+        result.ok = false;
+        result.error = QStringLiteral("Response body rejected");
+    }
+    return result;
+}
+
 HttpResult HttpClient::postJson(const ConnectionSettings &settings,
                                 const QString &path,
                                 const QByteArray &payload,
@@ -76,46 +557,52 @@ bool HttpClient::putJsonAsync(const ConnectionSettings &settings,
                               bool includeAppKey,
                               QString *error) const
 {
-    if (!m_manager) {
-        if (error)
-            *error = QStringLiteral("Network manager unavailable");
-        return false;
-    }
-
-    QNetworkRequest request;
-    if (!buildRequest(settings,
-                      path,
-                      includeAppKey,
-                      QByteArrayLiteral("application/json"),
-                      true,
-                      &request,
-                      error)) {
+    QNetworkReply *reply = startRequest(settings,
+                                        QByteArrayLiteral("PUT"),
+                                        path,
+                                        payload,
+                                        includeAppKey,
+                                        QByteArrayLiteral("application/json"),
+                                        0,
+                                        error);
+    if (!reply)
         return false;
-    }
-
-    QNetworkReply *reply = m_manager->sendCustomRequest(request, QByteArrayLiteral("PUT"), payload);
-    if (!reply) {
-        if (error)
-            *error = QStringLiteral("Failed to create network request");
-        return false;
-    }
-
-    auto *timeout = new QTimer(reply);
-    timeout->setSingleShot(true);
-    timeout->setInterval(kDefaultRequestTimeoutMs);
-    QObject::connect(timeout, &QTimer::timeout, reply, [reply]() {
-        if (!reply->isFinished())
-            reply->abort();
-    });
-    QObject::connect(reply, &QNetworkReply::finished, timeout, &QTimer::stop);
-    timeout->start();
 
     QObject::connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
-    if (error)
-        error->clear();
     return true;
 }
 
+QNetworkReply *HttpClient::requestAsync(const ConnectionSettings &settings,
+                                        const QByteArray &method,
+                                        const QString &path,
+                                        const QByteArray &payload,
+                                        bool includeAppKey,
+                                        int timeoutMs,
+                                        ResultHandler done,
+                                        const QObject *context,
+                                        QString *error) const
+{
+    QNetworkReply *reply = startRequest(settings,
+                                        method,
+                                        path,
+                                        payload,
+                                        includeAppKey,
+                                        QByteArrayLiteral("application/json"),
+                                        timeoutMs,
+                                        error);
+    if (!reply)
+        return nullptr;
+
+    // Released even if the context is destroyed before the reply finishes.
+    QObject::connect(reply, &QNetworkReply::finished, reply, &QObject::deleteLater);
+    QObject::connect(reply, &QNetworkReply::finished, context ? context : reply, [reply, done = std::move(done)]() {
+        const HttpResult result = takeResult(reply);
+        if (done)
+            done(result);
+    });
+    return reply;
+}
+
 bool HttpClient::buildRequest(const ConnectionSettings &settings,
                               const QString &path,
                               bool includeAppKey,
@@ -157,6 +644,7 @@ bool HttpClient::buildRequest(const ConnectionSettings &settings,
         out.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
     if (includeAppKey && !settings.appKey.isEmpty())
         out.setRawHeader("hue-application-key", settings.appKey.toUtf8());
+    out.setAttribute(QNetworkRequest::Http2AllowedAttribute, useTls && m_tracker->http2Active());
 
 #if QT_CONFIG(ssl)
     if (useTls) {
@@ -172,19 +660,19 @@ bool HttpClient::buildRequest(const ConnectionSettings &settings,
     return true;
 }
 
-HttpResult HttpClient::request(const ConnectionSettings &settings,
-                               const QByteArray &method,
-                               const QString &path,
-                               const QByteArray &payload,
-                               bool includeAppKey,
-                               const QByteArray &accept,
-                               int timeoutMs) const
+QNetworkReply *HttpClient::startRequest(const ConnectionSettings &settings,
+                                        const QByteArray &method,
+                                        const QString &path,
+                                        const QByteArray &payload,
+                                        bool includeAppKey,
+                                        const QByteArray &accept,
+                                        int timeoutMs,
+                                        QString *error) const
 {
-    HttpResult result;
-
     if (!m_manager) {
-        result.error = QStringLiteral("Network manager unavailable");
-        return result;
+        if (error)
+            *error = QStringLiteral("Network manager unavailable");
+        return nullptr;
     }
 
     QNetworkRequest requestObj;
@@ -194,8 +682,8 @@ HttpResult HttpClient::request(const ConnectionSettings &settings,
                       accept,
                       !payload.isEmpty(),
                       &requestObj,
-                      &result.error)) {
-        return result;
+                      error)) {
+        return nullptr;
     }
 
     QNetworkReply *reply = nullptr;
@@ -208,27 +696,27 @@ HttpResult HttpClient::request(const ConnectionSettings &settings,
     }
 
     if (!reply) {
-        result.error = QStringLiteral("Failed to create network request");
-        return result;
+        if (error)
+            *error = QStringLiteral("Failed to create network request");
+        return nullptr;
     }
 
-    QEventLoop loop;
-    QTimer timer;
-    timer.setSingleShot(true);
-    bool timedOut = false;
-
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    QObject::connect(&timer, &QTimer::timeout, &loop, [&]() {
-        timedOut = true;
-        loop.quit();
-    });
+    const QString endpoint = endpointKey(method, path);
+    m_tracker->track(reply,
+                     endpoint,
+                     m_tracker->policy().connectTimeoutMs,
+                     timeoutMs > 0 ? timeoutMs : m_tracker->timeoutFor(endpoint));
+    if (error)
+        error->clear();
+    return reply;
+}
 
-    timer.start(timeoutMs > 0 ? timeoutMs : kDefaultRequestTimeoutMs);
-    loop.exec();
+HttpResult HttpClient::takeResult(QNetworkReply *reply)
+{
+    HttpResult result;
+    reply->deleteLater();
 
-    if (timedOut) {
-        reply->abort();
-        reply->deleteLater();
+    if (reply->property(kTimedOutProperty).toBool()) {
         result.error = QStringLiteral("Request timed out");
         return result;
     }
@@ -238,7 +726,6 @@ HttpResult HttpClient::request(const ConnectionSettings &settings,
 
     if (reply->error() != QNetworkReply::NoError) {
         result.error = reply->errorString();
-        reply->deleteLater();
         return result;
     }
 
@@ -247,9 +734,28 @@ HttpResult HttpClient::request(const ConnectionSettings &settings,
     } else {
         result.error = QStringLiteral("HTTP %1").arg(result.statusCode);
     }
-
-    reply->deleteLater();
     return result;
 }
 
+HttpResult HttpClient::request(const ConnectionSettings &settings,
+                               const QByteArray &method,
+                               const QString &path,
+                               const QByteArray &payload,
+                               bool includeAppKey,
+                               const QByteArray &accept,
+                               int timeoutMs) const
+{
+    HttpResult result;
+    QNetworkReply *reply = startRequest(settings, method, path, payload, includeAppKey, accept, timeoutMs, &result.error);
+    if (!reply)
+        return result;
+
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    if (!reply->isFinished())
+        loop.exec();
+
+    return takeResult(reply);
+}
+
 } // namespace phicore::hue::ipc
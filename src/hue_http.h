@@ -1,10 +1,18 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include <QString>
 #include <QByteArray>
 
 class QNetworkAccessManager;
+class QNetworkReply;
 class QNetworkRequest;
+class QObject;
 
 namespace phicore::hue::ipc {
 
@@ -16,6 +24,50 @@ struct ConnectionSettings {
     QString appKey;
 };
 
+// Request timeouts are derived per endpoint from observed latency:
+// clamp(max(p99, ewma) * p99Multiplier, minTimeoutMs, maxTimeoutMs) once
+// minSamples responses were seen, maxTimeoutMs before that, measured from
+// the moment the request was sent. The connect timeout runs from the
+// connection attempt until then. Every request also gets a fallback deadline
+// of maxTimeoutMs + connectTimeoutMs + its timeout from the moment it is
+// issued, which covers waiting for a connection; the other deadlines only
+// shorten it.
+struct TimeoutPolicy {
+    int connectTimeoutMs = 3000;
+    int minTimeoutMs = 1000;
+    int maxTimeoutMs = 10000;
+    double p99Multiplier = 3.0;
+    int minSamples = 20;
+
+    bool operator==(const TimeoutPolicy &) const = default;
+};
+
+struct EndpointLatency {
+    QString endpoint;
+    std::uint64_t samples = 0;
+    double ewmaMs = 0.0;
+    // Usual time to the response headers, the reference of the load ratio.
+    double baselineMs = 0.0;
+    std::int64_t p99Ms = 0;
+    int timeoutMs = 0;
+};
+
+// Bridge-wide time from sending a request to its response headers, relative
+// to each endpoint's own baseline, so a slow poll and a fast PUT weigh the
+// same. A ratio of 1 is normal.
+struct BridgeLoad {
+    double ratio = 1.0;
+    std::uint64_t samples = 0;
+};
+
+struct TransportStats {
+    bool http2Allowed = true;
+    bool http2FellBack = false;
+    std::uint64_t http2Replies = 0;
+    std::uint64_t http1Replies = 0;
+    std::size_t maxConcurrentStreams = 0;
+};
+
 struct HttpResult {
     bool ok = false;
     int statusCode = 0;
@@ -26,25 +78,38 @@ struct HttpResult {
 class HttpClient
 {
 public:
+    using ResultHandler = std::function<void(const HttpResult &)>;
+    using ChunkHandler = std::function<bool(const QByteArray &chunk)>;
+
     explicit HttpClient(QNetworkAccessManager *manager);
+    ~HttpClient();
 
     HttpResult get(const ConnectionSettings &settings,
                    const QString &path,
                    bool includeAppKey = true,
                    const QByteArray &accept = QByteArrayLiteral("application/json"),
-                   int timeoutMs = 10000) const;
+                   int timeoutMs = 0) const;
+
+    // Hands a 2xx body to onChunk piece by piece as it arrives instead of
+    // buffering it; payload then stays empty. Other statuses are buffered as
+    // usual for error extraction. Returning false from onChunk aborts.
+    HttpResult getStreaming(const ConnectionSettings &settings,
+                            const QString &path,
+                            const ChunkHandler &onChunk,
+                            bool includeAppKey = true,
+                            int timeoutMs = 0) const;
 
     HttpResult postJson(const ConnectionSettings &settings,
                         const QString &path,
                         const QByteArray &payload,
                         bool includeAppKey,
-                        int timeoutMs = 10000) const;
+                        int timeoutMs = 0) const;
 
     HttpResult putJson(const ConnectionSettings &settings,
                        const QString &path,
                        const QByteArray &payload,
                        bool includeAppKey = true,
-                       int timeoutMs = 10000) const;
+                       int timeoutMs = 0) const;
 
     bool putJsonAsync(const ConnectionSettings &settings,
                       const QString &path,
@@ -52,9 +117,42 @@ public:
                       bool includeAppKey = true,
                       QString *error = nullptr) const;
 
+    // Non-blocking request; done runs on the event loop once the reply has
+    // finished, failed or timed out, unless context was destroyed first.
+    // Returns the reply so callers can abort it, or nullptr if it was not sent.
+    QNetworkReply *requestAsync(const ConnectionSettings &settings,
+                                const QByteArray &method,
+                                const QString &path,
+                                const QByteArray &payload,
+                                bool includeAppKey,
+                                int timeoutMs,
+                                ResultHandler done,
+                                const QObject *context = nullptr,
+                                QString *error = nullptr) const;
+
+    // Aborts every request that is still in flight, e.g. on adapter stop.
+    void abortAll();
+    std::size_t inFlightCount() const;
+
+    // A timeoutMs of 0 in the request methods uses the adaptive timeout.
+    void setTimeoutPolicy(const TimeoutPolicy &policy);
+    const TimeoutPolicy &timeoutPolicy() const;
+    std::vector<EndpointLatency> endpointLatency() const;
+    BridgeLoad bridgeLoad() const;
+
+    // HTTP/2 is negotiated via ALPN and multiplexes all requests of the
+    // client over one TLS connection. A protocol failure of an HTTP/2
+    // attempt before the first successful HTTP/2 reply switches the client
+    // to HTTP/1.1 until setHttp2Allowed is called again.
+    void setHttp2Allowed(bool allowed);
+    bool http2Active() const;
+    TransportStats transportStats() const;
+
     static QString effectiveHost(const ConnectionSettings &settings);
 
 private:
+    class RequestTracker;
+
     bool buildRequest(const ConnectionSettings &settings,
                       const QString &path,
                       bool includeAppKey,
@@ -63,6 +161,16 @@ private:
                       QNetworkRequest *request,
                       QString *error = nullptr) const;
 
+    QNetworkReply *startRequest(const ConnectionSettings &settings,
+                                const QByteArray &method,
+                                const QString &path,
+                                const QByteArray &payload,
+                                bool includeAppKey,
+                                const QByteArray &accept,
+                                int timeoutMs,
+                                QString *error) const;
+    static HttpResult takeResult(QNetworkReply *reply);
+
     HttpResult request(const ConnectionSettings &settings,
                        const QByteArray &method,
                        const QString &path,
@@ -72,6 +180,7 @@ private:
                        int timeoutMs) const;
 
     QNetworkAccessManager *m_manager = nullptr;
+    std::unique_ptr<RequestTracker> m_tracker;
 };
 
 } // namespace phicore::hue::ipc
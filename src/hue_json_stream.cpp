@@ -0,0 +1,173 @@
+#include "hue_json_stream.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace phicore::hue::ipc {
+
+namespace {
+
+constexpr qsizetype kMaxKeyBytes = 64;
+// A single Hue resource is a few KiB; anything this large is not one.
+constexpr qsizetype kMaxElementBytes = 4 * 1024 * 1024;
+
+enum ElementKind { ContainerElement, StringElement, PrimitiveElement };
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+} // namespace
+
+JsonArraySplitter::JsonArraySplitter(QByteArray arrayKey, ElementHandler onElement)
+    : m_arrayKey(std::move(arrayKey))
+    , m_onElement(std::move(onElement))
+{
+}
+
+bool JsonArraySplitter::fail()
+{
+    m_failed = true;
+    m_inElement = false;
+    m_element.clear();
+    return false;
+}
+
+bool JsonArraySplitter::emitElement()
+{
+    m_inElement = false;
+    if (m_element.size() > kMaxElementBytes)
+        return fail();
+    ++m_elements;
+    m_peakElementBytes = std::max(m_peakElementBytes, static_cast<std::size_t>(m_element.size()));
+    const bool keepGoing = !m_onElement || m_onElement(m_element);
+    // Keeps the capacity for the next element.
+    m_element.resize(0);
+    if (!keepGoing)
+        return fail();
+    return true;
+}
+
+bool JsonArraySplitter::feed(const char *data, qsizetype size)
+{
+    if (m_failed)
+        return false;
+
+    // Element bytes are copied as whole spans rather than per character.
+    qsizetype spanStart = m_inElement ? 0 : -1;
+    auto flushSpan = [&](qsizetype end) {
+        if (spanStart >= 0 && end > spanStart)
+            m_element.append(data + spanStart, end - spanStart);
+        spanStart = -1;
+    };
+
+    for (qsizetype i = 0; i < size; ++i) {
+        const char c = data[i];
+
+        if (m_inString) {
+            if (m_escape) {
+                m_escape = false;
+            } else if (c == '\\') {
+                m_escape = true;
+            } else if (c == '"') {
+                m_inString = false;
+                if (m_depth == 1) {
+                    if (!m_afterColon)
+                        m_lastKey = m_keyOverflow ? QByteArray() : m_key;
+                    else
+                        m_afterColon = false;
+                }
+                if (m_inElement && m_elementKind == StringElement && m_depth == 2) {
+                    flushSpan(i + 1);
+                    if (!emitElement())
+                        return false;
+                }
+                continue;
+            }
+            if (m_depth == 1 && !m_afterColon) {
+                if (m_key.size() < kMaxKeyBytes)
+                    m_key.append(c);
+                else
+                    m_keyOverflow = true;
+            }
+            continue;
+        }
+
+        if (isSpace(c))
+            continue;
+
+        if (m_inElement && m_elementKind == PrimitiveElement && m_depth == 2 && (c == ',' || c == ']')) {
+            flushSpan(i);
+            if (!emitElement())
+                return false;
+        }
+
+        if (m_inArray && m_depth == 2 && !m_inElement && c != ',' && c != ']') {
+            m_inElement = true;
+            m_elementKind = (c == '{' || c == '[') ? ContainerElement
+                : (c == '"') ? StringElement
+                             : PrimitiveElement;
+            spanStart = i;
+        }
+
+        switch (c) {
+        case '"':
+            if (m_depth == 0)
+                return fail();
+            m_inString = true;
+            if (m_depth == 1 && !m_afterColon) {
+                m_key.resize(0);
+                m_keyOverflow = false;
+            }
+            break;
+        case '{':
+        case '[':
+            if (m_depth == 0 && c != '{')
+                return fail();
+            if (m_depth == 1) {
+                if (!m_afterColon)
+                    return fail();
+                m_afterColon = false;
+                if (c == '[' && !m_inArray && !m_arrayClosed && m_lastKey == m_arrayKey)
+                    m_inArray = true;
+            }
+            ++m_depth;
+            break;
+        case '}':
+        case ']':
+            if (m_depth == 0)
+                return fail();
+            --m_depth;
+            if (m_inArray && m_depth == 1) {
+                m_inArray = false;
+                m_arrayClosed = true;
+            }
+            if (m_inElement && m_elementKind == ContainerElement && m_depth == 2) {
+                flushSpan(i + 1);
+                if (!emitElement())
+                    return false;
+            }
+            break;
+        case ':':
+            if (m_depth == 1)
+                m_afterColon = true;
+            break;
+        case ',':
+            if (m_depth == 1)
+                m_afterColon = false;
+            break;
+        default:
+            if (m_depth == 0)
+                return fail();
+            break;
+        }
+    }
+
+    flushSpan(size);
+    if (m_inElement && m_element.size() > kMaxElementBytes)
+        return fail();
+    return true;
+}
+
+} // namespace phicore::hue::ipc
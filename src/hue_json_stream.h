@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include <QByteArray>
+
+namespace phicore::hue::ipc {
+
+// Incremental scanner for responses shaped like {"data": [ ... ], ...}.
+// Bytes are fed as they arrive and every complete element of the named
+// top-level array is handed out on its own, so only the element currently
+// being received is buffered, never the whole body.
+class JsonArraySplitter
+{
+public:
+    // Returning false from the handler stops the scan.
+    using ElementHandler = std::function<bool(const QByteArray &element)>;
+
+    JsonArraySplitter(QByteArray arrayKey, ElementHandler onElement);
+
+    // Returns false once the input is malformed or the handler stopped.
+    bool feed(const char *data, qsizetype size);
+    bool feed(const QByteArray &chunk) { return feed(chunk.constData(), chunk.size()); }
+
+    // True once the array has been closed and the enclosing object ended.
+    bool complete() const { return m_arrayClosed && m_depth == 0 && !m_failed; }
+    bool failed() const { return m_failed; }
+    std::size_t elementCount() const { return m_elements; }
+    std::size_t peakElementBytes() const { return m_peakElementBytes; }
+
+private:
+    bool fail();
+    bool emitElement();
+
+    QByteArray m_arrayKey;
+    ElementHandler m_onElement;
+
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escape = false;
+    bool m_afterColon = false;
+    bool m_keyOverflow = false;
+    QByteArray m_key;
+    QByteArray m_lastKey;
+
+    bool m_inArray = false;
+    bool m_arrayClosed = false;
+    bool m_inElement = false;
+    int m_elementKind = 0;
+    QByteArray m_element;
+
+    bool m_failed = false;
+    std::size_t m_elements = 0;
+    std::size_t m_peakElementBytes = 0;
+};
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,58 @@
+#include "hue_latency.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace phicore::hue::ipc {
+
+void LatencyHistogram::record(std::int64_t value)
+{
+    value = std::max<std::int64_t>(0, value);
+    ++m_counts[static_cast<std::size_t>(bucketFor(value))];
+    ++m_count;
+    m_max = std::max(m_max, value);
+}
+
+void LatencyHistogram::clear()
+{
+    m_counts.fill(0);
+    m_count = 0;
+    m_max = 0;
+}
+
+std::int64_t LatencyHistogram::quantile(double q) const
+{
+    if (m_count == 0)
+        return 0;
+
+    const auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(m_count)));
+    std::uint64_t seen = 0;
+    for (int bucket = 0; bucket < kBuckets; ++bucket) {
+        seen += m_counts[static_cast<std::size_t>(bucket)];
+        if (seen >= std::max<std::uint64_t>(rank, 1))
+            return std::min(bucketUpperBound(bucket), m_max);
+    }
+    return m_max;
+}
+
+int LatencyHistogram::bucketFor(std::int64_t value)
+{
+    if (value < 4)
+        return static_cast<int>(value);
+    const auto unsignedValue = static_cast<std::uint64_t>(value);
+    const int octave = std::bit_width(unsignedValue) - 1;
+    const int sub = static_cast<int>((unsignedValue >> (octave - 2)) & 3U);
+    return std::min(kBuckets - 1, 4 * (octave - 1) + sub);
+}
+
+std::int64_t LatencyHistogram::bucketUpperBound(int bucket)
+{
+    if (bucket < 4)
+        return bucket;
+    const int octave = bucket / 4 + 1;
+    const int sub = bucket % 4;
+    return (static_cast<std::int64_t>(4 + sub + 1) << (octave - 2)) - 1;
+}
+
+} // namespace phicore::hue::ipc
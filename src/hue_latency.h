@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace phicore::hue::ipc {
+
+// Log-linear histogram (four buckets per power of two) for latency samples.
+// Quantiles are reported as the upper bound of the matching bucket, which
+// keeps the relative error below 25 % at a fixed 1 KiB footprint.
+class LatencyHistogram
+{
+public:
+    void record(std::int64_t value);
+    void clear();
+
+    std::uint64_t count() const { return m_count; }
+    std::int64_t max() const { return m_max; }
+    std::int64_t quantile(double q) const;
+
+private:
+    static constexpr int kBuckets = 128;
+
+    static int bucketFor(std::int64_t value);
+    static std::int64_t bucketUpperBound(int bucket);
+
+    std::array<std::uint64_t, kBuckets> m_counts{};
+    std::uint64_t m_count = 0;
+    std::int64_t m_max = 0;
+};
+
+} // namespace phicore::hue::ipc
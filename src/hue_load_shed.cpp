@@ -0,0 +1,83 @@
+#include "hue_load_shed.h"
+
+namespace phicore::hue::ipc {
+
+namespace {
+
+constexpr std::size_t kMaxDecisions = 32;
+
+} // namespace
+
+void LoadShedder::setPolicy(const LoadShedPolicy &policy)
+{
+    m_policy = policy;
+}
+
+bool LoadShedder::update(const BridgeLoad &load, std::int64_t nowMs)
+{
+    const bool sampled = load.samples != m_load.samples;
+    m_load = load;
+
+    if (!m_policy.enabled) {
+        if (!m_active)
+            return false;
+        m_stats.shedMs += nowMs - m_changedMs;
+        m_active = false;
+        m_changedMs = nowMs;
+        ++m_stats.recoveries;
+        record("disabled", nowMs);
+        return true;
+    }
+
+    if (!m_active) {
+        if (!sampled || load.ratio < m_policy.enterRatio)
+            return false;
+        m_active = true;
+        m_changedMs = nowMs;
+        m_calmSinceMs = 0;
+        ++m_stats.activations;
+        record("shed", nowMs);
+        return true;
+    }
+
+    if (load.ratio > m_policy.exitRatio) {
+        m_calmSinceMs = 0;
+        return false;
+    }
+    if (m_calmSinceMs == 0)
+        m_calmSinceMs = nowMs;
+    if (nowMs - m_calmSinceMs < m_policy.recoveryMs)
+        return false;
+    m_stats.shedMs += nowMs - m_changedMs;
+    m_active = false;
+    m_changedMs = nowMs;
+    ++m_stats.recoveries;
+    record("recover", nowMs);
+    return true;
+}
+
+void LoadShedder::noteDeferredRename(std::int64_t nowMs)
+{
+    ++m_stats.deferredRenames;
+    record("deferRename", nowMs);
+}
+
+void LoadShedder::noteDeferredDiscovery(std::int64_t nowMs)
+{
+    ++m_stats.deferredDiscoveries;
+    record("deferDiscovery", nowMs);
+}
+
+std::int64_t LoadShedder::shedMs(std::int64_t nowMs) const
+{
+    return m_active ? m_stats.shedMs + (nowMs - m_changedMs) : m_stats.shedMs;
+}
+
+void LoadShedder::record(const char *action, std::int64_t nowMs)
+{
+    if (m_decisions.size() >= kMaxDecisions)
+        m_decisions.pop_front();
+    m_decisions.push_back(Decision{nowMs, action, m_load.ratio});
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "hue_http.h"
+
+namespace phicore::hue::ipc {
+
+// Shedding starts once the bridge load ratio reaches enterRatio and ends
+// after it stayed at or below exitRatio for recoveryMs.
+struct LoadShedPolicy {
+    bool enabled = true;
+    double enterRatio = 3.0;
+    double exitRatio = 1.5;
+    int recoveryMs = 15000;
+    int pollStretch = 4;
+    int coalesceMs = 300;
+
+    bool operator==(const LoadShedPolicy &) const = default;
+};
+
+// Throttling state of one bridge session. Every decision is counted and the
+// most recent ones are kept for diagnostics.
+class LoadShedder
+{
+public:
+    struct Decision {
+        std::int64_t tsMs = 0;
+        const char *action = "";
+        double ratio = 1.0;
+    };
+
+    struct Stats {
+        std::uint64_t activations = 0;
+        std::uint64_t recoveries = 0;
+        std::uint64_t stretchedPolls = 0;
+        std::uint64_t throttledPollRequests = 0;
+        std::uint64_t coalescedCommands = 0;
+        std::uint64_t deferredRenames = 0;
+        std::uint64_t deferredDiscoveries = 0;
+        std::int64_t shedMs = 0;
+    };
+
+    void setPolicy(const LoadShedPolicy &policy);
+    const LoadShedPolicy &policy() const { return m_policy; }
+
+    // Returns true when shedding was switched on or off.
+    bool update(const BridgeLoad &load, std::int64_t nowMs);
+    bool active() const { return m_active; }
+    double ratio() const { return m_load.ratio; }
+    std::uint64_t samples() const { return m_load.samples; }
+    std::int64_t activeSinceMs() const { return m_active ? m_changedMs : 0; }
+
+    int pollIntervalMs(int baseMs) const { return m_active ? baseMs * m_policy.pollStretch : baseMs; }
+    // 0 sends commands right away.
+    int coalesceMs() const { return m_active ? m_policy.coalesceMs : 0; }
+
+    void noteStretchedPoll() { ++m_stats.stretchedPolls; }
+    void noteThrottledPollRequest() { ++m_stats.throttledPollRequests; }
+    void noteCoalescedCommand() { ++m_stats.coalescedCommands; }
+    void noteDeferredRename(std::int64_t nowMs);
+    void noteDeferredDiscovery(std::int64_t nowMs);
+    void noteReleased(const char *action, std::int64_t nowMs) { record(action, nowMs); }
+
+    const Stats &stats() const { return m_stats; }
+    std::int64_t shedMs(std::int64_t nowMs) const;
+    const std::deque<Decision> &decisions() const { return m_decisions; }
+
+private:
+    void record(const char *action, std::int64_t nowMs);
+
+    LoadShedPolicy m_policy;
+    BridgeLoad m_load;
+    bool m_active = false;
+    std::int64_t m_changedMs = 0;
+    std::int64_t m_calmSinceMs = 0;
+    Stats m_stats;
+    std::deque<Decision> m_decisions;
+};
+
+} // namespace phicore::hue::ipc
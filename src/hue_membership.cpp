@@ -0,0 +1,85 @@
+#include "hue_membership.h"
+
+#include <QSet>
+
+#include "hue_footprint.h"
+
+namespace phicore::hue::ipc {
+
+bool MembershipIndex::setMembers(const QString &groupExternalId, const QStringList &deviceExternalIds)
+{
+    const auto it = m_membersByGroup.constFind(groupExternalId);
+    if (it != m_membersByGroup.cend() && it.value() == deviceExternalIds)
+        return false;
+
+    const QStringList previous = it != m_membersByGroup.cend() ? it.value() : QStringList{};
+    const QSet<QString> before(previous.cbegin(), previous.cend());
+    const QSet<QString> after(deviceExternalIds.cbegin(), deviceExternalIds.cend());
+    for (const QString &deviceExternalId : before) {
+        if (!after.contains(deviceExternalId))
+            unlink(deviceExternalId, groupExternalId);
+    }
+    for (const QString &deviceExternalId : after) {
+        if (!before.contains(deviceExternalId))
+            link(deviceExternalId, groupExternalId);
+    }
+
+    m_membersByGroup.insert(groupExternalId, deviceExternalIds);
+    return true;
+}
+
+bool MembershipIndex::removeGroup(const QString &groupExternalId)
+{
+    const auto it = m_membersByGroup.constFind(groupExternalId);
+    if (it == m_membersByGroup.cend())
+        return false;
+    for (const QString &deviceExternalId : it.value())
+        unlink(deviceExternalId, groupExternalId);
+    m_membersByGroup.erase(it);
+    return true;
+}
+
+QStringList MembershipIndex::sync(const QHash<QString, QStringList> &membersByGroup)
+{
+    QStringList changed;
+    const QStringList known = m_membersByGroup.keys();
+    for (const QString &groupExternalId : known) {
+        if (!membersByGroup.contains(groupExternalId) && removeGroup(groupExternalId))
+            changed.push_back(groupExternalId);
+    }
+    for (auto it = membersByGroup.cbegin(); it != membersByGroup.cend(); ++it) {
+        if (setMembers(it.key(), it.value()))
+            changed.push_back(it.key());
+    }
+    return changed;
+}
+
+void MembershipIndex::clear()
+{
+    m_membersByGroup.clear();
+    m_groupsByDevice.clear();
+}
+
+std::size_t MembershipIndex::bytes() const
+{
+    return hashBytes(m_membersByGroup) + hashBytes(m_groupsByDevice);
+}
+
+void MembershipIndex::link(const QString &deviceExternalId, const QString &groupExternalId)
+{
+    QStringList &groups = m_groupsByDevice[deviceExternalId];
+    if (!groups.contains(groupExternalId))
+        groups.push_back(groupExternalId);
+}
+
+void MembershipIndex::unlink(const QString &deviceExternalId, const QString &groupExternalId)
+{
+    const auto it = m_groupsByDevice.find(deviceExternalId);
+    if (it == m_groupsByDevice.end())
+        return;
+    it->removeAll(groupExternalId);
+    if (it->isEmpty())
+        m_groupsByDevice.erase(it);
+}
+
+} // namespace phicore::hue::ipc
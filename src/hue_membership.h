@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+namespace phicore::hue::ipc {
+
+// Room/zone membership in both directions. Updates are applied per group as
+// deltas, so unchanged groups keep their lists and only the devices that
+// joined or left a group touch the reverse index.
+class MembershipIndex
+{
+public:
+    bool setMembers(const QString &groupExternalId, const QStringList &deviceExternalIds);
+    bool removeGroup(const QString &groupExternalId);
+    // Applies a complete membership set; returns the groups that changed,
+    // including those that disappeared.
+    QStringList sync(const QHash<QString, QStringList> &membersByGroup);
+    void clear();
+
+    bool contains(const QString &groupExternalId) const { return m_membersByGroup.contains(groupExternalId); }
+    QStringList members(const QString &groupExternalId) const { return m_membersByGroup.value(groupExternalId); }
+    QStringList groupsForDevice(const QString &deviceExternalId) const
+    {
+        return m_groupsByDevice.value(deviceExternalId);
+    }
+    QStringList groups() const { return m_membersByGroup.keys(); }
+
+    std::size_t size() const { return static_cast<std::size_t>(m_membersByGroup.size()); }
+    std::size_t bytes() const;
+
+private:
+    void link(const QString &deviceExternalId, const QString &groupExternalId);
+    void unlink(const QString &deviceExternalId, const QString &groupExternalId);
+
+    QHash<QString, QStringList> m_membersByGroup;
+    QHash<QString, QStringList> m_groupsByDevice;
+};
+
+} // namespace phicore::hue::ipc
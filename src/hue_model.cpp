@@ -3,12 +3,23 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QRegularExpression>
 #include <QSet>
+#include <QStringList>
+
+#include "hue_footprint.h"
+#include "hue_stage_timer.h"
 
 namespace phicore::hue::ipc {
 
@@ -31,85 +42,141 @@ QString deviceNameFromObjects(const QJsonObject &deviceObj)
     return QStringLiteral("Hue Device");
 }
 
-v1::Channel makeOnChannel(bool value)
+struct DescriptorPool {
+    std::mutex mutex;
+    std::unordered_map<std::string, ChannelDescriptorPtr> descriptors;
+};
+
+DescriptorPool &descriptorPool()
+{
+    static DescriptorPool pool;
+    return pool;
+}
+
+template <typename Build>
+ChannelDescriptorPtr internDescriptor(const std::string &signature, Build &&build)
+{
+    DescriptorPool &pool = descriptorPool();
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    auto it = pool.descriptors.find(signature);
+    if (it == pool.descriptors.end())
+        it = pool.descriptors.emplace(signature, std::make_shared<const v1::Channel>(build())).first;
+    return it->second;
+}
+
+struct ProductPool {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const ProductRecord>> records;
+};
+
+ProductPool &productPool()
+{
+    static ProductPool pool;
+    return pool;
+}
+
+ChannelSlot makeSlot(ChannelDescriptorPtr descriptor, std::optional<v1::ScalarValue> value)
 {
-    v1::Channel channel;
-    channel.externalId = "on";
-    channel.name = "Power";
-    channel.kind = v1::ChannelKind::PowerOnOff;
-    channel.dataType = v1::ChannelDataType::Bool;
-    channel.flags = v1::kChannelFlagDefaultWrite;
-    channel.hasValue = true;
-    channel.lastValue = value;
-    return channel;
+    ChannelSlot slot;
+    slot.descriptor = std::move(descriptor);
+    if (value.has_value()) {
+        slot.hasValue = true;
+        slot.value = std::move(*value);
+    }
+    return slot;
 }
 
-v1::Channel makeBrightnessChannel(double value)
+ChannelSlot makeOnChannel(bool value)
 {
-    v1::Channel channel;
-    channel.externalId = "bri";
-    channel.name = "Brightness";
-    channel.kind = v1::ChannelKind::Brightness;
-    channel.dataType = v1::ChannelDataType::Float;
-    channel.flags = v1::kChannelFlagDefaultWrite;
-    channel.minValue = 0.0;
-    channel.maxValue = 100.0;
-    channel.stepValue = 0.1;
-    channel.hasValue = true;
-    channel.lastValue = std::clamp(value, 0.0, 100.0);
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "on";
+        channel.name = "Power";
+        channel.kind = v1::ChannelKind::PowerOnOff;
+        channel.dataType = v1::ChannelDataType::Bool;
+        channel.flags = v1::kChannelFlagDefaultWrite;
+        return channel;
+    }());
+    return makeSlot(descriptor, v1::ScalarValue{value});
 }
 
-v1::Channel makeCtChannel(int value, int minValue, int maxValue)
+ChannelSlot makeBrightnessChannel(double value)
 {
-    v1::Channel channel;
-    channel.externalId = "ct";
-    channel.name = "Color temperature";
-    channel.kind = v1::ChannelKind::ColorTemperature;
-    channel.dataType = v1::ChannelDataType::Int;
-    channel.flags = v1::kChannelFlagDefaultWrite;
-    channel.unit = "mired";
-    channel.minValue = minValue;
-    channel.maxValue = maxValue;
-    channel.stepValue = 1.0;
-    channel.hasValue = true;
-    channel.lastValue = static_cast<std::int64_t>(value);
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "bri";
+        channel.name = "Brightness";
+        channel.kind = v1::ChannelKind::Brightness;
+        channel.dataType = v1::ChannelDataType::Float;
+        channel.flags = v1::kChannelFlagDefaultWrite;
+        channel.minValue = 0.0;
+        channel.maxValue = 100.0;
+        channel.stepValue = 0.1;
+        return channel;
+    }());
+    return makeSlot(descriptor, v1::ScalarValue{std::clamp(value, 0.0, 100.0)});
 }
 
-v1::Channel makeColorChannel(const QJsonObject &colorObj)
+ChannelSlot makeCtChannel(int value, int minValue, int maxValue)
 {
-    v1::Channel channel;
-    channel.externalId = "color";
-    channel.name = "Color";
-    channel.kind = v1::ChannelKind::ColorRGB;
-    channel.dataType = v1::ChannelDataType::Color;
-    channel.flags = v1::kChannelFlagDefaultWrite;
+    const std::string signature = "ct|" + std::to_string(minValue) + '|' + std::to_string(maxValue);
+    ChannelDescriptorPtr descriptor = internDescriptor(signature, [minValue, maxValue] {
+        v1::Channel channel;
+        channel.externalId = "ct";
+        channel.name = "Color temperature";
+        channel.kind = v1::ChannelKind::ColorTemperature;
+        channel.dataType = v1::ChannelDataType::Int;
+        channel.flags = v1::kChannelFlagDefaultWrite;
+        channel.unit = "mired";
+        channel.minValue = minValue;
+        channel.maxValue = maxValue;
+        channel.stepValue = 1.0;
+        return channel;
+    });
+    return makeSlot(std::move(descriptor), v1::ScalarValue{static_cast<std::int64_t>(value)});
+}
 
+ChannelSlot makeColorChannel(const QJsonObject &colorObj)
+{
+    std::vector<double> gamut;
     const QJsonObject gamutObj = colorObj.value(QStringLiteral("gamut")).toObject();
-    if (!gamutObj.isEmpty()) {
-        QJsonArray gamut;
-        auto appendPoint = [&gamut](const QJsonObject &point) {
-            if (point.isEmpty())
-                return;
-            QJsonArray arr;
-            arr.append(point.value(QStringLiteral("x")).toDouble());
-            arr.append(point.value(QStringLiteral("y")).toDouble());
-            gamut.append(arr);
-        };
-        appendPoint(gamutObj.value(QStringLiteral("red")).toObject());
-        appendPoint(gamutObj.value(QStringLiteral("green")).toObject());
-        appendPoint(gamutObj.value(QStringLiteral("blue")).toObject());
+    for (const QString &key : {QStringLiteral("red"), QStringLiteral("green"), QStringLiteral("blue")}) {
+        const QJsonObject point = gamutObj.value(key).toObject();
+        if (point.isEmpty())
+            continue;
+        gamut.push_back(point.value(QStringLiteral("x")).toDouble());
+        gamut.push_back(point.value(QStringLiteral("y")).toDouble());
+    }
+
+    std::string signature = "color";
+    if (gamut.size() >= 6) {
+        for (double coordinate : gamut) {
+            signature += '|';
+            signature += std::to_string(coordinate);
+        }
+    }
+
+    ChannelDescriptorPtr descriptor = internDescriptor(signature, [&gamut] {
+        v1::Channel channel;
+        channel.externalId = "color";
+        channel.name = "Color";
+        channel.kind = v1::ChannelKind::ColorRGB;
+        channel.dataType = v1::ChannelDataType::Color;
+        channel.flags = v1::kChannelFlagDefaultWrite;
+
+        if (gamut.size() >= 6) {
+            QJsonArray points;
+            for (std::size_t i = 0; i + 1 < gamut.size(); i += 2)
+                points.append(QJsonArray{gamut[i], gamut[i + 1]});
 
-        if (gamut.size() >= 3) {
             QJsonObject caps;
             caps.insert(QStringLiteral("space"), QStringLiteral("cie1931_xy"));
-            caps.insert(QStringLiteral("gamut"), gamut);
+            caps.insert(QStringLiteral("gamut"), points);
             channel.metaJson = QJsonDocument(caps).toJson(QJsonDocument::Compact).toStdString();
         }
-    }
-
-    return channel;
+        return channel;
+    });
+    return makeSlot(std::move(descriptor), std::nullopt);
 }
 
 QString beautifyHueEffectLabel(const QString &effect)
@@ -228,11 +295,10 @@ DeviceEntry &ensureDevice(Snapshot *snapshot, const QString &deviceId, v1::Devic
     return it.value();
 }
 
-void upsertChannel(v1::ChannelList *channels, v1::Channel channel)
+void upsertChannel(ChannelSlots *channels, ChannelSlot channel)
 {
-    const QString channelId = QString::fromStdString(channel.externalId);
-    for (v1::Channel &existing : *channels) {
-        if (QString::fromStdString(existing.externalId) != channelId)
+    for (ChannelSlot &existing : *channels) {
+        if (existing.externalId() != channel.externalId())
             continue;
         existing = std::move(channel);
         return;
@@ -240,166 +306,168 @@ void upsertChannel(v1::ChannelList *channels, v1::Channel channel)
     channels->push_back(std::move(channel));
 }
 
-v1::Channel makeBoolReadChannel(const char *externalId,
-                                const char *name,
-                                v1::ChannelKind kind,
-                                std::optional<bool> value)
+ChannelSlot makeMotionChannel(std::optional<bool> value)
 {
-    v1::Channel channel;
-    channel.externalId = externalId;
-    channel.name = name;
-    channel.kind = kind;
-    channel.dataType = v1::ChannelDataType::Bool;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "motion";
+        channel.name = "Motion";
+        channel.kind = v1::ChannelKind::Motion;
+        channel.dataType = v1::ChannelDataType::Bool;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeTemperatureChannel(std::optional<double> value)
+ChannelSlot makeTamperChannel(std::optional<bool> value)
 {
-    v1::Channel channel;
-    channel.externalId = "temperature";
-    channel.name = "Temperature";
-    channel.kind = v1::ChannelKind::Temperature;
-    channel.dataType = v1::ChannelDataType::Float;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    channel.unit = "C";
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "tamper";
+        channel.name = "Tamper";
+        channel.kind = v1::ChannelKind::Tamper;
+        channel.dataType = v1::ChannelDataType::Bool;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeIlluminanceChannel(std::optional<std::int64_t> value)
+ChannelSlot makeTemperatureChannel(std::optional<double> value)
 {
-    v1::Channel channel;
-    channel.externalId = "illuminance";
-    channel.name = "Illuminance";
-    channel.kind = v1::ChannelKind::Illuminance;
-    channel.dataType = v1::ChannelDataType::Int;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    channel.unit = "lx";
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "temperature";
+        channel.name = "Temperature";
+        channel.kind = v1::ChannelKind::Temperature;
+        channel.dataType = v1::ChannelDataType::Float;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.unit = "C";
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeBatteryChannel(std::optional<std::int64_t> value)
+ChannelSlot makeIlluminanceChannel(std::optional<std::int64_t> value)
 {
-    v1::Channel channel;
-    channel.externalId = "battery";
-    channel.name = "Battery";
-    channel.kind = v1::ChannelKind::Battery;
-    channel.dataType = v1::ChannelDataType::Int;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    channel.minValue = 0.0;
-    channel.maxValue = 100.0;
-    channel.stepValue = 1.0;
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "illuminance";
+        channel.name = "Illuminance";
+        channel.kind = v1::ChannelKind::Illuminance;
+        channel.dataType = v1::ChannelDataType::Int;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.unit = "lx";
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeMotionSensitivityChannel(std::optional<std::int64_t> value)
+ChannelSlot makeBatteryChannel(std::optional<std::int64_t> value)
 {
-    v1::Channel channel;
-    channel.externalId = "motion_sensitivity";
-    channel.name = "Motion sensitivity";
-    channel.kind = v1::ChannelKind::MotionSensitivity;
-    channel.dataType = v1::ChannelDataType::Enum;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    channel.minValue = 1.0;
-    channel.maxValue = 5.0;
-    channel.stepValue = 1.0;
-
-    QJsonObject meta;
-    meta.insert(QStringLiteral("enumName"), QStringLiteral("SensitivityLevel"));
-    channel.metaJson = QJsonDocument(meta).toJson(QJsonDocument::Compact).toStdString();
-
-    auto addChoice = [&channel](v1::SensitivityLevel level, const char *label) {
-        v1::AdapterConfigOption option;
-        option.value = std::to_string(static_cast<int>(level));
-        option.label = label;
-        channel.choices.push_back(std::move(option));
-    };
-    addChoice(v1::SensitivityLevel::Low, "Low");
-    addChoice(v1::SensitivityLevel::Medium, "Medium");
-    addChoice(v1::SensitivityLevel::High, "High");
-    addChoice(v1::SensitivityLevel::VeryHigh, "VeryHigh");
-    addChoice(v1::SensitivityLevel::Max, "Max");
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "battery";
+        channel.name = "Battery";
+        channel.kind = v1::ChannelKind::Battery;
+        channel.dataType = v1::ChannelDataType::Int;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.minValue = 0.0;
+        channel.maxValue = 100.0;
+        channel.stepValue = 1.0;
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
+}
 
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+ChannelSlot makeMotionSensitivityChannel(std::optional<std::int64_t> value)
+{
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "motion_sensitivity";
+        channel.name = "Motion sensitivity";
+        channel.kind = v1::ChannelKind::MotionSensitivity;
+        channel.dataType = v1::ChannelDataType::Enum;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.minValue = 1.0;
+        channel.maxValue = 5.0;
+        channel.stepValue = 1.0;
+
+        QJsonObject meta;
+        meta.insert(QStringLiteral("enumName"), QStringLiteral("SensitivityLevel"));
+        channel.metaJson = QJsonDocument(meta).toJson(QJsonDocument::Compact).toStdString();
+
+        auto addChoice = [&channel](v1::SensitivityLevel level, const char *label) {
+            v1::AdapterConfigOption option;
+            option.value = std::to_string(static_cast<int>(level));
+            option.label = label;
+            channel.choices.push_back(std::move(option));
+        };
+        addChoice(v1::SensitivityLevel::Low, "Low");
+        addChoice(v1::SensitivityLevel::Medium, "Medium");
+        addChoice(v1::SensitivityLevel::High, "High");
+        addChoice(v1::SensitivityLevel::VeryHigh, "VeryHigh");
+        addChoice(v1::SensitivityLevel::Max, "Max");
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeButtonChannel(const QString &channelId,
+ChannelSlot makeButtonChannel(const QString &channelId,
                               const QString &name,
                               std::optional<std::int64_t> value)
 {
-    v1::Channel channel;
-    channel.externalId = channelId.toStdString();
-    channel.name = name.toStdString();
-    channel.kind = v1::ChannelKind::ButtonEvent;
-    channel.dataType = v1::ChannelDataType::Int;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    const std::string externalId = channelId.toStdString();
+    ChannelDescriptorPtr descriptor = internDescriptor("button|" + externalId, [&externalId, &name] {
+        v1::Channel channel;
+        channel.externalId = externalId;
+        channel.name = name.toStdString();
+        channel.kind = v1::ChannelKind::ButtonEvent;
+        channel.dataType = v1::ChannelDataType::Int;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        return channel;
+    });
+    return makeSlot(std::move(descriptor), value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeDialRotationChannel(std::optional<std::int64_t> value)
+ChannelSlot makeDialRotationChannel(std::optional<std::int64_t> value)
 {
-    v1::Channel channel;
-    channel.externalId = "dial";
-    channel.name = "Dial rotation";
-    channel.kind = v1::ChannelKind::RelativeRotation;
-    channel.dataType = v1::ChannelDataType::Int;
-    channel.flags = v1::kChannelFlagDefaultRead;
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "dial";
+        channel.name = "Dial rotation";
+        channel.kind = v1::ChannelKind::RelativeRotation;
+        channel.dataType = v1::ChannelDataType::Int;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
-v1::Channel makeConnectivityChannel(std::optional<std::int64_t> value)
+ChannelSlot makeConnectivityChannel(std::optional<std::int64_t> value)
 {
-    v1::Channel channel;
-    channel.externalId = "zigbee_status";
-    channel.name = "Connectivity";
-    channel.kind = v1::ChannelKind::ConnectivityStatus;
-    channel.dataType = v1::ChannelDataType::Enum;
-    channel.flags = v1::kChannelFlagDefaultRead;
-
-    auto addChoice = [&channel](v1::ConnectivityStatus status, const char *label) {
-        v1::AdapterConfigOption option;
-        option.value = std::to_string(static_cast<int>(status));
-        option.label = label;
-        channel.choices.push_back(std::move(option));
-    };
-    addChoice(v1::ConnectivityStatus::Unknown, "Unknown");
-    addChoice(v1::ConnectivityStatus::Connected, "Connected");
-    addChoice(v1::ConnectivityStatus::Limited, "Limited");
-    addChoice(v1::ConnectivityStatus::Disconnected, "Disconnected");
-
-    if (value.has_value()) {
-        channel.hasValue = true;
-        channel.lastValue = *value;
-    }
-    return channel;
+    static const ChannelDescriptorPtr descriptor = std::make_shared<const v1::Channel>([] {
+        v1::Channel channel;
+        channel.externalId = "zigbee_status";
+        channel.name = "Connectivity";
+        channel.kind = v1::ChannelKind::ConnectivityStatus;
+        channel.dataType = v1::ChannelDataType::Enum;
+        channel.flags = v1::kChannelFlagDefaultRead;
+
+        auto addChoice = [&channel](v1::ConnectivityStatus status, const char *label) {
+            v1::AdapterConfigOption option;
+            option.value = std::to_string(static_cast<int>(status));
+            option.label = label;
+            channel.choices.push_back(std::move(option));
+        };
+        addChoice(v1::ConnectivityStatus::Unknown, "Unknown");
+        addChoice(v1::ConnectivityStatus::Connected, "Connected");
+        addChoice(v1::ConnectivityStatus::Limited, "Limited");
+        addChoice(v1::ConnectivityStatus::Disconnected, "Disconnected");
+        return channel;
+    }());
+    return makeSlot(descriptor, value.has_value() ? std::optional<v1::ScalarValue>(*value) : std::nullopt);
 }
 
 std::optional<bool> parseBoolSensor(const QJsonObject &resourceObj,
@@ -418,56 +486,6 @@ std::optional<bool> parseBoolSensor(const QJsonObject &resourceObj,
     return std::nullopt;
 }
 
-std::optional<double> parseTemperatureCelsius(const QJsonObject &resourceObj)
-{
-    const QJsonObject tempObj = resourceObj.value(QStringLiteral("temperature")).toObject();
-    double raw = std::numeric_limits<double>::quiet_NaN();
-    if (tempObj.contains(QStringLiteral("temperature"))) {
-        raw = tempObj.value(QStringLiteral("temperature")).toDouble(std::numeric_limits<double>::quiet_NaN());
-    } else {
-        const QJsonObject reportObj = tempObj.value(QStringLiteral("temperature_report")).toObject();
-        if (reportObj.contains(QStringLiteral("temperature")))
-            raw = reportObj.value(QStringLiteral("temperature")).toDouble(std::numeric_limits<double>::quiet_NaN());
-    }
-    if (!std::isfinite(raw))
-        return std::nullopt;
-
-    if (std::abs(raw) > 200.0)
-        raw /= 100.0;
-    return raw;
-}
-
-std::optional<std::int64_t> parseIlluminanceLux(const QJsonObject &resourceObj)
-{
-    const QJsonObject lightObj = resourceObj.value(QStringLiteral("light")).toObject();
-    const QJsonObject reportObj = lightObj.value(QStringLiteral("light_level_report")).toObject();
-
-    if (reportObj.contains(QStringLiteral("lux"))) {
-        const double lux = reportObj.value(QStringLiteral("lux")).toDouble(std::numeric_limits<double>::quiet_NaN());
-        if (std::isfinite(lux))
-            return static_cast<std::int64_t>(std::llround(lux));
-    }
-    if (lightObj.contains(QStringLiteral("lux"))) {
-        const double lux = lightObj.value(QStringLiteral("lux")).toDouble(std::numeric_limits<double>::quiet_NaN());
-        if (std::isfinite(lux))
-            return static_cast<std::int64_t>(std::llround(lux));
-    }
-
-    auto lightLevelToLux = [](int lightLevel) {
-        return std::pow(10.0, (static_cast<double>(lightLevel) - 1.0) / 10000.0);
-    };
-    if (reportObj.contains(QStringLiteral("light_level"))) {
-        return static_cast<std::int64_t>(
-            std::llround(lightLevelToLux(reportObj.value(QStringLiteral("light_level")).toInt(0))));
-    }
-    if (lightObj.contains(QStringLiteral("light_level"))) {
-        return static_cast<std::int64_t>(
-            std::llround(lightLevelToLux(lightObj.value(QStringLiteral("light_level")).toInt(0))));
-    }
-
-    return std::nullopt;
-}
-
 std::optional<std::int64_t> parseBatteryLevel(const QJsonObject &resourceObj)
 {
     const QJsonObject powerObj = resourceObj.value(QStringLiteral("power_state")).toObject();
@@ -561,13 +579,8 @@ std::optional<bool> scalarAsBool(const v1::ScalarValue &value)
         return *i != 0;
     if (const auto *d = std::get_if<double>(&value))
         return *d != 0.0;
-    if (const auto *s = std::get_if<std::string>(&value)) {
-        const QString text = QString::fromStdString(*s).trimmed().toLower();
-        if (text == QLatin1String("1") || text == QLatin1String("true") || text == QLatin1String("on"))
-            return true;
-        if (text == QLatin1String("0") || text == QLatin1String("false") || text == QLatin1String("off"))
-            return false;
-    }
+    if (const auto *s = std::get_if<std::string>(&value))
+        return parseBoolText(*s);
     return std::nullopt;
 }
 
@@ -604,8 +617,420 @@ bool extractRgb(const phicore::adapter::sdk::ChannelInvokeRequest &request,
     return false;
 }
 
+QSet<QString> readNameSet(const QJsonObject &meta, const QString &key)
+{
+    QSet<QString> out;
+    const QJsonValue value = meta.value(key);
+    QStringList names;
+    if (value.isArray()) {
+        for (const QJsonValue &entry : value.toArray())
+            names.push_back(entry.toString());
+    } else if (value.isString()) {
+        names = value.toString().split(QRegularExpression(QStringLiteral("[,;\\s]+")), Qt::SkipEmptyParts);
+    }
+    for (const QString &name : std::as_const(names)) {
+        const QString normalized = name.trimmed().toLower();
+        if (!normalized.isEmpty())
+            out.insert(normalized);
+    }
+    return out;
+}
+
+DeviceEntry buildDeviceEntryFields(const QJsonObject &deviceObj)
+{
+    DeviceEntry deviceEntry;
+    deviceEntry.device.externalId = deviceObj.value(QStringLiteral("id")).toString().trimmed().toStdString();
+    deviceEntry.device.name = deviceNameFromObjects(deviceObj).toStdString();
+
+    const QJsonObject product = deviceObj.value(QStringLiteral("product_data")).toObject();
+    deviceEntry.device.manufacturer = product.value(QStringLiteral("manufacturer_name")).toString().toStdString();
+    deviceEntry.device.model = product.value(QStringLiteral("model_id")).toString().toStdString();
+    deviceEntry.device.firmware = product.value(QStringLiteral("software_version")).toString().toStdString();
+    deviceEntry.device.deviceClass = v1::DeviceClass::Unknown;
+    deviceEntry.device.metaJson = QJsonDocument(deviceObj).toJson(QJsonDocument::Compact).toStdString();
+    applyHueEffects(&deviceEntry.device, deviceObj);
+    return deviceEntry;
+}
+
 } // namespace
 
+std::optional<double> parseTemperatureCelsius(const QJsonObject &resourceObj)
+{
+    const QJsonObject tempObj = resourceObj.value(QStringLiteral("temperature")).toObject();
+    double raw = std::numeric_limits<double>::quiet_NaN();
+    if (tempObj.contains(QStringLiteral("temperature"))) {
+        raw = tempObj.value(QStringLiteral("temperature")).toDouble(std::numeric_limits<double>::quiet_NaN());
+    } else {
+        const QJsonObject reportObj = tempObj.value(QStringLiteral("temperature_report")).toObject();
+        if (reportObj.contains(QStringLiteral("temperature")))
+            raw = reportObj.value(QStringLiteral("temperature")).toDouble(std::numeric_limits<double>::quiet_NaN());
+    }
+    if (!std::isfinite(raw))
+        return std::nullopt;
+
+    if (std::abs(raw) > 200.0)
+        raw /= 100.0;
+    return raw;
+}
+
+std::optional<std::int64_t> parseIlluminanceLux(const QJsonObject &resourceObj)
+{
+    const QJsonObject lightObj = resourceObj.value(QStringLiteral("light")).toObject();
+    const QJsonObject reportObj = lightObj.value(QStringLiteral("light_level_report")).toObject();
+
+    if (reportObj.contains(QStringLiteral("lux"))) {
+        const double lux = reportObj.value(QStringLiteral("lux")).toDouble(std::numeric_limits<double>::quiet_NaN());
+        if (std::isfinite(lux))
+            return static_cast<std::int64_t>(std::llround(lux));
+    }
+    if (lightObj.contains(QStringLiteral("lux"))) {
+        const double lux = lightObj.value(QStringLiteral("lux")).toDouble(std::numeric_limits<double>::quiet_NaN());
+        if (std::isfinite(lux))
+            return static_cast<std::int64_t>(std::llround(lux));
+    }
+
+    auto lightLevelToLux = [](int lightLevel) {
+        return std::pow(10.0, (static_cast<double>(lightLevel) - 1.0) / 10000.0);
+    };
+    if (reportObj.contains(QStringLiteral("light_level"))) {
+        return static_cast<std::int64_t>(
+            std::llround(lightLevelToLux(reportObj.value(QStringLiteral("light_level")).toInt(0))));
+    }
+    if (lightObj.contains(QStringLiteral("light_level"))) {
+        return static_cast<std::int64_t>(
+            std::llround(lightLevelToLux(lightObj.value(QStringLiteral("light_level")).toInt(0))));
+    }
+
+    return std::nullopt;
+}
+
+void internProductRecord(DeviceEntry *entry)
+{
+    if (!entry)
+        return;
+
+    v1::Device &device = entry->device;
+    if (entry->product && device.manufacturer.empty() && device.model.empty()
+        && device.firmware.empty() && device.effects.empty()) {
+        return;
+    }
+
+    std::string key = device.manufacturer + '\x1f' + device.model + '\x1f' + device.firmware;
+    for (const v1::DeviceEffectDescriptor &effect : device.effects) {
+        key += '\x1f';
+        key += effect.id;
+        key += '\x1e';
+        key += effect.metaJson;
+    }
+
+    ProductPool &pool = productPool();
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    auto it = pool.records.find(key);
+    ProductRecordPtr record = (it != pool.records.end()) ? it->second.lock() : ProductRecordPtr{};
+    if (!record) {
+        for (auto expired = pool.records.begin(); expired != pool.records.end();) {
+            if (expired->second.expired())
+                expired = pool.records.erase(expired);
+            else
+                ++expired;
+        }
+        auto fresh = std::make_shared<ProductRecord>();
+        fresh->manufacturer = std::move(device.manufacturer);
+        fresh->model = std::move(device.model);
+        fresh->firmware = std::move(device.firmware);
+        fresh->effects = std::move(device.effects);
+        record = std::move(fresh);
+        pool.records.insert_or_assign(std::move(key), record);
+    }
+
+    entry->product = std::move(record);
+    device.manufacturer = {};
+    device.model = {};
+    device.firmware = {};
+    device.effects = {};
+}
+
+std::size_t deviceEntryBytes(const DeviceEntry &entry, std::size_t *metaJsonBytes)
+{
+    const v1::Device &device = entry.device;
+    std::size_t total = sizeof(DeviceEntry)
+        + heapBytes(device.externalId) + heapBytes(device.name) + heapBytes(device.metaJson)
+        + heapBytes(device.manufacturer) + heapBytes(device.model) + heapBytes(device.firmware)
+        + entry.channels.capacity() * sizeof(ChannelSlot)
+        + heapBytes(entry.state.lightResourceId);
+    for (const ChannelSlot &slot : entry.channels) {
+        if (const std::string *text = std::get_if<std::string>(&slot.value))
+            total += heapBytes(*text);
+    }
+    if (metaJsonBytes)
+        *metaJsonBytes += heapBytes(device.metaJson);
+    return total;
+}
+
+std::size_t heapBytes(const SceneLightTarget &target)
+{
+    return heapBytes(target.lightId);
+}
+
+ModelPoolStats modelPoolStats()
+{
+    ModelPoolStats stats;
+    {
+        DescriptorPool &pool = descriptorPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        for (const auto &[signature, descriptor] : pool.descriptors) {
+            ++stats.channelDescriptors;
+            stats.channelDescriptorBytes += sizeof(v1::Channel) + heapBytes(signature)
+                + heapBytes(descriptor->externalId) + heapBytes(descriptor->name)
+                + heapBytes(descriptor->unit) + heapBytes(descriptor->metaJson);
+        }
+    }
+    {
+        ProductPool &pool = productPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        for (const auto &[key, weak] : pool.records) {
+            const ProductRecordPtr record = weak.lock();
+            if (!record)
+                continue;
+            ++stats.productRecords;
+            stats.productRecordBytes += sizeof(ProductRecord) + heapBytes(key)
+                + heapBytes(record->manufacturer) + heapBytes(record->model) + heapBytes(record->firmware);
+            for (const v1::DeviceEffectDescriptor &effect : record->effects) {
+                stats.productRecordBytes += sizeof(v1::DeviceEffectDescriptor) + heapBytes(effect.id)
+                    + heapBytes(effect.label) + heapBytes(effect.description) + heapBytes(effect.metaJson);
+            }
+        }
+    }
+    return stats;
+}
+
+v1::Device materializeDevice(const DeviceEntry &entry)
+{
+    v1::Device device = entry.device;
+    if (entry.product) {
+        device.manufacturer = entry.product->manufacturer;
+        device.model = entry.product->model;
+        device.firmware = entry.product->firmware;
+        device.effects = entry.product->effects;
+    }
+    return device;
+}
+
+bool sameDeviceShape(const DeviceEntry &a, const DeviceEntry &b)
+{
+    const v1::Device &x = a.device;
+    const v1::Device &y = b.device;
+    if (x.externalId != y.externalId || x.name != y.name || x.deviceClass != y.deviceClass || x.flags != y.flags
+        || x.metaJson != y.metaJson || x.manufacturer != y.manufacturer || x.model != y.model
+        || x.firmware != y.firmware || x.effects.size() != y.effects.size()) {
+        return false;
+    }
+    // Effects are told apart by id and meta, as in the product pool key.
+    for (std::size_t i = 0; i < x.effects.size(); ++i) {
+        if (x.effects[i].id != y.effects[i].id || x.effects[i].metaJson != y.effects[i].metaJson)
+            return false;
+    }
+    // Products and descriptors are pooled, so equal ones share a pointer.
+    if (a.product != b.product || a.channels.size() != b.channels.size())
+        return false;
+    for (std::size_t i = 0; i < a.channels.size(); ++i) {
+        if (a.channels[i].descriptor != b.channels[i].descriptor)
+            return false;
+    }
+    return true;
+}
+
+v1::ChannelList materializeChannels(const ChannelSlots &slots)
+{
+    v1::ChannelList channels;
+    channels.reserve(slots.size());
+    for (const ChannelSlot &slot : slots) {
+        v1::Channel channel = *slot.descriptor;
+        channel.hasValue = slot.hasValue;
+        if (slot.hasValue)
+            channel.lastValue = slot.value;
+        channels.push_back(std::move(channel));
+    }
+    return channels;
+}
+
+bool SyncFilter::resourceEnabled(const QString &resourceType) const
+{
+    if (resourceTypes.isEmpty())
+        return true;
+    if (resourceType == QLatin1String("device") || resourceType == QLatin1String("zigbee_device_discovery"))
+        return true;
+    return resourceTypes.contains(resourceType);
+}
+
+bool SyncFilter::channelEnabled(const QString &channelId) const
+{
+    return channelIds.isEmpty() || channelIds.contains(channelId);
+}
+
+bool SyncFilter::resourceNeeded(const QString &resourceType) const
+{
+    if (!resourceEnabled(resourceType))
+        return false;
+    if (channelIds.isEmpty())
+        return true;
+
+    // Services that only feed channels; devices, lights, rooms, zones and
+    // scenes also carry structure and are always needed when enabled.
+    static const QHash<QString, QStringList> channelsByResource = {
+        {QStringLiteral("motion"), {QStringLiteral("motion"), QStringLiteral("motion_sensitivity")}},
+        {QStringLiteral("tamper"), {QStringLiteral("tamper")}},
+        {QStringLiteral("temperature"), {QStringLiteral("temperature")}},
+        {QStringLiteral("light_level"), {QStringLiteral("illuminance")}},
+        {QStringLiteral("device_power"), {QStringLiteral("battery")}},
+        {QStringLiteral("button"), {QStringLiteral("button")}},
+        {QStringLiteral("relative_rotary"), {QStringLiteral("dial")}},
+        {QStringLiteral("zigbee_connectivity"), {QStringLiteral("zigbee_status")}},
+    };
+    const auto it = channelsByResource.constFind(resourceType);
+    if (it == channelsByResource.cend())
+        return true;
+    return std::any_of(it->cbegin(), it->cend(), [this](const QString &channelId) {
+        return channelIds.contains(channelId);
+    });
+}
+
+SyncFilter syncFilterFromMeta(const QJsonObject &meta)
+{
+    SyncFilter filter;
+    filter.resourceTypes = readNameSet(meta, QStringLiteral("syncResources"));
+    filter.channelIds = readNameSet(meta, QStringLiteral("syncChannels"));
+    return filter;
+}
+
+DeviceEntry buildDeviceEntry(const QJsonObject &deviceObj)
+{
+    DeviceEntry deviceEntry = buildDeviceEntryFields(deviceObj);
+    internProductRecord(&deviceEntry);
+    return deviceEntry;
+}
+
+std::optional<bool> parseBoolText(std::string_view text)
+{
+    auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+    while (!text.empty() && isSpace(text.front()))
+        text.remove_prefix(1);
+    while (!text.empty() && isSpace(text.back()))
+        text.remove_suffix(1);
+
+    auto is = [text](std::string_view word) {
+        return text.size() == word.size()
+            && std::equal(text.cbegin(), text.cend(), word.cbegin(), [](char a, char b) {
+                   return (a >= 'A' && a <= 'Z' ? static_cast<char>(a - 'A' + 'a') : a) == b;
+               });
+    };
+    if (is("1") || is("true") || is("on"))
+        return true;
+    if (is("0") || is("false") || is("off"))
+        return false;
+    return std::nullopt;
+}
+
+QHash<QString, QString> serviceOwnerIndex(const QJsonArray &deviceData, const QJsonArray &lightData)
+{
+    QHash<QString, QString> owners;
+    for (const QJsonValue &entry : deviceData) {
+        if (!entry.isObject())
+            continue;
+        const QJsonObject deviceObj = entry.toObject();
+        const QString deviceId = deviceObj.value(QStringLiteral("id")).toString().trimmed();
+        if (deviceId.isEmpty())
+            continue;
+        const QJsonArray services = deviceObj.value(QStringLiteral("services")).toArray();
+        for (const QJsonValue &serviceVal : services) {
+            const QString rid = serviceVal.toObject().value(QStringLiteral("rid")).toString().trimmed();
+            if (!rid.isEmpty())
+                owners.insert(rid, deviceId);
+        }
+    }
+
+    // Light owners also cover snapshots synced without the device resource.
+    for (const QJsonValue &entry : lightData) {
+        if (!entry.isObject())
+            continue;
+        const QJsonObject lightObj = entry.toObject();
+        const QString lightId = lightObj.value(QStringLiteral("id")).toString().trimmed();
+        const QString deviceId = ownerDeviceId(lightObj);
+        if (!lightId.isEmpty() && !deviceId.isEmpty())
+            owners.insert(lightId, deviceId);
+    }
+    return owners;
+}
+
+QStringList memberDeviceIds(const QJsonObject &groupObj, const QHash<QString, QString> &serviceOwners)
+{
+    // Rooms list devices, zones list light services; both resolve to devices.
+    QStringList members;
+    QSet<QString> seen;
+    const QJsonArray children = groupObj.value(QStringLiteral("children")).toArray();
+    for (const QJsonValue &childValue : children) {
+        if (!childValue.isObject())
+            continue;
+        const QJsonObject child = childValue.toObject();
+        const QString rid = child.value(QStringLiteral("rid")).toString().trimmed();
+        if (rid.isEmpty())
+            continue;
+        const QString deviceId = child.value(QStringLiteral("rtype")).toString() == QLatin1String("device")
+            ? rid
+            : serviceOwners.value(rid);
+        if (deviceId.isEmpty() || seen.contains(deviceId))
+            continue;
+        seen.insert(deviceId);
+        members.push_back(deviceId);
+    }
+    return members;
+}
+
+QString groupedLightId(const QJsonObject &groupObj)
+{
+    const QJsonArray services = groupObj.value(QStringLiteral("services")).toArray();
+    for (const QJsonValue &serviceVal : services) {
+        const QJsonObject serviceObj = serviceVal.toObject();
+        if (serviceObj.value(QStringLiteral("rtype")).toString() == QLatin1String("grouped_light"))
+            return serviceObj.value(QStringLiteral("rid")).toString().trimmed();
+    }
+    return {};
+}
+
+LightState parseLightState(const QJsonObject &stateObj)
+{
+    LightState state;
+    const QJsonValue onValue = stateObj.value(QStringLiteral("on")).toObject().value(QStringLiteral("on"));
+    if (onValue.isBool())
+        state.on = onValue.toBool();
+    const QJsonValue briValue = stateObj.value(QStringLiteral("dimming")).toObject().value(QStringLiteral("brightness"));
+    if (briValue.isDouble())
+        state.brightness = std::clamp(briValue.toDouble(), 0.0, 100.0);
+    const QJsonValue mirekValue = stateObj.value(QStringLiteral("color_temperature")).toObject().value(QStringLiteral("mirek"));
+    if (mirekValue.isDouble() && mirekValue.toInt() > 0)
+        state.mirek = mirekValue.toInt();
+    return state;
+}
+
+std::vector<SceneLightTarget> parseSceneTargets(const QJsonObject &sceneObj)
+{
+    std::vector<SceneLightTarget> targets;
+    const QJsonArray actions = sceneObj.value(QStringLiteral("actions")).toArray();
+    targets.reserve(static_cast<std::size_t>(actions.size()));
+    for (const QJsonValue &actionValue : actions) {
+        const QJsonObject actionObj = actionValue.toObject();
+        const QJsonObject targetObj = actionObj.value(QStringLiteral("target")).toObject();
+        if (targetObj.value(QStringLiteral("rtype")).toString() != QLatin1String("light"))
+            continue;
+        SceneLightTarget target;
+        target.lightId = targetObj.value(QStringLiteral("rid")).toString().trimmed();
+        target.state = parseLightState(actionObj.value(QStringLiteral("action")).toObject());
+        if (!target.lightId.isEmpty() && !target.state.empty())
+            targets.push_back(std::move(target));
+    }
+    return targets;
+}
+
 Snapshot buildSnapshot(const QJsonArray &deviceData,
                        const QJsonArray &lightData,
                        const QJsonArray &motionData,
@@ -618,10 +1043,12 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
                        const QJsonArray &zigbeeConnectivityData,
                        const QJsonArray &roomData,
                        const QJsonArray &zoneData,
-                       const QJsonArray &sceneData)
+                       const QJsonArray &sceneData,
+                       const SyncFilter &filter)
 {
     Snapshot snapshot;
 
+    StageTimer devicesTimer(Stage::BuildDevices);
     for (const QJsonValue &entry : deviceData) {
         if (!entry.isObject())
             continue;
@@ -630,21 +1057,11 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         if (deviceId.isEmpty())
             continue;
 
-        DeviceEntry deviceEntry;
-        deviceEntry.device.externalId = deviceId.toStdString();
-        deviceEntry.device.name = deviceNameFromObjects(deviceObj).toStdString();
-
-        const QJsonObject product = deviceObj.value(QStringLiteral("product_data")).toObject();
-        deviceEntry.device.manufacturer = product.value(QStringLiteral("manufacturer_name")).toString().toStdString();
-        deviceEntry.device.model = product.value(QStringLiteral("model_id")).toString().toStdString();
-        deviceEntry.device.firmware = product.value(QStringLiteral("software_version")).toString().toStdString();
-        deviceEntry.device.deviceClass = v1::DeviceClass::Unknown;
-        deviceEntry.device.metaJson = QJsonDocument(deviceObj).toJson(QJsonDocument::Compact).toStdString();
-        applyHueEffects(&deviceEntry.device, deviceObj);
-
-        snapshot.devices.insert(deviceId, std::move(deviceEntry));
+        snapshot.devices.insert(deviceId, buildDeviceEntryFields(deviceObj));
     }
+    devicesTimer.stop();
 
+    StageTimer lightsTimer(Stage::BuildLights);
     for (const QJsonValue &entry : lightData) {
         if (!entry.isObject())
             continue;
@@ -661,7 +1078,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         device.state.lightResourceId = lightId;
 
         const QJsonObject onObj = lightObj.value(QStringLiteral("on")).toObject();
-        if (onObj.contains(QStringLiteral("on"))) {
+        if (filter.channelEnabled(QStringLiteral("on")) && onObj.contains(QStringLiteral("on"))) {
             const bool on = onObj.value(QStringLiteral("on")).toBool(false);
             device.state.hasOn = true;
             device.state.on = on;
@@ -669,7 +1086,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         }
 
         const QJsonObject dimObj = lightObj.value(QStringLiteral("dimming")).toObject();
-        if (dimObj.contains(QStringLiteral("brightness"))) {
+        if (filter.channelEnabled(QStringLiteral("bri")) && dimObj.contains(QStringLiteral("brightness"))) {
             const double bri = dimObj.value(QStringLiteral("brightness")).toDouble(0.0);
             device.state.hasBrightness = true;
             device.state.brightness = std::clamp(bri, 0.0, 100.0);
@@ -677,7 +1094,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         }
 
         const QJsonObject ctObj = lightObj.value(QStringLiteral("color_temperature")).toObject();
-        if (ctObj.contains(QStringLiteral("mirek"))) {
+        if (filter.channelEnabled(QStringLiteral("ct")) && ctObj.contains(QStringLiteral("mirek"))) {
             const int ct = ctObj.value(QStringLiteral("mirek")).toInt(0);
             if (ct > 0) {
                 const QJsonObject schema = ctObj.value(QStringLiteral("mirek_schema")).toObject();
@@ -691,7 +1108,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
 
         const QJsonObject colorObj = lightObj.value(QStringLiteral("color")).toObject();
         const QJsonObject xyObj = colorObj.value(QStringLiteral("xy")).toObject();
-        if (!xyObj.isEmpty()) {
+        if (filter.channelEnabled(QStringLiteral("color")) && !xyObj.isEmpty()) {
             device.state.hasColorXy = true;
             device.state.colorX = xyObj.value(QStringLiteral("x")).toDouble(0.0);
             device.state.colorY = xyObj.value(QStringLiteral("y")).toDouble(0.0);
@@ -700,7 +1117,9 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
 
         applyHueEffects(&device.device, lightObj);
     }
+    lightsTimer.stop();
 
+    StageTimer sensorsTimer(Stage::BuildSensors);
     for (const QJsonValue &entry : motionData) {
         if (!entry.isObject())
             continue;
@@ -710,21 +1129,35 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
             continue;
 
         DeviceEntry &device = ensureDevice(&snapshot, deviceId, v1::DeviceClass::Sensor);
-        upsertChannel(&device.channels,
-                      makeBoolReadChannel("motion",
-                                          "Motion",
-                                          v1::ChannelKind::Motion,
-                                          parseBoolSensor(motionObj,
-                                                          QStringLiteral("motion"),
-                                                          QStringLiteral("motion"),
-                                                          QStringLiteral("motion_report"))));
-
-        const std::optional<std::int64_t> sensitivity = parseMotionSensitivity(motionObj);
-        if (sensitivity.has_value())
-            upsertChannel(&device.channels, makeMotionSensitivityChannel(sensitivity));
+        if (filter.channelEnabled(QStringLiteral("motion"))) {
+            upsertChannel(&device.channels,
+                          makeMotionChannel(parseBoolSensor(motionObj,
+                                                            QStringLiteral("motion"),
+                                                            QStringLiteral("motion"),
+                                                            QStringLiteral("motion_report"))));
+        }
+
+        if (filter.channelEnabled(QStringLiteral("motion_sensitivity"))) {
+            const std::optional<std::int64_t> sensitivity = parseMotionSensitivity(motionObj);
+            if (sensitivity.has_value())
+                upsertChannel(&device.channels, makeMotionSensitivityChannel(sensitivity));
+        }
     }
 
-    for (const QJsonValue &entry : tamperData) {
+    const QJsonArray noData;
+    const QJsonArray &tamperEntries = filter.channelEnabled(QStringLiteral("tamper")) ? tamperData : noData;
+    const QJsonArray &temperatureEntries =
+        filter.channelEnabled(QStringLiteral("temperature")) ? temperatureData : noData;
+    const QJsonArray &lightLevelEntries =
+        filter.channelEnabled(QStringLiteral("illuminance")) ? lightLevelData : noData;
+    const QJsonArray &devicePowerEntries = filter.channelEnabled(QStringLiteral("battery")) ? devicePowerData : noData;
+    const QJsonArray &buttonEntries = filter.channelEnabled(QStringLiteral("button")) ? buttonData : noData;
+    const QJsonArray &relativeRotaryEntries =
+        filter.channelEnabled(QStringLiteral("dial")) ? relativeRotaryData : noData;
+    const QJsonArray &connectivityEntries =
+        filter.channelEnabled(QStringLiteral("zigbee_status")) ? zigbeeConnectivityData : noData;
+
+    for (const QJsonValue &entry : tamperEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject tamperObj = entry.toObject();
@@ -734,16 +1167,13 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
 
         DeviceEntry &device = ensureDevice(&snapshot, deviceId, v1::DeviceClass::Sensor);
         upsertChannel(&device.channels,
-                      makeBoolReadChannel("tamper",
-                                          "Tamper",
-                                          v1::ChannelKind::Tamper,
-                                          parseBoolSensor(tamperObj,
-                                                          QStringLiteral("tamper"),
-                                                          QStringLiteral("tamper"),
-                                                          QStringLiteral("tamper_report"))));
+                      makeTamperChannel(parseBoolSensor(tamperObj,
+                                                        QStringLiteral("tamper"),
+                                                        QStringLiteral("tamper"),
+                                                        QStringLiteral("tamper_report"))));
     }
 
-    for (const QJsonValue &entry : temperatureData) {
+    for (const QJsonValue &entry : temperatureEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject temperatureObj = entry.toObject();
@@ -755,7 +1185,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         upsertChannel(&device.channels, makeTemperatureChannel(parseTemperatureCelsius(temperatureObj)));
     }
 
-    for (const QJsonValue &entry : lightLevelData) {
+    for (const QJsonValue &entry : lightLevelEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject lightLevelObj = entry.toObject();
@@ -767,7 +1197,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         upsertChannel(&device.channels, makeIlluminanceChannel(parseIlluminanceLux(lightLevelObj)));
     }
 
-    for (const QJsonValue &entry : devicePowerData) {
+    for (const QJsonValue &entry : devicePowerEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject powerObj = entry.toObject();
@@ -780,13 +1210,15 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         upsertChannel(&device.channels, makeBatteryChannel(battery));
         device.device.flags |= v1::DeviceFlag::Battery;
     }
+    sensorsTimer.stop();
 
+    StageTimer buttonsTimer(Stage::BuildButtons);
     struct ButtonEntry {
         int controlId = 0;
     };
     QHash<QString, std::vector<ButtonEntry>> buttonsByDevice;
 
-    for (const QJsonValue &entry : buttonData) {
+    for (const QJsonValue &entry : buttonEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject buttonObj = entry.toObject();
@@ -829,7 +1261,9 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
 
     // Legacy parity: derive dial capability from device services even if
     // /resource/relative_rotary is unavailable or delayed.
-    for (const QJsonValue &entry : deviceData) {
+    const bool dialEnabled = filter.channelEnabled(QStringLiteral("dial"))
+        && filter.resourceEnabled(QStringLiteral("relative_rotary"));
+    for (const QJsonValue &entry : dialEnabled ? deviceData : noData) {
         if (!entry.isObject())
             continue;
         const QJsonObject deviceObj = entry.toObject();
@@ -848,7 +1282,7 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         }
     }
 
-    for (const QJsonValue &entry : relativeRotaryData) {
+    for (const QJsonValue &entry : relativeRotaryEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject rotaryObj = entry.toObject();
@@ -862,8 +1296,10 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         DeviceEntry &device = ensureDevice(&snapshot, deviceId, v1::DeviceClass::Button);
         upsertChannel(&device.channels, makeDialRotationChannel(std::nullopt));
     }
+    buttonsTimer.stop();
 
-    for (const QJsonValue &entry : zigbeeConnectivityData) {
+    StageTimer connectivityTimer(Stage::BuildSensors);
+    for (const QJsonValue &entry : connectivityEntries) {
         if (!entry.isObject())
             continue;
         const QJsonObject connectivityObj = entry.toObject();
@@ -874,9 +1310,13 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
         DeviceEntry &device = ensureDevice(&snapshot, deviceId, v1::DeviceClass::Sensor);
         upsertChannel(&device.channels, makeConnectivityChannel(parseConnectivityStatus(connectivityObj)));
     }
+    connectivityTimer.stop();
 
+    StageTimer membershipsTimer(Stage::BuildMemberships);
+    QHash<QString, QString> serviceOwners = serviceOwnerIndex(deviceData, lightData);
     QHash<QString, QStringList> memberships;
-    auto collectMemberships = [&memberships](const QJsonArray &arr) {
+    QHash<QString, QString> groupedLights;
+    auto collectMemberships = [&](const QJsonArray &arr) {
         for (const QJsonValue &entry : arr) {
             if (!entry.isObject())
                 continue;
@@ -884,20 +1324,10 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
             const QString id = obj.value(QStringLiteral("id")).toString().trimmed();
             if (id.isEmpty())
                 continue;
-
-            QStringList members;
-            const QJsonArray children = obj.value(QStringLiteral("children")).toArray();
-            for (const QJsonValue &childValue : children) {
-                if (!childValue.isObject())
-                    continue;
-                const QJsonObject child = childValue.toObject();
-                if (child.value(QStringLiteral("rtype")).toString() != QStringLiteral("device"))
-                    continue;
-                const QString rid = child.value(QStringLiteral("rid")).toString().trimmed();
-                if (!rid.isEmpty())
-                    members.push_back(rid);
-            }
-            memberships.insert(id, members);
+            memberships.insert(id, memberDeviceIds(obj, serviceOwners));
+            const QString groupedLight = groupedLightId(obj);
+            if (!groupedLight.isEmpty())
+                groupedLights.insert(id, groupedLight);
         }
     };
 
@@ -909,16 +1339,13 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
             continue;
         const QJsonObject roomObj = entry.toObject();
 
+        const QString roomId = roomObj.value(QStringLiteral("id")).toString();
         v1::Room room;
-        room.externalId = roomObj.value(QStringLiteral("id")).toString().toStdString();
+        room.externalId = roomId.toStdString();
         room.name = roomObj.value(QStringLiteral("metadata")).toObject().value(QStringLiteral("name")).toString().toStdString();
         room.zone = "room";
         room.metaJson = QJsonDocument(roomObj).toJson(QJsonDocument::Compact).toStdString();
 
-        const QStringList memberIds = memberships.value(QString::fromStdString(room.externalId));
-        for (const QString &memberId : memberIds)
-            room.deviceExternalIds.push_back(memberId.toStdString());
-
         if (!room.externalId.empty())
             snapshot.rooms.push_back(std::move(room));
     }
@@ -928,37 +1355,48 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
             continue;
         const QJsonObject zoneObj = entry.toObject();
 
+        const QString zoneId = zoneObj.value(QStringLiteral("id")).toString();
         v1::Group group;
-        group.externalId = zoneObj.value(QStringLiteral("id")).toString().toStdString();
+        group.externalId = zoneId.toStdString();
         group.name = zoneObj.value(QStringLiteral("metadata")).toObject().value(QStringLiteral("name")).toString().toStdString();
         group.zone = "zone";
         group.metaJson = QJsonDocument(zoneObj).toJson(QJsonDocument::Compact).toStdString();
 
-        const QStringList memberIds = memberships.value(QString::fromStdString(group.externalId));
-        for (const QString &memberId : memberIds)
-            group.deviceExternalIds.push_back(memberId.toStdString());
-
         if (!group.externalId.empty())
             snapshot.groups.push_back(std::move(group));
     }
+    membershipsTimer.stop();
 
+    StageTimer scenesTimer(Stage::BuildScenes);
     for (const QJsonValue &entry : sceneData) {
         if (!entry.isObject())
             continue;
         const QJsonObject sceneObj = entry.toObject();
 
+        const QString sceneId = sceneObj.value(QStringLiteral("id")).toString();
         v1::Scene scene;
-        scene.externalId = sceneObj.value(QStringLiteral("id")).toString().toStdString();
+        scene.externalId = sceneId.toStdString();
         scene.name = sceneObj.value(QStringLiteral("metadata")).toObject().value(QStringLiteral("name")).toString().toStdString();
         const QJsonObject group = sceneObj.value(QStringLiteral("group")).toObject();
         scene.scopeExternalId = group.value(QStringLiteral("rid")).toString().toStdString();
         scene.scopeType = group.value(QStringLiteral("rtype")).toString().toStdString();
         scene.metaJson = QJsonDocument(sceneObj).toJson(QJsonDocument::Compact).toStdString();
 
-        if (!scene.externalId.empty())
-            snapshot.scenes.push_back(std::move(scene));
+        if (scene.externalId.empty())
+            continue;
+        std::vector<SceneLightTarget> targets = parseSceneTargets(sceneObj);
+        if (!targets.empty())
+            snapshot.sceneTargets.insert(sceneId, std::move(targets));
+        snapshot.scenes.push_back(std::move(scene));
     }
+    scenesTimer.stop();
+
+    for (DeviceEntry &device : snapshot.devices)
+        internProductRecord(&device);
 
+    snapshot.memberships = std::move(memberships);
+    snapshot.serviceOwners = std::move(serviceOwners);
+    snapshot.groupedLights = std::move(groupedLights);
     return snapshot;
 }
 
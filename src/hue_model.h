@@ -1,8 +1,19 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include <QHash>
 #include <QJsonArray>
+#include <QJsonObject>
+#include <QSet>
 #include <QString>
+#include <QStringList>
 
 #include "phi/adapter/sdk/sidecar.h"
 
@@ -21,19 +32,113 @@ struct DeviceState {
     double colorY = 0.0;
 };
 
+// Channel descriptors are immutable and shared by every device with the same
+// kind and capability signature; devices only keep the live value.
+using ChannelDescriptorPtr = std::shared_ptr<const phicore::adapter::v1::Channel>;
+
+struct ChannelSlot {
+    ChannelDescriptorPtr descriptor;
+    bool hasValue = false;
+    phicore::adapter::v1::ScalarValue value;
+
+    const std::string &externalId() const { return descriptor->externalId; }
+};
+
+using ChannelSlots = std::vector<ChannelSlot>;
+
+phicore::adapter::v1::ChannelList materializeChannels(const ChannelSlots &slots);
+
+// Product data and effect descriptors are identical for every bulb of the
+// same model and firmware, so they are pooled and referenced by devices.
+struct ProductRecord {
+    std::string manufacturer;
+    std::string model;
+    std::string firmware;
+    std::vector<phicore::adapter::v1::DeviceEffectDescriptor> effects;
+};
+
+using ProductRecordPtr = std::shared_ptr<const ProductRecord>;
+
 struct DeviceEntry {
+    // manufacturer, model, firmware and effects live in product.
     phicore::adapter::v1::Device device;
-    phicore::adapter::v1::ChannelList channels;
+    ProductRecordPtr product;
+    ChannelSlots channels;
     DeviceState state;
 };
 
+void internProductRecord(DeviceEntry *entry);
+std::size_t deviceEntryBytes(const DeviceEntry &entry, std::size_t *metaJsonBytes = nullptr);
+
+struct ModelPoolStats {
+    std::size_t channelDescriptors = 0;
+    std::size_t channelDescriptorBytes = 0;
+    std::size_t productRecords = 0;
+    std::size_t productRecordBytes = 0;
+};
+
+ModelPoolStats modelPoolStats();
+phicore::adapter::v1::Device materializeDevice(const DeviceEntry &entry);
+// Same device fields, product and channel set; channel values are ignored.
+bool sameDeviceShape(const DeviceEntry &a, const DeviceEntry &b);
+
+struct SyncFilter {
+    QSet<QString> resourceTypes;
+    QSet<QString> channelIds;
+
+    bool resourceEnabled(const QString &resourceType) const;
+    bool channelEnabled(const QString &channelId) const;
+    // Whether polls and events need the resource at all: it is enabled and,
+    // for a sensor or control service, feeds at least one enabled channel.
+    bool resourceNeeded(const QString &resourceType) const;
+};
+
+SyncFilter syncFilterFromMeta(const QJsonObject &meta);
+
+// Partial light state, as carried by scene actions and light events.
+struct LightState {
+    std::optional<bool> on;
+    std::optional<double> brightness;
+    std::optional<int> mirek;
+
+    bool empty() const { return !on && !brightness && !mirek; }
+};
+
+struct SceneLightTarget {
+    QString lightId;
+    LightState state;
+};
+
+std::size_t heapBytes(const SceneLightTarget &target);
+
 struct Snapshot {
     QHash<QString, DeviceEntry> devices;
     phicore::adapter::v1::RoomList rooms;
     phicore::adapter::v1::GroupList groups;
     phicore::adapter::v1::SceneList scenes;
+    // Room/zone id -> member device ids. rooms and groups leave their
+    // member lists empty; the instance fills them from its MembershipIndex.
+    QHash<QString, QStringList> memberships;
+    // Service id (light, motion, ...) -> owning device id.
+    QHash<QString, QString> serviceOwners;
+    // Room/zone id -> grouped_light service id.
+    QHash<QString, QString> groupedLights;
+    // Scene id -> per-light target state from the scene's actions.
+    QHash<QString, std::vector<SceneLightTarget>> sceneTargets;
 };
 
+// "1"/"true"/"on" and "0"/"false"/"off", ASCII case-insensitive.
+std::optional<bool> parseBoolText(std::string_view text);
+std::optional<double> parseTemperatureCelsius(const QJsonObject &resourceObj);
+std::optional<std::int64_t> parseIlluminanceLux(const QJsonObject &resourceObj);
+
+DeviceEntry buildDeviceEntry(const QJsonObject &deviceObj);
+QHash<QString, QString> serviceOwnerIndex(const QJsonArray &deviceData, const QJsonArray &lightData);
+QStringList memberDeviceIds(const QJsonObject &groupObj, const QHash<QString, QString> &serviceOwners);
+QString groupedLightId(const QJsonObject &groupObj);
+LightState parseLightState(const QJsonObject &stateObj);
+std::vector<SceneLightTarget> parseSceneTargets(const QJsonObject &sceneObj);
+
 Snapshot buildSnapshot(const QJsonArray &deviceData,
                        const QJsonArray &lightData,
                        const QJsonArray &motionData,
@@ -46,7 +151,8 @@ Snapshot buildSnapshot(const QJsonArray &deviceData,
                        const QJsonArray &zigbeeConnectivityData,
                        const QJsonArray &roomData,
                        const QJsonArray &zoneData,
-                       const QJsonArray &sceneData);
+                       const QJsonArray &sceneData,
+                       const SyncFilter &filter = {});
 
 QByteArray buildLightCommandPayload(const QString &channelExternalId,
                                     const phicore::adapter::sdk::ChannelInvokeRequest &request,
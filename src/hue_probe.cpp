@@ -1,5 +1,7 @@
 #include "hue_probe.h"
 
+#include <algorithm>
+
 #include <QHostInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -82,39 +84,57 @@ bool parseApiCreateUserResponse(const QByteArray &payload,
     return false;
 }
 
+bool linkButtonPending(const QByteArray &payload)
+{
+    const QJsonDocument doc = QJsonDocument::fromJson(payload);
+    if (!doc.isArray())
+        return false;
+    for (const QJsonValue &value : doc.array()) {
+        const QJsonObject errObj = value.toObject().value(QStringLiteral("error")).toObject();
+        if (errObj.value(QStringLiteral("type")).toInt() == 101)
+            return true;
+    }
+    return false;
+}
+
 } // namespace
 
-ProbeResult runProbe(HttpClient &http, const ConnectionSettings &settings, int timeoutMs)
+Task<ProbeResult> runProbe(const HttpClient &http,
+                           ConnectionSettings settings,
+                           ProbeOptions options,
+                           ProbeSession::ProgressHandler progress,
+                           CancelToken token)
 {
     ProbeResult out;
+    if (settings.port <= 0)
+        settings.port = settings.useTls ? 443 : 80;
 
     if (HttpClient::effectiveHost(settings).isEmpty()) {
         out.error = QStringLiteral("Host must not be empty");
-        return out;
+        co_return out;
     }
 
-    ConnectionSettings probeSettings = settings;
-    if (probeSettings.port <= 0)
-        probeSettings.port = probeSettings.useTls ? 443 : 80;
-
-    if (!probeSettings.appKey.trimmed().isEmpty()) {
-        const HttpResult bridge = http.get(probeSettings,
-                                           QStringLiteral("/clip/v2/resource/bridge"),
-                                           true,
-                                           QByteArrayLiteral("application/json"),
-                                           timeoutMs);
+    if (!settings.appKey.trimmed().isEmpty()) {
+        const HttpResult bridge = co_await awaitRequest(http,
+                                                        settings,
+                                                        QByteArrayLiteral("GET"),
+                                                        QStringLiteral("/clip/v2/resource/bridge"),
+                                                        {},
+                                                        true,
+                                                        options.requestTimeoutMs,
+                                                        token);
         if (bridge.ok) {
             out.ok = true;
             out.message = QStringLiteral("Bridge reachable and credentials valid");
-            out.appKey = probeSettings.appKey;
-            return out;
+            out.appKey = settings.appKey;
+            co_return out;
         }
 
         const QString hueError = extractHueErrorDescription(bridge.payload);
         out.error = hueError.isEmpty() ? bridge.error : hueError;
         if (out.error.isEmpty())
             out.error = QStringLiteral("Hue bridge rejected the application key");
-        return out;
+        co_return out;
     }
 
     QJsonObject payload;
@@ -122,37 +142,95 @@ ProbeResult runProbe(HttpClient &http, const ConnectionSettings &settings, int t
     payload.insert(QStringLiteral("devicetype"),
                    QStringLiteral("phi-core#%1").arg(localHost.isEmpty() ? QStringLiteral("adapter") : localHost));
     payload.insert(QStringLiteral("generateclientkey"), true);
+    const QByteArray body = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+
+    // The pairing window cancels the token, aborting whatever attempt or
+    // delay is pending when it closes.
+    token.setDeadline(options.pairingWindowMs);
+    if (progress)
+        progress(QStringLiteral("waitingForLinkButton"), token.remainingMs());
+
+    HttpResult lastAttempt;
+    while (true) {
+        HttpResult createUser = co_await awaitRequest(http,
+                                                            settings,
+                                                            QByteArrayLiteral("POST"),
+                                                            QStringLiteral("/api"),
+                                                            body,
+                                                            false,
+                                                            std::min(options.requestTimeoutMs,
+                                                                     std::max(1000, token.remainingMs())),
+                                                            token);
+        if (token.deadlineExpired())
+            break;
+        if (token.cancelled()) {
+            out.error = QStringLiteral("Probe cancelled");
+            co_return out;
+        }
 
-    const HttpResult createUser = http.postJson(probeSettings,
-                                                QStringLiteral("/api"),
-                                                QJsonDocument(payload).toJson(QJsonDocument::Compact),
-                                                false,
-                                                timeoutMs);
-    if (!createUser.ok) {
-        out.error = extractHueErrorDescription(createUser.payload);
-        if (out.error.isEmpty())
-            out.error = createUser.error.isEmpty()
-                ? QStringLiteral("Failed to create Hue application key")
-                : createUser.error;
-        return out;
-    }
+        if (createUser.ok && !linkButtonPending(createUser.payload)) {
+            QString createdAppKey;
+            QString createdClientKey;
+            if (!parseApiCreateUserResponse(createUser.payload, &createdAppKey, &createdClientKey, &out.error))
+                co_return out;
 
-    QString createdAppKey;
-    QString createdClientKey;
-    QString parseError;
-    if (!parseApiCreateUserResponse(createUser.payload, &createdAppKey, &createdClientKey, &parseError)) {
-        out.error = parseError;
-        return out;
+            out.ok = true;
+            out.appKey = createdAppKey;
+            out.message = QStringLiteral("Pairing successful");
+            if (!createdClientKey.isEmpty())
+                out.metaPatch.insert(QStringLiteral("clientKey"), createdClientKey);
+            co_return out;
+        }
+
+        // Link button not pressed yet (or a transient failure): retry until
+        // the pairing window closes.
+        lastAttempt = std::move(createUser);
+        if (progress)
+            progress(QStringLiteral("waitingForLinkButton"), token.remainingMs());
+        co_await awaitDelay(options.pairingIntervalMs, token);
     }
 
-    out.ok = true;
-    out.appKey = createdAppKey;
-    out.message = QStringLiteral("Pairing successful");
+    // The attempt aborted by the deadline says nothing; report the one before.
+    out.error = extractHueErrorDescription(lastAttempt.payload);
+    if (out.error.isEmpty())
+        out.error = lastAttempt.error.isEmpty()
+            ? QStringLiteral("Failed to create Hue application key")
+            : lastAttempt.error;
+    co_return out;
+}
 
-    if (!createdClientKey.isEmpty())
-        out.metaPatch.insert(QStringLiteral("clientKey"), createdClientKey);
+ProbeSession::ProbeSession(HttpClient &http, const ConnectionSettings &settings, const ProbeOptions &options)
+    : m_http(http)
+    , m_settings(settings)
+    , m_options(options)
+{
+}
 
-    return out;
+ProbeSession::~ProbeSession()
+{
+    // Drops the completion callback before the cancelled task unwinds.
+    m_context.reset();
+    m_token.cancel();
+}
+
+void ProbeSession::start(DoneHandler done, ProgressHandler progress)
+{
+    m_done = std::move(done);
+    m_context = std::make_unique<QObject>();
+
+    runProbe(m_http, m_settings, m_options, progress, m_token)
+        .start(m_context.get(), [this, progress](ProbeResult result) {
+            m_finished = true;
+            if (progress)
+                progress(result.ok ? QStringLiteral("done") : QStringLiteral("failed"), 0);
+            if (m_done)
+                m_done(result);
+        });
+}
+
+void ProbeSession::cancel()
+{
+    m_token.cancel();
 }
 
 } // namespace phicore::hue::ipc
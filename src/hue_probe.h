@@ -1,9 +1,14 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+
 #include <QJsonObject>
+#include <QObject>
 #include <QString>
 
 #include "hue_http.h"
+#include "hue_task.h"
 
 namespace phicore::hue::ipc {
 
@@ -15,8 +20,42 @@ struct ProbeResult {
     QJsonObject metaPatch;
 };
 
-ProbeResult runProbe(HttpClient &http,
-                     const ConnectionSettings &settings,
-                     int timeoutMs = 10000);
+struct ProbeOptions {
+    int requestTimeoutMs = 5000;
+    int pairingWindowMs = 30000;
+    int pairingIntervalMs = 1000;
+};
+
+// Non-blocking probe. With an application key it checks the bridge once;
+// without one it polls POST /api until the link button is pressed or the
+// pairing window has elapsed.
+class ProbeSession
+{
+public:
+    using DoneHandler = std::function<void(const ProbeResult &)>;
+    using ProgressHandler = std::function<void(const QString &state, int remainingMs)>;
+
+    ProbeSession(HttpClient &http, const ConnectionSettings &settings, const ProbeOptions &options = {});
+    ~ProbeSession();
+
+    void start(DoneHandler done, ProgressHandler progress = {});
+    void cancel();
+    bool finished() const { return m_finished; }
+
+private:
+    HttpClient &m_http;
+    ConnectionSettings m_settings;
+    ProbeOptions m_options;
+    DoneHandler m_done;
+    CancelToken m_token;
+    std::unique_ptr<QObject> m_context;
+    bool m_finished = false;
+};
+
+Task<ProbeResult> runProbe(const HttpClient &http,
+                           ConnectionSettings settings,
+                           ProbeOptions options,
+                           ProbeSession::ProgressHandler progress,
+                           CancelToken token);
 
 } // namespace phicore::hue::ipc
@@ -0,0 +1,105 @@
+#include "hue_scene_prediction.h"
+
+#include <cmath>
+
+#include "hue_footprint.h"
+
+namespace phicore::hue::ipc {
+
+namespace {
+
+// The bridge reports brightness with its own rounding.
+constexpr double kBrightnessTolerance = 0.5;
+
+bool matches(const LightState &expected, const LightState &observed)
+{
+    if (observed.on && expected.on && *observed.on != *expected.on)
+        return false;
+    if (observed.brightness && expected.brightness
+        && std::abs(*observed.brightness - *expected.brightness) > kBrightnessTolerance)
+        return false;
+    if (observed.mirek && expected.mirek && *observed.mirek != *expected.mirek)
+        return false;
+    return true;
+}
+
+} // namespace
+
+void ScenePredictor::setScenes(const QHash<QString, std::vector<SceneLightTarget>> &targetsByScene)
+{
+    m_targetsByScene = targetsByScene;
+}
+
+const std::vector<SceneLightTarget> &ScenePredictor::targets(const QString &sceneExternalId) const
+{
+    static const std::vector<SceneLightTarget> none;
+    const auto it = m_targetsByScene.constFind(sceneExternalId);
+    return it != m_targetsByScene.cend() ? it.value() : none;
+}
+
+void ScenePredictor::expect(const QString &lightId,
+                            const QString &deviceExternalId,
+                            const LightState &state,
+                            bool changed,
+                            std::int64_t dueMs)
+{
+    Prediction &prediction = m_pending[lightId];
+    prediction.deviceExternalId = deviceExternalId;
+    prediction.expected = state;
+    // A recall on top of a still pending one keeps its unconfirmed change.
+    prediction.changed = prediction.changed || changed;
+    prediction.dueMs = dueMs;
+    ++m_stats.predicted;
+}
+
+bool ScenePredictor::resolve(const QString &lightId, const LightState &observed)
+{
+    const auto it = m_pending.constFind(lightId);
+    if (it == m_pending.cend())
+        return false;
+    if (matches(it->expected, observed))
+        ++m_stats.confirmed;
+    else
+        ++m_stats.corrected;
+    m_pending.erase(it);
+    return true;
+}
+
+bool ScenePredictor::expire(std::int64_t now)
+{
+    bool unconfirmedChange = false;
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (it->dueMs > now) {
+            ++it;
+            continue;
+        }
+        // Lights already at the target state send no event at all.
+        unconfirmedChange = unconfirmedChange || it->changed;
+        ++m_stats.expired;
+        it = m_pending.erase(it);
+    }
+    return unconfirmedChange;
+}
+
+void ScenePredictor::removeDevice(const QString &deviceExternalId)
+{
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (it->deviceExternalId == deviceExternalId)
+            it = m_pending.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ScenePredictor::clear()
+{
+    m_targetsByScene.clear();
+    m_pending.clear();
+}
+
+std::size_t ScenePredictor::bytes() const
+{
+    return hashBytes(m_targetsByScene) + hashBytes(m_pending);
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+#include "hue_footprint.h"
+#include "hue_model.h"
+
+namespace phicore::hue::ipc {
+
+// Light states published ahead of the bridge after a scene recall. Each
+// prediction waits for the light's next event: fields the event carries
+// confirm or correct it, fields it leaves out were already at the target.
+class ScenePredictor
+{
+public:
+    struct Stats {
+        std::uint64_t recalls = 0;
+        std::uint64_t predicted = 0;
+        std::uint64_t confirmed = 0;
+        std::uint64_t corrected = 0;
+        std::uint64_t expired = 0;
+    };
+
+    void setScenes(const QHash<QString, std::vector<SceneLightTarget>> &targetsByScene);
+    const std::vector<SceneLightTarget> &targets(const QString &sceneExternalId) const;
+
+    void expect(const QString &lightId,
+                const QString &deviceExternalId,
+                const LightState &state,
+                bool changed,
+                std::int64_t dueMs);
+    // Settles the pending prediction for lightId against an observed light
+    // event. Returns false if none was pending.
+    bool resolve(const QString &lightId, const LightState &observed);
+    // Drops overdue predictions. Returns true if one of them had changed a
+    // light that never reported back.
+    bool expire(std::int64_t now);
+    void removeDevice(const QString &deviceExternalId);
+    void noteRecall() { ++m_stats.recalls; }
+    void clear();
+
+    const Stats &stats() const { return m_stats; }
+    std::size_t size() const { return static_cast<std::size_t>(m_pending.size()); }
+    std::size_t sceneCount() const { return static_cast<std::size_t>(m_targetsByScene.size()); }
+    std::size_t bytes() const;
+
+private:
+    struct Prediction {
+        QString deviceExternalId;
+        LightState expected;
+        bool changed = false;
+        std::int64_t dueMs = 0;
+
+        friend std::size_t heapBytes(const Prediction &prediction)
+        {
+            return heapBytes(prediction.deviceExternalId);
+        }
+    };
+
+    QHash<QString, std::vector<SceneLightTarget>> m_targetsByScene;
+    QHash<QString, Prediction> m_pending;
+    Stats m_stats;
+};
+
+} // namespace phicore::hue::ipc
@@ -85,6 +85,118 @@ QJsonArray schemaFields()
                         QStringLiteral("Reconnect interval while bridge is unavailable."),
                         QJsonValue(10000)));
 
+    fields.append(field(QStringLiteral("syncResources"),
+                        QStringLiteral("String"),
+                        QStringLiteral("Synced resource types"),
+                        QStringLiteral("Comma-separated Hue resource types to sync, e.g. light,scene. Empty syncs all.")));
+
+    fields.append(field(QStringLiteral("syncChannels"),
+                        QStringLiteral("String"),
+                        QStringLiteral("Synced channels"),
+                        QStringLiteral("Comma-separated channel ids to sync, e.g. on,bri,motion. Empty syncs all.")));
+
+    fields.append(field(QStringLiteral("temperatureDeadband"),
+                        QStringLiteral("Float"),
+                        QStringLiteral("Temperature deadband"),
+                        QStringLiteral("Minimum temperature change in °C before an update is published."),
+                        QJsonValue(0.2)));
+
+    fields.append(field(QStringLiteral("temperatureMinIntervalMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Temperature interval"),
+                        QStringLiteral("Minimum time between two temperature updates of one sensor."),
+                        QJsonValue(30000)));
+
+    fields.append(field(QStringLiteral("illuminanceDeadbandPercent"),
+                        QStringLiteral("Float"),
+                        QStringLiteral("Illuminance deadband"),
+                        QStringLiteral("Minimum relative illuminance change in percent before an update is published."),
+                        QJsonValue(5)));
+
+    fields.append(field(QStringLiteral("illuminanceMinIntervalMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Illuminance interval"),
+                        QStringLiteral("Minimum time between two illuminance updates of one sensor."),
+                        QJsonValue(10000)));
+
+    fields.append(field(QStringLiteral("historyBytesPerDevice"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("History per device"),
+                        QStringLiteral("Bytes of compressed sensor history kept per device. 0 disables the history."),
+                        QJsonValue(4096)));
+
+    fields.append(field(QStringLiteral("roomAggregates"),
+                        QStringLiteral("Boolean"),
+                        QStringLiteral("Room aggregates"),
+                        QStringLiteral("Publish aggregate devices with any-on, average brightness and motion per room and zone."),
+                        QJsonValue(true)));
+
+    fields.append(field(QStringLiteral("connectTimeoutMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Connect timeout"),
+                        QStringLiteral("Abort a request whose connection attempt did not get it sent to the bridge within this time."),
+                        QJsonValue(3000)));
+
+    fields.append(field(QStringLiteral("requestTimeoutMinMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Minimum request timeout"),
+                        QStringLiteral("Lower bound of the latency-derived request timeout."),
+                        QJsonValue(1000)));
+
+    fields.append(field(QStringLiteral("requestTimeoutMaxMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Maximum request timeout"),
+                        QStringLiteral("Upper bound of the latency-derived request timeout, used until enough responses were seen."),
+                        QJsonValue(10000)));
+
+    fields.append(field(QStringLiteral("http2"),
+                        QStringLiteral("Boolean"),
+                        QStringLiteral("HTTP/2"),
+                        QStringLiteral("Negotiate HTTP/2 with the bridge and multiplex all traffic over one connection."),
+                        QJsonValue(true)));
+
+    fields.append(field(QStringLiteral("stageTiming"),
+                        QStringLiteral("Boolean"),
+                        QStringLiteral("Stage timing"),
+                        QStringLiteral("Time poll and event handling stages and report them in the memory footprint. Timing is shared by all instances in the process and is on while any of them enables it."),
+                        QJsonValue(false)));
+
+    fields.append(field(QStringLiteral("loadShedding"),
+                        QStringLiteral("Boolean"),
+                        QStringLiteral("Load shedding"),
+                        QStringLiteral("Stretch polls, merge commands and defer renames and discovery while the bridge responds slowly."),
+                        QJsonValue(true)));
+
+    fields.append(field(QStringLiteral("loadShedEnterRatio"),
+                        QStringLiteral("Float"),
+                        QStringLiteral("Load shedding threshold"),
+                        QStringLiteral("Start shedding when the bridge takes this many times its usual time to start responding."),
+                        QJsonValue(3.0)));
+
+    fields.append(field(QStringLiteral("loadShedExitRatio"),
+                        QStringLiteral("Float"),
+                        QStringLiteral("Load shedding recovery threshold"),
+                        QStringLiteral("Stop shedding once the bridge starts responding within this many times its usual time again."),
+                        QJsonValue(1.5)));
+
+    fields.append(field(QStringLiteral("loadShedRecoveryMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Load shedding recovery time"),
+                        QStringLiteral("How long responses must stay below the recovery threshold before shedding stops."),
+                        QJsonValue(15000)));
+
+    fields.append(field(QStringLiteral("loadShedPollStretch"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Poll stretch factor"),
+                        QStringLiteral("Poll interval multiplier while shedding."),
+                        QJsonValue(4)));
+
+    fields.append(field(QStringLiteral("loadShedCoalesceMs"),
+                        QStringLiteral("Integer"),
+                        QStringLiteral("Command coalescing window"),
+                        QStringLiteral("Window in which light commands to the same resource are merged while shedding."),
+                        QJsonValue(300)));
+
     return fields;
 }
 
@@ -173,6 +285,20 @@ phicore::adapter::v1::AdapterCapabilities capabilities()
     discovery.metaJson = R"({"placement":"card","kind":"command","requiresAck":true})";
     caps.instanceActions.push_back(discovery);
 
+    v1::AdapterActionDescriptor history;
+    history.id = "queryHistory";
+    history.label = "Query sensor history";
+    history.description = "Return recent motion, temperature or illuminance samples kept by the adapter.";
+    history.metaJson = R"({"placement":"hidden","kind":"query","requiresAck":true})";
+    caps.instanceActions.push_back(history);
+
+    v1::AdapterActionDescriptor footprint;
+    footprint.id = "memoryFootprint";
+    footprint.label = "Memory footprint";
+    footprint.description = "Report the approximate memory used by this bridge instance.";
+    footprint.metaJson = R"({"placement":"hidden","kind":"query","requiresAck":true})";
+    caps.instanceActions.push_back(footprint);
+
     caps.defaultsJson = R"({"host":"philips-hue.local","port":443,"useTls":true,"pollIntervalMs":5000,"retryIntervalMs":10000})";
     return caps;
 }
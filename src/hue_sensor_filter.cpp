@@ -0,0 +1,153 @@
+#include "hue_sensor_filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "hue_footprint.h"
+
+namespace phicore::hue::ipc {
+
+namespace v1 = phicore::adapter::v1;
+
+std::optional<SensorKind> sensorKindForChannel(const std::string &channelExternalId)
+{
+    if (channelExternalId == "temperature")
+        return SensorKind::Temperature;
+    if (channelExternalId == "illuminance")
+        return SensorKind::Illuminance;
+    return std::nullopt;
+}
+
+const char *channelIdForSensorKind(SensorKind kind)
+{
+    return kind == SensorKind::Temperature ? "temperature" : "illuminance";
+}
+
+v1::ScalarValue sensorScalarValue(SensorKind kind, double value)
+{
+    if (kind == SensorKind::Illuminance)
+        return static_cast<std::int64_t>(std::llround(value));
+    return value;
+}
+
+void SensorDeadbandFilter::setSettings(const SensorFilterSettings &settings)
+{
+    m_settings = settings;
+}
+
+bool SensorDeadbandFilter::offer(const QString &deviceExternalId,
+                                 SensorKind kind,
+                                 double value,
+                                 std::int64_t nowMs)
+{
+    Slot &slot = m_entries[deviceExternalId].slots[static_cast<int>(kind)];
+    if (!slot.hasPublished) {
+        slot.hasPublished = true;
+        slot.published = value;
+        slot.publishedMs = nowMs;
+        return true;
+    }
+
+    if (!crossesDeadband(kind, slot, value)) {
+        if (slot.hasPending) {
+            slot.hasPending = false;
+            --m_pendingCount;
+        }
+        return false;
+    }
+
+    if (nowMs - slot.publishedMs < minIntervalMs(kind)) {
+        if (!slot.hasPending) {
+            slot.hasPending = true;
+            ++m_pendingCount;
+        }
+        slot.pending = value;
+        return false;
+    }
+
+    if (slot.hasPending) {
+        slot.hasPending = false;
+        --m_pendingCount;
+    }
+    slot.published = value;
+    slot.publishedMs = nowMs;
+    return true;
+}
+
+std::optional<double> SensorDeadbandFilter::publishedValue(const QString &deviceExternalId, SensorKind kind) const
+{
+    const auto it = m_entries.constFind(deviceExternalId);
+    if (it == m_entries.cend())
+        return std::nullopt;
+    const Slot &slot = it->slots[static_cast<int>(kind)];
+    if (!slot.hasPublished)
+        return std::nullopt;
+    return slot.published;
+}
+
+std::vector<SensorSample> SensorDeadbandFilter::takeDue(std::int64_t nowMs)
+{
+    std::vector<SensorSample> due;
+    if (m_pendingCount <= 0)
+        return due;
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        for (int i = 0; i < 2; ++i) {
+            Slot &slot = it->slots[i];
+            const SensorKind kind = static_cast<SensorKind>(i);
+            if (!slot.hasPending || nowMs - slot.publishedMs < minIntervalMs(kind))
+                continue;
+
+            slot.hasPending = false;
+            --m_pendingCount;
+            slot.published = slot.pending;
+            slot.publishedMs = nowMs;
+            due.push_back(SensorSample{it.key(), kind, slot.pending});
+        }
+    }
+    return due;
+}
+
+void SensorDeadbandFilter::removeDevice(const QString &deviceExternalId)
+{
+    const auto it = m_entries.constFind(deviceExternalId);
+    if (it == m_entries.cend())
+        return;
+    for (const Slot &slot : it->slots) {
+        if (slot.hasPending)
+            --m_pendingCount;
+    }
+    m_entries.erase(it);
+}
+
+void SensorDeadbandFilter::clear()
+{
+    m_entries.clear();
+    m_pendingCount = 0;
+}
+
+std::size_t SensorDeadbandFilter::bytes() const
+{
+    return hashBytes(m_entries);
+}
+
+bool SensorDeadbandFilter::crossesDeadband(SensorKind kind, const Slot &slot, double value) const
+{
+    const double delta = std::abs(value - slot.published);
+    if (delta <= 0.0)
+        return false;
+    if (kind == SensorKind::Temperature)
+        return delta >= m_settings.temperatureDeadband;
+
+    const double threshold = std::max(1.0, std::abs(slot.published) * m_settings.illuminanceDeadbandPercent / 100.0);
+    return delta >= threshold;
+}
+
+int SensorDeadbandFilter::minIntervalMs(SensorKind kind) const
+{
+    return kind == SensorKind::Temperature
+        ? m_settings.temperatureMinIntervalMs
+        : m_settings.illuminanceMinIntervalMs;
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+#include "phi/adapter/sdk/sidecar.h"
+
+namespace phicore::hue::ipc {
+
+enum class SensorKind : std::uint8_t {
+    Temperature = 0,
+    Illuminance = 1,
+};
+
+struct SensorFilterSettings {
+    double temperatureDeadband = 0.2;
+    double illuminanceDeadbandPercent = 5.0;
+    int temperatureMinIntervalMs = 30000;
+    int illuminanceMinIntervalMs = 10000;
+};
+
+struct SensorSample {
+    QString deviceExternalId;
+    SensorKind kind = SensorKind::Temperature;
+    double value = 0.0;
+};
+
+std::optional<SensorKind> sensorKindForChannel(const std::string &channelExternalId);
+const char *channelIdForSensorKind(SensorKind kind);
+phicore::adapter::v1::ScalarValue sensorScalarValue(SensorKind kind, double value);
+
+class SensorDeadbandFilter
+{
+public:
+    void setSettings(const SensorFilterSettings &settings);
+    const SensorFilterSettings &settings() const { return m_settings; }
+
+    bool offer(const QString &deviceExternalId, SensorKind kind, double value, std::int64_t nowMs);
+    std::optional<double> publishedValue(const QString &deviceExternalId, SensorKind kind) const;
+    std::vector<SensorSample> takeDue(std::int64_t nowMs);
+
+    void removeDevice(const QString &deviceExternalId);
+    void clear();
+    std::size_t size() const { return static_cast<std::size_t>(m_entries.size()); }
+    std::size_t bytes() const;
+
+private:
+    struct Slot {
+        bool hasPublished = false;
+        double published = 0.0;
+        std::int64_t publishedMs = 0;
+        bool hasPending = false;
+        double pending = 0.0;
+    };
+
+    struct Entry {
+        Slot slots[2];
+    };
+
+    bool crossesDeadband(SensorKind kind, const Slot &slot, double value) const;
+    int minIntervalMs(SensorKind kind) const;
+
+    SensorFilterSettings m_settings;
+    QHash<QString, Entry> m_entries;
+    int m_pendingCount = 0;
+};
+
+} // namespace phicore::hue::ipc
@@ -1,23 +1,23 @@
 #include "hue_sidecar.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <iostream>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <QDateTime>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QNetworkReply>
-#include <QNetworkRequest>
-#include <QUrl>
-#if QT_CONFIG(ssl)
-#include <QSslConfiguration>
-#include <QSslSocket>
-#endif
 
+#include "hue_clock.h"
+#include "hue_footprint.h"
 #include "hue_schema.h"
+#include "hue_stage_timer.h"
 
 namespace phicore::hue::ipc {
 
@@ -29,12 +29,41 @@ namespace phi = phicore::adapter::sdk;
 constexpr int kButtonMultiPressWindowMs = 1300;
 constexpr int kButtonLongPressRepeatWindowMs = 800;
 constexpr int kDialResetDelayMs = 1500;
-constexpr int kEventStreamFastRetryMs = 2000;
-constexpr int kEventStreamFastRetryAttempts = 5;
+constexpr int kDiscoverySessionTimeoutMs = 240000;
+constexpr int kDiscoveryPollQuietMs = 2000;
+constexpr int kDiscoveryPollMaxDelayMs = 10000;
+constexpr int kHistoryQueryDefaultLimit = 1000;
+constexpr int kStructureSampleIntervalMs = 60000;
+constexpr int kMaxEventStateDevices = 2048;
+constexpr int kMaxEventStateChannelsPerDevice = 32;
+constexpr int kMaxButtonResourceBindings = 4096;
+constexpr int kScenePredictionWindowMs = 3000;
+
+// Fingerprint of what a room, zone or scene message carries, so a poll only
+// re-sends the ones that changed.
+std::size_t topologyFingerprint(const std::string &name, const std::string &metaJson, const QStringList &members)
+{
+    return qHashMulti(0, std::hash<std::string>{}(name), std::hash<std::string>{}(metaJson), members);
+}
+
+std::vector<std::string> toStdStrings(const QStringList &values)
+{
+    std::vector<std::string> out;
+    out.reserve(static_cast<std::size_t>(values.size()));
+    for (const QString &value : values)
+        out.push_back(value.toStdString());
+    return out;
+}
 
-QString channelBindingKey(const QString &deviceExternalId, const QString &channelExternalId)
+// Makes room for key in a capped per-device table; a full table is reset
+// rather than grown, since its entries only describe in-flight gestures.
+template <typename V>
+void reserveEventSlot(QHash<QString, V> *table, const QString &key, std::uint64_t *evictions)
 {
-    return deviceExternalId + QLatin1Char('|') + channelExternalId;
+    if (table->size() < kMaxEventStateChannelsPerDevice || table->contains(key))
+        return;
+    *evictions += static_cast<std::uint64_t>(table->size());
+    table->clear();
 }
 
 qint64 parseHueTimestampMs(const QString &isoText)
@@ -71,13 +100,8 @@ std::optional<bool> scalarAsBool(const v1::ScalarValue &value)
         return *i != 0;
     if (const auto *d = std::get_if<double>(&value))
         return *d != 0.0;
-    if (const auto *s = std::get_if<std::string>(&value)) {
-        const QString text = QString::fromStdString(*s).trimmed().toLower();
-        if (text == QLatin1String("1") || text == QLatin1String("true") || text == QLatin1String("on"))
-            return true;
-        if (text == QLatin1String("0") || text == QLatin1String("false") || text == QLatin1String("off"))
-            return false;
-    }
+    if (const auto *s = std::get_if<std::string>(&value))
+        return parseBoolText(*s);
     return std::nullopt;
 }
 
@@ -107,6 +131,15 @@ int readInt(const QJsonObject &obj, const QString &key, int fallback)
     return ok ? value : fallback;
 }
 
+double readDouble(const QJsonObject &obj, const QString &key, double fallback)
+{
+    if (!obj.contains(key))
+        return fallback;
+    bool ok = false;
+    const double value = obj.value(key).toVariant().toDouble(&ok);
+    return ok ? value : fallback;
+}
+
 v1::ButtonEventCode mapHueButtonEvent(const QString &eventRaw)
 {
     const QString event = eventRaw.trimmed().toLower();
@@ -163,6 +196,85 @@ QString hueEffectNameForDeviceEffect(v1::DeviceEffect effect)
     return {};
 }
 
+QString aggregateDeviceExternalId(const QString &groupExternalId)
+{
+    return QStringLiteral("aggregate:") + groupExternalId;
+}
+
+QString aggregateGroupId(const QString &deviceExternalId)
+{
+    static const QString prefix = QStringLiteral("aggregate:");
+    return deviceExternalId.startsWith(prefix) ? deviceExternalId.mid(prefix.size()) : QString();
+}
+
+v1::ChannelList aggregateChannels(const AggregateValues &values, bool writable)
+{
+    static const v1::Channel anyOnPrototype = [] {
+        v1::Channel channel;
+        channel.externalId = "any_on";
+        channel.name = "Any light on";
+        channel.kind = v1::ChannelKind::PowerOnOff;
+        channel.dataType = v1::ChannelDataType::Bool;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.hasValue = true;
+        return channel;
+    }();
+    static const v1::Channel brightnessPrototype = [] {
+        v1::Channel channel;
+        channel.externalId = "avg_bri";
+        channel.name = "Average brightness";
+        channel.kind = v1::ChannelKind::Brightness;
+        channel.dataType = v1::ChannelDataType::Float;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.minValue = 0.0;
+        channel.maxValue = 100.0;
+        channel.stepValue = 0.1;
+        channel.hasValue = true;
+        return channel;
+    }();
+    static const v1::Channel motionPrototype = [] {
+        v1::Channel channel;
+        channel.externalId = "motion";
+        channel.name = "Motion";
+        channel.kind = v1::ChannelKind::Motion;
+        channel.dataType = v1::ChannelDataType::Bool;
+        channel.flags = v1::kChannelFlagDefaultRead;
+        channel.hasValue = true;
+        return channel;
+    }();
+
+    v1::ChannelList channels;
+    if (values.hasLights) {
+        // Writes go to the group's grouped_light as one bridge command.
+        v1::Channel anyOn = anyOnPrototype;
+        anyOn.lastValue = values.anyOn;
+        if (writable)
+            anyOn.flags = v1::kChannelFlagDefaultWrite;
+        channels.push_back(std::move(anyOn));
+
+        v1::Channel brightness = brightnessPrototype;
+        brightness.lastValue = values.averageBrightness;
+        if (writable)
+            brightness.flags = v1::kChannelFlagDefaultWrite;
+        channels.push_back(std::move(brightness));
+    }
+    if (values.hasMotionSensors) {
+        v1::Channel motion = motionPrototype;
+        motion.lastValue = values.motion;
+        channels.push_back(std::move(motion));
+    }
+    return channels;
+}
+
+QByteArray renamePayload(const QString &name)
+{
+    QJsonObject metadata;
+    metadata.insert(QStringLiteral("name"), name);
+    QJsonObject payload;
+    payload.insert(QStringLiteral("metadata"), metadata);
+    return QJsonDocument(payload).toJson(QJsonDocument::Compact);
+}
+
 QJsonObject parseJsonObject(const std::string &json)
 {
     const QByteArray bytes = QByteArray::fromStdString(json).trimmed();
@@ -174,6 +286,11 @@ QJsonObject parseJsonObject(const std::string &json)
     return doc.object();
 }
 
+QJsonArray resourceData(const QByteArray &payload)
+{
+    return QJsonDocument::fromJson(payload).object().value(QStringLiteral("data")).toArray();
+}
+
 QString effectMetaValue(const v1::DeviceEffectDescriptor &descriptor, const QString &key)
 {
     const QJsonObject meta = parseJsonObject(descriptor.metaJson);
@@ -184,30 +301,41 @@ QString effectMetaValue(const v1::DeviceEffectDescriptor &descriptor, const QStr
 
 HueAdapterInstance::HueAdapterInstance() = default;
 
-bool HueAdapterInstance::start()
+HueAdapterInstance::~HueAdapterInstance()
 {
-    if (!m_requestNetwork)
-        m_requestNetwork = std::make_unique<QNetworkAccessManager>();
-    if (!m_eventStreamNetwork)
-        m_eventStreamNetwork = std::make_unique<QNetworkAccessManager>();
-    if (!m_http)
-        m_http = std::make_unique<HttpClient>(m_requestNetwork.get());
+    detachSession();
+    if (std::exchange(m_stageTimingHeld, false))
+        releaseStageTiming();
+}
 
+bool HueAdapterInstance::start()
+{
     m_runtimeConfigured = false;
-    m_nextPollDueMs = 0;
-    m_nextEventStreamRetryDueMs = 0;
-    m_eventStreamRetryCount = 0;
-    m_buttonMultiPress.clear();
-    m_buttonLastEventCode.clear();
-    m_buttonLastEventTs.clear();
-    m_lastDialValueByDevice.clear();
-    m_dialResetDueMs.clear();
+    m_eventState.clear();
+    m_discoveryResourceId.clear();
+    m_discovery = DiscoverySession{};
+    m_sensorFilter.clear();
+    m_history.clear();
+    m_eventLatencyUs.clear();
+    m_deltaQueue.clear();
+    m_deltaLatencyUs.clear();
+    m_structureHighWater.clear();
     m_devices.clear();
     m_lightResourceByDevice.clear();
     m_knownRooms.clear();
     m_knownGroups.clear();
     m_knownScenes.clear();
-    stopEventStream();
+    m_aggregates.clear();
+    m_membership.clear();
+    m_serviceOwners.clear();
+    m_groupedLightByGroup.clear();
+    m_scenePredictor.clear();
+    m_publishedAggregates.clear();
+    m_aggregateDescriptors.clear();
+    m_pendingCommands.clear();
+    m_deferredRenames.clear();
+    m_discoveryDeferred = false;
+    detachSession();
     setConnectionState(false);
 
     if (!m_tickTimer) {
@@ -224,7 +352,7 @@ bool HueAdapterInstance::start()
     if (hasConfig()) {
         applyRuntimeConfig(config());
         m_runtimeConfigured = true;
-        startEventStream();
+        attachSession();
     }
 
     return true;
@@ -235,17 +363,33 @@ void HueAdapterInstance::stop()
     m_runtimeConfigured = false;
     if (m_tickTimer && m_tickTimer->isActive())
         m_tickTimer->stop();
-    stopEventStream();
-    m_buttonMultiPress.clear();
-    m_buttonLastEventCode.clear();
-    m_buttonLastEventTs.clear();
-    m_lastDialValueByDevice.clear();
-    m_dialResetDueMs.clear();
+    detachSession();
+    if (std::exchange(m_stageTimingHeld, false))
+        releaseStageTiming();
+    m_eventState.clear();
+    m_discoveryResourceId.clear();
+    m_discovery = DiscoverySession{};
+    m_sensorFilter.clear();
+    m_history.clear();
+    m_eventLatencyUs.clear();
+    m_deltaQueue.clear();
+    m_deltaLatencyUs.clear();
+    m_structureHighWater.clear();
     m_devices.clear();
     m_lightResourceByDevice.clear();
     m_knownRooms.clear();
     m_knownGroups.clear();
     m_knownScenes.clear();
+    m_aggregates.clear();
+    m_membership.clear();
+    m_serviceOwners.clear();
+    m_groupedLightByGroup.clear();
+    m_scenePredictor.clear();
+    m_publishedAggregates.clear();
+    m_aggregateDescriptors.clear();
+    m_pendingCommands.clear();
+    m_deferredRenames.clear();
+    m_discoveryDeferred = false;
     setConnectionState(false);
 }
 
@@ -256,39 +400,27 @@ void HueAdapterInstance::tick()
 
     const std::int64_t now = nowMs();
     processPendingButtonAggregates(now);
-    pumpEventStream(now);
-    processPendingButtonAggregates(now);
     processPendingDialResets(now);
-
-    if (!m_eventStreamReply && now >= m_nextEventStreamRetryDueMs)
-        startEventStream();
-
-    if (m_nextPollDueMs > now)
-        return;
-
-    QString error;
-    const bool ok = pollBridge(&error);
-    if (!ok) {
-        setConnectionState(false);
-        if (!error.isEmpty()) {
-            std::cerr << "hue-ipc poll failed: " << error.toStdString() << '\n';
-            sendError(phi::LogCategory::Network, error.toStdString());
-        }
-        m_nextPollDueMs = now + std::max(1000, m_retryIntervalMs);
-        return;
-    }
-
-    const int pollInterval = m_eventStreamActive
-        ? std::max(m_pollIntervalMs, 60000)
-        : m_pollIntervalMs;
-    m_nextPollDueMs = now + std::max(1000, pollInterval);
+    flushDeferredSensorValues(now);
+    flushChannelDeltas();
+    flushPendingCommands(now);
+    releaseDeferredWork(now);
+    if (m_scenePredictor.expire(now))
+        requestPoll();
+    sampleStructureSizes(now);
+    if (m_discovery.pollPending && now >= m_discovery.pollDueMs) {
+        m_discovery.pollPending = false;
+        requestPoll();
+    }
+    if (m_discovery.active && now >= m_discovery.deadlineMs)
+        finishDiscoverySession("timeout");
 }
 
 void HueAdapterInstance::onConnected()
 {
     std::cerr << "hue-ipc connected" << '\n';
-    if (m_runtimeConfigured)
-        startEventStream();
+    if (m_runtimeConfigured && !m_session)
+        attachSession();
 }
 
 void HueAdapterInstance::onDisconnected()
@@ -296,30 +428,50 @@ void HueAdapterInstance::onDisconnected()
     m_runtimeConfigured = false;
     if (m_tickTimer && m_tickTimer->isActive())
         m_tickTimer->stop();
-    stopEventStream();
-    m_buttonMultiPress.clear();
-    m_buttonLastEventCode.clear();
-    m_buttonLastEventTs.clear();
-    m_lastDialValueByDevice.clear();
-    m_dialResetDueMs.clear();
+    detachSession();
+    m_eventState.clear();
+    m_discoveryResourceId.clear();
+    m_discovery = DiscoverySession{};
+    m_sensorFilter.clear();
     m_devices.clear();
     m_lightResourceByDevice.clear();
     m_knownRooms.clear();
     m_knownGroups.clear();
     m_knownScenes.clear();
+    m_aggregates.clear();
+    m_membership.clear();
+    m_serviceOwners.clear();
+    m_groupedLightByGroup.clear();
+    m_scenePredictor.clear();
+    m_publishedAggregates.clear();
+    m_aggregateDescriptors.clear();
+    m_pendingCommands.clear();
+    m_deferredRenames.clear();
+    m_discoveryDeferred = false;
     setConnectionState(false);
     std::cerr << "hue-ipc disconnected" << '\n';
 }
 
 void HueAdapterInstance::onConfigChanged(const phi::ConfigChangedRequest &request)
 {
+    const QString previousBridge = m_session ? BridgeSession::keyFor(m_settings) : QString();
     applyRuntimeConfig(request);
     m_runtimeConfigured = true;
-    m_nextPollDueMs = 0;
-    m_nextEventStreamRetryDueMs = 0;
-    m_eventStreamRetryCount = 0;
-    stopEventStream();
-    startEventStream();
+    // Only another bridge identity (address, port, TLS, app key) needs
+    // another session. Anything else is applied to the current one, which
+    // keeps its connections, latency history and pending commands.
+    if (!previousBridge.isEmpty() && previousBridge == BridgeSession::keyFor(m_settings)) {
+        configureSession();
+        m_session->updateSubscriber(m_subscriptionId, m_syncFilter, m_pollIntervalMs, m_retryIntervalMs);
+    } else {
+        m_discoveryResourceId.clear();
+        m_discovery = DiscoverySession{};
+        attachSession();
+    }
+    // The host re-sends the config after a reconnect; onDisconnected stopped
+    // the tick that flushes deltas and expires button and dial state.
+    if (m_tickTimer && !m_tickTimer->isActive())
+        m_tickTimer->start();
 
     std::cerr << "hue-ipc config.changed adapterId=" << request.adapterId
               << " externalId=" << request.adapter.externalId
@@ -331,7 +483,21 @@ void HueAdapterInstance::onConfigChanged(const phi::ConfigChangedRequest &reques
 
 void HueAdapterInstance::onChannelInvoke(const phi::ChannelInvokeRequest &request)
 {
-    submitCmdResult(handleChannelInvoke(request), "channel.invoke");
+    const QString deviceExternalId = QString::fromStdString(request.deviceExternalId);
+    if (!m_runtimeConfigured
+        || m_lightResourceByDevice.contains(deviceExternalId)
+        || !aggregateGroupId(deviceExternalId).isEmpty()) {
+        submitCmdResult(handleChannelInvoke(request), "channel.invoke");
+        return;
+    }
+
+    // Not in the last snapshot yet: look the light up without blocking.
+    m_taskCmdIds.insert(request.cmdId);
+    resolveLightResource(deviceExternalId, m_taskToken)
+        .start(m_sessionContext.get(), [this, request](const QString &) {
+            m_taskCmdIds.remove(request.cmdId);
+            submitCmdResult(handleChannelInvoke(request), "channel.invoke");
+        });
 }
 
 phicore::adapter::v1::CmdResponse HueAdapterInstance::handleChannelInvoke(const phi::ChannelInvokeRequest &request)
@@ -342,12 +508,11 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleChannelInvoke(const
     const QString deviceExternalId = QString::fromStdString(request.deviceExternalId);
     const QString channelExternalId = QString::fromStdString(request.channelExternalId);
 
-    QString lightId = m_lightResourceByDevice.value(deviceExternalId);
-    if (lightId.isEmpty()) {
-        QString refreshError;
-        pollBridge(&refreshError);
-        lightId = m_lightResourceByDevice.value(deviceExternalId);
-    }
+    const QString groupExternalId = aggregateGroupId(deviceExternalId);
+    if (!groupExternalId.isEmpty())
+        return handleGroupedLightInvoke(request, groupExternalId);
+
+    const QString lightId = m_lightResourceByDevice.value(deviceExternalId);
 
     if (lightId.isEmpty()) {
         return failureResponse(request.cmdId,
@@ -361,11 +526,7 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleChannelInvoke(const
         return failureResponse(request.cmdId, CmdStatus::InvalidArgument, payloadError);
 
     QString asyncError;
-    if (!m_http->putJsonAsync(m_settings,
-                             QStringLiteral("/clip/v2/resource/light/%1").arg(lightId),
-                             payload,
-                             true,
-                             &asyncError)) {
+    if (!sendLightCommand(QStringLiteral("/clip/v2/resource/light/%1").arg(lightId), payload, &asyncError)) {
         const QString error = asyncError.isEmpty() ? QStringLiteral("Hue command could not be sent") : asyncError;
         return failureResponse(request.cmdId, CmdStatus::TemporarilyOffline, error);
     }
@@ -377,8 +538,10 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleChannelInvoke(const
     v1::Utf8String sendError;
     if (channelExternalId == QLatin1String("on") && request.hasScalarValue) {
         const auto on = scalarAsBool(request.value);
-        if (on.has_value())
+        if (on.has_value()) {
             sendChannelStateUpdated(request.deviceExternalId, request.channelExternalId, *on, nowMs(), &sendError);
+            noteChannelValue(deviceExternalId, request.channelExternalId, *on ? 1.0 : 0.0, nowMs());
+        }
     } else if ((channelExternalId == QLatin1String("bri") || channelExternalId == QLatin1String("ct"))
                && request.hasScalarValue) {
         const auto value = scalarAsDouble(request.value);
@@ -401,6 +564,8 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleChannelInvoke(const
                                         brightness > 0.0,
                                         nowMs(),
                                         &sendError);
+                noteChannelValue(deviceExternalId, "bri", brightness, nowMs());
+                noteChannelValue(deviceExternalId, "on", brightness > 0.0 ? 1.0 : 0.0, nowMs());
             }
         }
     }
@@ -408,8 +573,70 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleChannelInvoke(const
     return resp;
 }
 
+phicore::adapter::v1::CmdResponse HueAdapterInstance::handleGroupedLightInvoke(
+    const phi::ChannelInvokeRequest &request,
+    const QString &groupExternalId)
+{
+    const QString groupedLightId = m_groupedLightByGroup.value(groupExternalId);
+    if (groupedLightId.isEmpty()) {
+        return failureResponse(request.cmdId,
+                               CmdStatus::InvalidArgument,
+                               QStringLiteral("No Hue grouped_light resource for group"));
+    }
+
+    const QString channelExternalId = QString::fromStdString(request.channelExternalId);
+    QString lightChannel;
+    if (channelExternalId == QLatin1String("any_on"))
+        lightChannel = QStringLiteral("on");
+    else if (channelExternalId == QLatin1String("avg_bri"))
+        lightChannel = QStringLiteral("bri");
+    else
+        return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("Channel is read-only"));
+
+    QString payloadError;
+    const QByteArray payload = buildLightCommandPayload(lightChannel, request, &payloadError);
+    if (payload.isEmpty())
+        return failureResponse(request.cmdId, CmdStatus::InvalidArgument, payloadError);
+
+    // Member light events update the aggregate once the bridge has applied it.
+    QString asyncError;
+    if (!sendLightCommand(QStringLiteral("/clip/v2/resource/grouped_light/%1").arg(groupedLightId),
+                          payload,
+                          &asyncError)) {
+        const QString error = asyncError.isEmpty() ? QStringLiteral("Hue command could not be sent") : asyncError;
+        return failureResponse(request.cmdId, CmdStatus::TemporarilyOffline, error);
+    }
+
+    CmdResponse resp = successResponse(request.cmdId);
+    if (request.hasScalarValue)
+        resp.finalValue = request.value;
+    return resp;
+}
+
 void HueAdapterInstance::onAdapterActionInvoke(const phi::AdapterActionInvokeRequest &request)
 {
+    if (request.actionId == "startDeviceDiscovery" && m_runtimeConfigured && m_session
+        && m_session->loadShedder().active()) {
+        m_discoveryDeferred = true;
+        m_session->loadShedder().noteDeferredDiscovery(nowMs());
+        // Not started yet, so not a success; the bridge load decides when.
+        ActionResponse response;
+        response.id = request.cmdId;
+        response.tsMs = nowMs();
+        response.status = CmdStatus::TemporarilyOffline;
+        response.error = "Hue bridge is overloaded; discovery starts once it recovers";
+        submitActionResult(std::move(response), "adapter.action.invoke");
+        return;
+    }
+    if (request.actionId == "startDeviceDiscovery" && m_runtimeConfigured) {
+        m_taskActionIds.insert(request.cmdId);
+        startDeviceDiscovery(request.cmdId, m_taskToken)
+            .start(m_sessionContext.get(), [this](ActionResponse response) {
+                m_taskActionIds.remove(response.id);
+                submitActionResult(std::move(response), "adapter.action.invoke");
+            });
+        return;
+    }
     submitActionResult(handleAdapterActionInvoke(request), "adapter.action.invoke");
 }
 
@@ -417,8 +644,18 @@ phicore::adapter::v1::ActionResponse HueAdapterInstance::handleAdapterActionInvo
     const phi::AdapterActionInvokeRequest &request)
 {
     const QString actionId = QString::fromStdString(request.actionId);
-    if (actionId == QLatin1String("startDeviceDiscovery"))
-        return invokeStartDeviceDiscovery(request);
+    if (actionId == QLatin1String("startDeviceDiscovery")) {
+        ActionResponse resp;
+        resp.id = request.cmdId;
+        resp.status = CmdStatus::TemporarilyOffline;
+        resp.error = "Adapter not configured";
+        resp.tsMs = nowMs();
+        return resp;
+    }
+    if (actionId == QLatin1String("queryHistory"))
+        return invokeQueryHistory(request);
+    if (actionId == QLatin1String("memoryFootprint"))
+        return invokeMemoryFootprint(request);
 
     ActionResponse resp;
     resp.id = request.cmdId;
@@ -430,49 +667,88 @@ phicore::adapter::v1::ActionResponse HueAdapterInstance::handleAdapterActionInvo
 
 void HueAdapterInstance::onDeviceNameUpdate(const phi::DeviceNameUpdateRequest &request)
 {
-    submitCmdResult(handleDeviceNameUpdate(request), "device.name.update");
+    if (!m_runtimeConfigured || !m_http) {
+        submitCmdResult(failureResponse(request.cmdId, CmdStatus::TemporarilyOffline, QStringLiteral("Adapter not configured")),
+                        "device.name.update");
+        return;
+    }
+
+    // The PUT runs on the event loop rather than a nested one, so a detach
+    // while it is in flight cancels it instead of freeing the session below it.
+    m_taskCmdIds.insert(request.cmdId);
+    handleDeviceNameUpdate(request, m_taskToken).start(m_sessionContext.get(), [this](CmdResponse response) {
+        m_taskCmdIds.remove(response.id);
+        submitCmdResult(std::move(response), "device.name.update");
+    });
 }
 
-phicore::adapter::v1::CmdResponse HueAdapterInstance::handleDeviceNameUpdate(
-    const phi::DeviceNameUpdateRequest &request)
+Task<phicore::adapter::v1::CmdResponse> HueAdapterInstance::handleDeviceNameUpdate(
+    phi::DeviceNameUpdateRequest request,
+    CancelToken token)
 {
     if (request.deviceExternalId.empty())
-        return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("deviceExternalId missing"));
+        co_return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("deviceExternalId missing"));
     if (request.name.empty())
-        return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("name missing"));
+        co_return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("name missing"));
 
     const QString deviceExternalId = QString::fromStdString(request.deviceExternalId);
-
-    QJsonObject metadata;
-    metadata.insert(QStringLiteral("name"), QString::fromStdString(request.name));
-    QJsonObject payload;
-    payload.insert(QStringLiteral("metadata"), metadata);
-
-    const HttpResult result = m_http->putJson(m_settings,
-                                             QStringLiteral("/clip/v2/resource/device/%1").arg(deviceExternalId),
-                                             QJsonDocument(payload).toJson(QJsonDocument::Compact),
-                                             true,
-                                             10000);
+    const QString name = QString::fromStdString(request.name);
+
+    if (m_session && m_session->loadShedder().active()) {
+        // Sent once the bridge recovers; the latest name per device wins. The
+        // local name follows only when the bridge has accepted it.
+        m_deferredRenames.insert(deviceExternalId, name);
+        m_session->loadShedder().noteDeferredRename(nowMs());
+        co_return failureResponse(request.cmdId,
+                                  CmdStatus::TemporarilyOffline,
+                                  QStringLiteral("Hue bridge is overloaded; the rename is sent once it recovers"));
+    }
+
+    const HttpResult result = co_await awaitRequest(*m_http,
+                                                    m_settings,
+                                                    QByteArrayLiteral("PUT"),
+                                                    QStringLiteral("/clip/v2/resource/device/%1").arg(deviceExternalId),
+                                                    renamePayload(name),
+                                                    true,
+                                                    0,
+                                                    token);
+    if (token.cancelled())
+        co_return failureResponse(request.cmdId, CmdStatus::TemporarilyOffline, QStringLiteral("Adapter stopped"));
     if (!result.ok) {
         QString error = extractHueError(result.payload);
         if (error.isEmpty())
             error = result.error.isEmpty() ? QStringLiteral("Rename request failed") : result.error;
-        return failureResponse(request.cmdId, CmdStatus::Failure, error);
+        co_return failureResponse(request.cmdId, CmdStatus::Failure, error);
     }
 
-    auto it = m_devices.find(deviceExternalId);
-    if (it != m_devices.end()) {
-        it->device.name = request.name;
-        v1::Utf8String sendError;
-        sendDeviceUpdated(it->device, it->channels, &sendError);
-    }
+    applyDeviceName(deviceExternalId, request.name);
+    co_return successResponse(request.cmdId);
+}
 
-    return successResponse(request.cmdId);
+void HueAdapterInstance::applyDeviceName(const QString &deviceExternalId, const std::string &name)
+{
+    auto it = m_devices.find(deviceExternalId);
+    if (it == m_devices.end())
+        return;
+    it->device.name = name;
+    v1::Utf8String sendError;
+    sendDeviceUpdated(materializeDevice(*it), materializeChannels(it->channels), &sendError);
 }
 
 void HueAdapterInstance::onDeviceEffectInvoke(const phi::DeviceEffectInvokeRequest &request)
 {
-    submitCmdResult(handleDeviceEffectInvoke(request), "device.effect.invoke");
+    const QString deviceExternalId = QString::fromStdString(request.deviceExternalId);
+    if (!m_runtimeConfigured || deviceExternalId.isEmpty() || m_lightResourceByDevice.contains(deviceExternalId)) {
+        submitCmdResult(handleDeviceEffectInvoke(request), "device.effect.invoke");
+        return;
+    }
+
+    m_taskCmdIds.insert(request.cmdId);
+    resolveLightResource(deviceExternalId, m_taskToken)
+        .start(m_sessionContext.get(), [this, request](const QString &) {
+            m_taskCmdIds.remove(request.cmdId);
+            submitCmdResult(handleDeviceEffectInvoke(request), "device.effect.invoke");
+        });
 }
 
 phicore::adapter::v1::CmdResponse HueAdapterInstance::handleDeviceEffectInvoke(
@@ -485,12 +761,7 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleDeviceEffectInvoke(
     }
 
     const QString deviceExternalId = QString::fromStdString(request.deviceExternalId);
-    QString lightId = m_lightResourceByDevice.value(deviceExternalId);
-    if (lightId.isEmpty()) {
-        QString refreshError;
-        pollBridge(&refreshError);
-        lightId = m_lightResourceByDevice.value(deviceExternalId);
-    }
+    const QString lightId = m_lightResourceByDevice.value(deviceExternalId);
     if (lightId.isEmpty()) {
         return failureResponse(request.cmdId,
                                CmdStatus::InvalidArgument,
@@ -506,8 +777,8 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleDeviceEffectInvoke(
     const v1::DeviceEffect requestedEffect = request.effect;
 
     const v1::DeviceEffectDescriptor *descriptor = nullptr;
-    if (deviceEntry) {
-        for (const v1::DeviceEffectDescriptor &desc : deviceEntry->device.effects) {
+    if (deviceEntry && deviceEntry->product) {
+        for (const v1::DeviceEffectDescriptor &desc : deviceEntry->product->effects) {
             if (!effectId.isEmpty() && desc.id == effectId.toStdString()) {
                 descriptor = &desc;
                 break;
@@ -571,13 +842,24 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleDeviceEffectInvoke(
 
 void HueAdapterInstance::onSceneInvoke(const phi::SceneInvokeRequest &request)
 {
-    submitCmdResult(handleSceneInvoke(request), "scene.invoke");
+    if (!m_runtimeConfigured || !m_http) {
+        submitCmdResult(failureResponse(request.cmdId, CmdStatus::TemporarilyOffline, QStringLiteral("Adapter not configured")),
+                        "scene.invoke");
+        return;
+    }
+
+    m_taskCmdIds.insert(request.cmdId);
+    handleSceneInvoke(request, m_taskToken).start(m_sessionContext.get(), [this](CmdResponse response) {
+        m_taskCmdIds.remove(response.id);
+        submitCmdResult(std::move(response), "scene.invoke");
+    });
 }
 
-phicore::adapter::v1::CmdResponse HueAdapterInstance::handleSceneInvoke(const phi::SceneInvokeRequest &request)
+Task<phicore::adapter::v1::CmdResponse> HueAdapterInstance::handleSceneInvoke(phi::SceneInvokeRequest request,
+                                                                             CancelToken token)
 {
     if (request.sceneExternalId.empty())
-        return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("sceneExternalId missing"));
+        co_return failureResponse(request.cmdId, CmdStatus::InvalidArgument, QStringLiteral("sceneExternalId missing"));
 
     const QString action = QString::fromStdString(request.action).trimmed().toLower();
     QString recallAction = QStringLiteral("active");
@@ -601,24 +883,31 @@ phicore::adapter::v1::CmdResponse HueAdapterInstance::handleSceneInvoke(const ph
     payload.insert(QStringLiteral("recall"), recall);
 
     const QString sceneExternalId = QString::fromStdString(request.sceneExternalId);
-    const HttpResult result = m_http->putJson(m_settings,
-                                             QStringLiteral("/clip/v2/resource/scene/%1").arg(sceneExternalId),
-                                             QJsonDocument(payload).toJson(QJsonDocument::Compact),
-                                             true,
-                                             10000);
+    const HttpResult result = co_await awaitRequest(*m_http,
+                                                    m_settings,
+                                                    QByteArrayLiteral("PUT"),
+                                                    QStringLiteral("/clip/v2/resource/scene/%1").arg(sceneExternalId),
+                                                    QJsonDocument(payload).toJson(QJsonDocument::Compact),
+                                                    true,
+                                                    0,
+                                                    token);
+    if (token.cancelled())
+        co_return failureResponse(request.cmdId, CmdStatus::TemporarilyOffline, QStringLiteral("Adapter stopped"));
     if (!result.ok) {
         QString error = extractHueError(result.payload);
         if (error.isEmpty())
             error = result.error.isEmpty() ? QStringLiteral("Scene invocation failed") : result.error;
-        return failureResponse(request.cmdId, CmdStatus::Failure, error);
+        co_return failureResponse(request.cmdId, CmdStatus::Failure, error);
     }
 
-    return successResponse(request.cmdId);
+    if (recallAction == QLatin1String("active"))
+        publishScenePrediction(sceneExternalId, nowMs());
+    co_return successResponse(request.cmdId);
 }
 
 std::int64_t HueAdapterInstance::nowMs()
 {
-    return QDateTime::currentMSecsSinceEpoch();
+    return wallClockMs();
 }
 
 void HueAdapterInstance::applyRuntimeConfig(const phi::ConfigChangedRequest &request)
@@ -664,6 +953,33 @@ void HueAdapterInstance::applyRuntimeConfig(const phi::ConfigChangedRequest &req
         m_settings.port = m_settings.useTls ? 443 : 80;
 
     readIntervalsFromMeta();
+    m_syncFilter = syncFilterFromMeta(m_meta);
+
+    SensorFilterSettings sensorSettings;
+    sensorSettings.temperatureDeadband =
+        std::max(0.0, readDouble(m_meta, QStringLiteral("temperatureDeadband"), sensorSettings.temperatureDeadband));
+    sensorSettings.illuminanceDeadbandPercent = std::max(
+        0.0, readDouble(m_meta, QStringLiteral("illuminanceDeadbandPercent"), sensorSettings.illuminanceDeadbandPercent));
+    sensorSettings.temperatureMinIntervalMs = std::clamp(
+        readInt(m_meta, QStringLiteral("temperatureMinIntervalMs"), sensorSettings.temperatureMinIntervalMs), 0, 3600000);
+    sensorSettings.illuminanceMinIntervalMs = std::clamp(
+        readInt(m_meta, QStringLiteral("illuminanceMinIntervalMs"), sensorSettings.illuminanceMinIntervalMs), 0, 3600000);
+    m_sensorFilter.setSettings(sensorSettings);
+
+    const int historyBytes = std::clamp(readInt(m_meta, QStringLiteral("historyBytesPerDevice"), 4096), 0, 1048576);
+    m_history.setBudgetBytesPerDevice(static_cast<std::size_t>(historyBytes));
+
+    m_roomAggregatesEnabled = m_meta.value(QStringLiteral("roomAggregates")).toBool(true);
+
+    // Timing is process-wide; this instance only adds or drops its hold.
+    const bool stageTiming = m_meta.value(QStringLiteral("stageTiming")).toBool(false);
+    if (stageTiming != m_stageTimingHeld) {
+        if (stageTiming)
+            holdStageTiming();
+        else
+            releaseStageTiming();
+        m_stageTimingHeld = stageTiming;
+    }
 }
 
 void HueAdapterInstance::readIntervalsFromMeta()
@@ -672,158 +988,152 @@ void HueAdapterInstance::readIntervalsFromMeta()
     m_retryIntervalMs = std::clamp(readInt(m_meta, QStringLiteral("retryIntervalMs"), 10000), 1000, 600000);
 }
 
-void HueAdapterInstance::startEventStream()
+void HueAdapterInstance::attachSession()
 {
-    if (!m_runtimeConfigured || m_eventStreamReply)
-        return;
-
-    const QString host = HttpClient::effectiveHost(m_settings);
-    if (host.isEmpty() || m_settings.appKey.trimmed().isEmpty()) {
-        m_nextEventStreamRetryDueMs = nowMs() + std::max(1000, m_retryIntervalMs);
-        return;
-    }
-
-    const bool useTls = m_settings.useTls;
-    const int defaultPort = useTls ? 443 : 80;
-    const int port = m_settings.port > 0 ? m_settings.port : defaultPort;
-
-    QUrl url;
-    url.setScheme(useTls ? QStringLiteral("https") : QStringLiteral("http"));
-    url.setHost(host);
-    url.setPort(port);
-    url.setPath(QStringLiteral("/eventstream/clip/v2"));
-
-    QNetworkRequest request(url);
-    request.setRawHeader("Accept", "text/event-stream");
-    request.setRawHeader("hue-application-key", m_settings.appKey.toUtf8());
-    request.setRawHeader("User-Agent", "phi-adapter-hue-ipc/1.0");
+    detachSession();
+
+    m_session = BridgeSession::acquire(m_settings);
+    m_http = &m_session->http();
+    configureSession();
+
+    m_sessionContext = std::make_unique<QObject>();
+    BridgeSubscriber subscriber;
+    subscriber.context = m_sessionContext.get();
+    subscriber.filter = m_syncFilter;
+    subscriber.pollIntervalMs = m_pollIntervalMs;
+    subscriber.retryIntervalMs = m_retryIntervalMs;
+    subscriber.onPoll = [this](const BridgePoll &poll) {
+        handleBridgePoll(poll);
+    };
+    subscriber.onEvents = [this](const QJsonArray &events, std::int64_t receivedMs) {
+        processEventStreamEvents(events, receivedMs);
+    };
+    subscriber.onConnectionState = [this](bool connected) {
+        setConnectionState(connected);
+    };
+    m_subscriptionId = m_session->subscribe(std::move(subscriber));
+}
 
-#if QT_CONFIG(ssl)
-    if (useTls) {
-        QSslConfiguration ssl = QSslConfiguration::defaultConfiguration();
-        ssl.setPeerVerifyMode(QSslSocket::VerifyNone);
-        request.setSslConfiguration(ssl);
+void HueAdapterInstance::configureSession()
+{
+    // Transport settings belong to the shared session; the instance that
+    // configured last wins. Overriding another subscriber's values is logged.
+    const std::size_t others = m_session->subscriberCount() - (m_subscriptionId != 0 ? 1 : 0);
+    const bool shared = others > 0;
+    TimeoutPolicy policy;
+    policy.connectTimeoutMs = std::clamp(
+        readInt(m_meta, QStringLiteral("connectTimeoutMs"), policy.connectTimeoutMs), 250, 60000);
+    policy.minTimeoutMs = std::clamp(
+        readInt(m_meta, QStringLiteral("requestTimeoutMinMs"), policy.minTimeoutMs), 250, 60000);
+    policy.maxTimeoutMs = std::clamp(
+        readInt(m_meta, QStringLiteral("requestTimeoutMaxMs"), policy.maxTimeoutMs), policy.minTimeoutMs, 120000);
+    const bool http2 = m_meta.value(QStringLiteral("http2")).toBool(true);
+
+    LoadShedPolicy shed;
+    shed.enabled = m_meta.value(QStringLiteral("loadShedding")).toBool(shed.enabled);
+    shed.enterRatio = std::clamp(readDouble(m_meta, QStringLiteral("loadShedEnterRatio"), shed.enterRatio), 1.5, 20.0);
+    shed.exitRatio =
+        std::clamp(readDouble(m_meta, QStringLiteral("loadShedExitRatio"), shed.exitRatio), 1.0, shed.enterRatio);
+    shed.recoveryMs = std::clamp(readInt(m_meta, QStringLiteral("loadShedRecoveryMs"), shed.recoveryMs), 1000, 600000);
+    shed.pollStretch = std::clamp(readInt(m_meta, QStringLiteral("loadShedPollStretch"), shed.pollStretch), 1, 20);
+    shed.coalesceMs = std::clamp(readInt(m_meta, QStringLiteral("loadShedCoalesceMs"), shed.coalesceMs), 0, 5000);
+
+    if (shared) {
+        const bool timeoutsChanged = !(m_http->timeoutPolicy() == policy);
+        const bool http2Changed = m_http->transportStats().http2Allowed != http2;
+        const bool sheddingChanged = !(m_session->loadShedder().policy() == shed);
+        if (timeoutsChanged || http2Changed || sheddingChanged) {
+            std::cerr << "hue-ipc session.override ip=" << m_settings.ip.toStdString()
+                      << " port=" << m_settings.port
+                      << " subscribers=" << m_session->subscriberCount()
+                      << " timeouts=" << (timeoutsChanged ? "changed" : "kept")
+                      << " http2=" << (http2Changed ? "changed" : "kept")
+                      << " loadShedding=" << (sheddingChanged ? "changed" : "kept")
+                      << '\n';
+        }
     }
-#endif
+    m_http->setTimeoutPolicy(policy);
+    m_http->setHttp2Allowed(http2);
+    m_session->loadShedder().setPolicy(shed);
+}
 
-    m_eventStreamReply = m_eventStreamNetwork->get(request);
-    if (!m_eventStreamReply) {
-        m_nextEventStreamRetryDueMs = nowMs() + std::max(1000, m_retryIntervalMs);
+void HueAdapterInstance::detachSession()
+{
+    // Destroying the context drops queued callbacks and the completions of
+    // pending tasks; cancelling then unwinds those tasks while the session
+    // and its HTTP client are still alive.
+    m_sessionContext.reset();
+    m_taskToken.cancel();
+    m_taskToken = CancelToken{};
+    if (m_session)
+        m_session->unsubscribe(m_subscriptionId);
+    m_subscriptionId = 0;
+    m_http = nullptr;
+    m_session.reset();
+
+    // Their completions were dropped above, so core would never hear back.
+    const QSet<std::uint64_t> cmdIds = std::exchange(m_taskCmdIds, {});
+    for (const std::uint64_t cmdId : cmdIds) {
+        submitCmdResult(failureResponse(cmdId, CmdStatus::TemporarilyOffline, QStringLiteral("Bridge session closed")),
+                        "command");
+    }
+    const QSet<std::uint64_t> actionIds = std::exchange(m_taskActionIds, {});
+    for (const std::uint64_t cmdId : actionIds) {
+        ActionResponse response;
+        response.id = cmdId;
+        response.status = CmdStatus::TemporarilyOffline;
+        response.error = "Bridge session closed";
+        response.tsMs = nowMs();
+        submitActionResult(std::move(response), "adapter.action.invoke");
     }
 }
 
-void HueAdapterInstance::stopEventStream()
+void HueAdapterInstance::requestPoll()
 {
-    if (!m_eventStreamReply)
-        return;
-
-    m_eventStreamReply->abort();
-    m_eventStreamReply->deleteLater();
-    m_eventStreamReply = nullptr;
-    m_eventStreamLineBuffer.clear();
-    m_eventStreamDataBuffer.clear();
-    m_eventStreamActive = false;
+    if (m_session)
+        m_session->requestPoll();
 }
 
-void HueAdapterInstance::pumpEventStream(std::int64_t now)
+void HueAdapterInstance::processEventStreamEvents(const QJsonArray &events, std::int64_t nowMs)
 {
-    if (!m_eventStreamReply)
-        return;
-
-    const QByteArray chunk = m_eventStreamReply->readAll();
-    if (!chunk.isEmpty()) {
-        setConnectionState(true);
-        m_eventStreamActive = true;
-        m_eventStreamRetryCount = 0;
-        m_nextEventStreamRetryDueMs = now + std::max(1000, m_retryIntervalMs);
-        m_eventStreamLineBuffer.append(chunk);
-
-        while (true) {
-            const int newline = m_eventStreamLineBuffer.indexOf('\n');
-            if (newline < 0)
-                break;
-
-            QByteArray line = m_eventStreamLineBuffer.left(newline);
-            m_eventStreamLineBuffer.remove(0, newline + 1);
-            if (!line.isEmpty() && line.endsWith('\r'))
-                line.chop(1);
-
-            if (line.isEmpty()) {
-                if (!m_eventStreamDataBuffer.isEmpty()) {
-                    processEventStreamPayload(m_eventStreamDataBuffer, now);
-                    m_eventStreamDataBuffer.clear();
-                }
-                continue;
-            }
-
-            if (line.startsWith("data:")) {
-                QByteArray payload = line.mid(5);
-                if (!payload.isEmpty() && payload.at(0) == ' ')
-                    payload.remove(0, 1);
-                if (!m_eventStreamDataBuffer.isEmpty())
-                    m_eventStreamDataBuffer.append('\n');
-                m_eventStreamDataBuffer.append(payload);
-            }
+    struct LatencySample {
+        LatencyHistogram &histogram;
+        std::chrono::steady_clock::time_point started;
+        ~LatencySample()
+        {
+            histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - started).count());
         }
-    }
+    } latencySample{m_eventLatencyUs, std::chrono::steady_clock::now()};
 
-    if (!m_eventStreamReply->isFinished())
-        return;
-
-    const bool hasError = m_eventStreamReply->error() != QNetworkReply::NoError;
-    if (hasError) {
-        std::cerr << "hue-ipc eventstream error: "
-                  << m_eventStreamReply->errorString().toStdString()
-                  << '\n';
-    } else {
-        std::cerr << "hue-ipc eventstream finished" << '\n';
-    }
-
-    m_eventStreamReply->deleteLater();
-    m_eventStreamReply = nullptr;
-    m_eventStreamLineBuffer.clear();
-    m_eventStreamDataBuffer.clear();
-    m_eventStreamActive = false;
-
-    if (hasError)
-        setConnectionState(false);
-
-    int retryDelayMs = m_retryIntervalMs;
-    if (m_eventStreamRetryCount < kEventStreamFastRetryAttempts) {
-        ++m_eventStreamRetryCount;
-        retryDelayMs = kEventStreamFastRetryMs;
-    }
-    m_nextEventStreamRetryDueMs = now + std::max(1000, retryDelayMs);
-}
-
-void HueAdapterInstance::processEventStreamPayload(const QByteArray &jsonData, std::int64_t nowMs)
-{
-    QJsonParseError parseError{};
-    const QJsonDocument doc = QJsonDocument::fromJson(jsonData, &parseError);
-    if (parseError.error != QJsonParseError::NoError)
+    if (!m_runtimeConfigured)
         return;
 
-    if (doc.isArray()) {
-        for (const QJsonValue &entry : doc.array()) {
-            if (!entry.isObject())
-                continue;
-            processEventStreamEventObject(entry.toObject(), nowMs);
-        }
-        return;
+    for (const QJsonValue &entry : events) {
+        if (!entry.isObject())
+            continue;
+        processEventStreamEventObject(entry.toObject(), nowMs);
     }
-
-    if (doc.isObject())
-        processEventStreamEventObject(doc.object(), nowMs);
+    flushChannelDeltas();
 }
 
 void HueAdapterInstance::processEventStreamEventObject(const QJsonObject &eventObj, std::int64_t nowMs)
 {
     const QString eventType = eventObj.value(QStringLiteral("type")).toString();
     if (eventType == QLatin1String("delete")) {
-        m_nextPollDueMs = 0;
+        requestPoll();
         return;
     }
 
+    const bool isAdd = (eventType == QLatin1String("add"));
+    // A join adds the device and each of its services; while discovery runs
+    // those additions share one reconciling poll instead of one each.
+    auto pollForEvent = [this, isAdd, nowMs]() {
+        if (isAdd && m_discovery.active)
+            deferDiscoveryPoll(nowMs);
+        else
+            requestPoll();
+    };
     const QJsonArray dataArray = eventObj.value(QStringLiteral("data")).toArray();
     for (const QJsonValue &entry : dataArray) {
         if (!entry.isObject())
@@ -831,41 +1141,94 @@ void HueAdapterInstance::processEventStreamEventObject(const QJsonObject &eventO
         const QJsonObject resourceObj = entry.toObject();
         const QString resourceType = resourceObj.value(QStringLiteral("type")).toString();
 
+        if (resourceType == QLatin1String("zigbee_device_discovery")) {
+            handleDiscoveryEvent(resourceObj, nowMs);
+            continue;
+        }
+        if (!m_syncFilter.resourceNeeded(resourceType))
+            continue;
+        if (isAdd && m_discovery.active && resourceType == QLatin1String("device")) {
+            // Joined devices are published as they come; the poll fills in
+            // their services.
+            handleDiscoveredDevice(resourceObj);
+            deferDiscoveryPoll(nowMs);
+            continue;
+        }
+
         if (resourceType == QLatin1String("relative_rotary")) {
-            handleRelativeRotaryEvent(resourceObj, nowMs);
+            if (m_syncFilter.channelEnabled(QStringLiteral("dial")))
+                handleRelativeRotaryEvent(resourceObj, nowMs);
             continue;
         }
         if (resourceType == QLatin1String("button")) {
-            handleButtonEvent(resourceObj, nowMs);
+            if (m_syncFilter.channelEnabled(QStringLiteral("button")))
+                handleButtonEvent(resourceObj, nowMs);
             continue;
         }
         if (resourceType == QLatin1String("zigbee_connectivity")) {
+            if (!m_syncFilter.channelEnabled(QStringLiteral("zigbee_status")))
+                continue;
             const QString deviceExternalId = deviceExternalIdFromResource(resourceObj);
             if (deviceExternalId.isEmpty())
                 continue;
             const std::optional<std::int64_t> status = parseConnectivityStatus(resourceObj);
             if (!status.has_value())
                 continue;
-            v1::Utf8String sendError;
-            sendChannelStateUpdated(deviceExternalId.toStdString(),
-                                    "zigbee_status",
-                                    *status,
-                                    nowMs,
-                                    &sendError);
+            queueChannelState(deviceExternalId, "zigbee_status", *status, nowMs, DeltaPriority::Telemetry);
+            continue;
+        }
+        if (resourceType == QLatin1String("temperature") || resourceType == QLatin1String("light_level")) {
+            const SensorKind kind = resourceType == QLatin1String("temperature")
+                ? SensorKind::Temperature
+                : SensorKind::Illuminance;
+            if (!handleSensorEvent(kind, resourceObj, nowMs))
+                pollForEvent();
             continue;
         }
 
+        if (resourceType == QLatin1String("light")) {
+            // Echo of a predicted scene state: publish what the light reports
+            // and skip the poll unless the event carries more than we track.
+            StageTimer timer(Stage::EventLight);
+            const QString lightId = resourceObj.value(QStringLiteral("id")).toString().trimmed();
+            const LightState observed = parseLightState(resourceObj);
+            if (m_scenePredictor.resolve(lightId, observed)) {
+                QString deviceExternalId = deviceExternalIdFromResource(resourceObj);
+                if (deviceExternalId.isEmpty())
+                    deviceExternalId = m_serviceOwners.value(lightId);
+                applyLightState(deviceExternalId, observed, nowMs);
+                static const QSet<QString> trackedKeys = {
+                    QStringLiteral("id"), QStringLiteral("id_v1"), QStringLiteral("owner"), QStringLiteral("type"),
+                    QStringLiteral("on"), QStringLiteral("dimming"), QStringLiteral("color_temperature"),
+                };
+                const QStringList keys = resourceObj.keys();
+                const bool covered = std::all_of(keys.cbegin(), keys.cend(), [](const QString &key) {
+                    return trackedKeys.contains(key);
+                });
+                if (!covered)
+                    pollForEvent();
+                continue;
+            }
+        }
+
+        if ((resourceType == QLatin1String("room") || resourceType == QLatin1String("zone"))
+            && resourceObj.contains(QStringLiteral("children"))) {
+            // Membership deltas apply right away; the poll below republishes
+            // the room itself.
+            const QString groupId = resourceObj.value(QStringLiteral("id")).toString().trimmed();
+            if (!groupId.isEmpty())
+                applyMembershipDelta(groupId, memberDeviceIds(resourceObj, m_serviceOwners), nowMs);
+        }
+
         if (resourceType == QLatin1String("light")
             || resourceType == QLatin1String("motion")
             || resourceType == QLatin1String("tamper")
-            || resourceType == QLatin1String("temperature")
-            || resourceType == QLatin1String("light_level")
             || resourceType == QLatin1String("device_power")
             || resourceType == QLatin1String("scene")
             || resourceType == QLatin1String("room")
             || resourceType == QLatin1String("zone")
             || resourceType == QLatin1String("device")) {
-            m_nextPollDueMs = 0;
+            pollForEvent();
         }
     }
 }
@@ -884,34 +1247,34 @@ QString HueAdapterInstance::resolveButtonChannel(const QString &deviceExternalId
 {
     QString channelExternalId = m_buttonResourceToChannel.value(buttonResourceId);
     const auto deviceIt = m_devices.constFind(deviceExternalId);
-    const v1::ChannelList *channels = (deviceIt != m_devices.cend()) ? &deviceIt->channels : nullptr;
+    const ChannelSlots *channels = (deviceIt != m_devices.cend()) ? &deviceIt->channels : nullptr;
 
     const QJsonObject metadataObj = resourceObj.value(QStringLiteral("metadata")).toObject();
     const int controlId = metadataObj.value(QStringLiteral("control_id")).toInt(0);
 
     if (channelExternalId.isEmpty() && controlId > 0 && channels) {
-        const QString candidate = QStringLiteral("button%1").arg(controlId);
-        for (const v1::Channel &channel : *channels) {
-            if (QString::fromStdString(channel.externalId) == candidate) {
-                channelExternalId = candidate;
+        const std::string candidate = "button" + std::to_string(controlId);
+        for (const ChannelSlot &channel : *channels) {
+            if (channel.externalId() == candidate) {
+                channelExternalId = QString::fromStdString(candidate);
                 break;
             }
         }
     }
 
     if (channelExternalId.isEmpty() && channels) {
-        QString firstButtonN;
-        for (const v1::Channel &channel : *channels) {
-            const QString id = QString::fromStdString(channel.externalId);
-            if (id == QLatin1String("button")) {
-                channelExternalId = id;
+        const std::string *firstButtonN = nullptr;
+        for (const ChannelSlot &channel : *channels) {
+            const std::string &id = channel.externalId();
+            if (id == "button") {
+                channelExternalId = QStringLiteral("button");
                 break;
             }
-            if (firstButtonN.isEmpty() && id.startsWith(QStringLiteral("button")))
-                firstButtonN = id;
+            if (!firstButtonN && id.rfind("button", 0) == 0)
+                firstButtonN = &id;
         }
-        if (channelExternalId.isEmpty() && !firstButtonN.isEmpty())
-            channelExternalId = firstButtonN;
+        if (channelExternalId.isEmpty() && firstButtonN)
+            channelExternalId = QString::fromStdString(*firstButtonN);
     }
 
     if (channelExternalId.isEmpty())
@@ -921,6 +1284,7 @@ QString HueAdapterInstance::resolveButtonChannel(const QString &deviceExternalId
 
 void HueAdapterInstance::handleRelativeRotaryEvent(const QJsonObject &resourceObj, std::int64_t nowMs)
 {
+    StageTimer timer(Stage::EventRotary);
     const QString deviceExternalId = deviceExternalIdFromResource(resourceObj);
     if (deviceExternalId.isEmpty())
         return;
@@ -957,18 +1321,15 @@ void HueAdapterInstance::handleRelativeRotaryEvent(const QJsonObject &resourceOb
     if (reportTs > 0)
         eventTs = reportTs;
 
-    v1::Utf8String sendError;
-    sendChannelStateUpdated(deviceExternalId.toStdString(),
-                            "dial",
-                            static_cast<std::int64_t>(steps),
-                            eventTs,
-                            &sendError);
-    m_lastDialValueByDevice.insert(deviceExternalId, steps);
-    m_dialResetDueMs.insert(deviceExternalId, nowMs + kDialResetDelayMs);
+    queueChannelState(deviceExternalId, "dial", static_cast<std::int64_t>(steps), eventTs, DeltaPriority::Interactive);
+    DeviceEventState &state = eventStateFor(deviceExternalId, nowMs);
+    state.lastDialValue = steps;
+    state.dialResetDueMs = nowMs + kDialResetDelayMs;
 }
 
 void HueAdapterInstance::handleButtonEvent(const QJsonObject &resourceObj, std::int64_t nowMs)
 {
+    StageTimer timer(Stage::EventButton);
     const QString deviceExternalId = deviceExternalIdFromResource(resourceObj);
     if (deviceExternalId.isEmpty())
         return;
@@ -994,94 +1355,214 @@ void HueAdapterInstance::handleButtonEvent(const QJsonObject &resourceObj, std::
         return;
 
     const QString channelExternalId = resolveButtonChannel(deviceExternalId, buttonResourceId, resourceObj);
-    if (!buttonResourceId.isEmpty())
-        m_buttonResourceToChannel.insert(buttonResourceId, channelExternalId);
-
-    const QString bindingKey = channelBindingKey(deviceExternalId, channelExternalId);
+    DeviceEventState &state = eventStateFor(deviceExternalId, nowMs);
+    if (!buttonResourceId.isEmpty() && !m_buttonResourceToChannel.contains(buttonResourceId)) {
+        if (m_buttonResourceToChannel.size() < kMaxButtonResourceBindings) {
+            m_buttonResourceToChannel.insert(buttonResourceId, channelExternalId);
+            state.learnedButtonResources.push_back(buttonResourceId);
+        } else {
+            ++m_eventStateEvictions;
+        }
+    }
 
     if (code == v1::ButtonEventCode::ShortPressRelease) {
-        ButtonMultiPressTracker &tracker = m_buttonMultiPress[bindingKey];
-        tracker.deviceExternalId = deviceExternalId;
-        tracker.channelExternalId = channelExternalId;
+        reserveEventSlot(&state.multiPress, channelExternalId, &m_eventStateEvictions);
+        ButtonMultiPressTracker &tracker = state.multiPress[channelExternalId];
         tracker.lastEventTs = eventTs;
-        tracker.lastSeenMs = nowMs;
         tracker.count += 1;
         tracker.dueMs = nowMs + kButtonMultiPressWindowMs;
-        m_buttonLastEventCode.remove(bindingKey);
-        m_buttonLastEventTs.remove(bindingKey);
+        state.lastEvent.remove(channelExternalId);
         return;
     }
 
-    v1::Utf8String sendError;
+    const std::string channelId = channelExternalId.toStdString();
     if (code == v1::ButtonEventCode::Repeat) {
-        const int prevCode = m_buttonLastEventCode.value(bindingKey, 0);
-        const std::int64_t prevTs = m_buttonLastEventTs.value(bindingKey, 0);
+        const ButtonLastEvent previous = state.lastEvent.value(channelExternalId);
+        const int prevCode = previous.code;
+        const std::int64_t prevTs = previous.ts;
         const bool hasRecentLongState =
             (prevCode == static_cast<int>(v1::ButtonEventCode::LongPress)
              || prevCode == static_cast<int>(v1::ButtonEventCode::Repeat))
             && prevTs > 0
             && (eventTs - prevTs) <= kButtonLongPressRepeatWindowMs;
         if (!hasRecentLongState) {
-            sendChannelStateUpdated(deviceExternalId.toStdString(),
-                                    channelExternalId.toStdString(),
-                                    static_cast<std::int64_t>(v1::ButtonEventCode::LongPress),
-                                    eventTs,
-                                    &sendError);
-            m_buttonLastEventCode.insert(bindingKey, static_cast<int>(v1::ButtonEventCode::LongPress));
-            m_buttonLastEventTs.insert(bindingKey, eventTs);
+            queueChannelState(deviceExternalId,
+                              channelId,
+                              static_cast<std::int64_t>(v1::ButtonEventCode::LongPress),
+                              eventTs,
+                              DeltaPriority::Interactive);
         }
     }
 
-    sendChannelStateUpdated(deviceExternalId.toStdString(),
-                            channelExternalId.toStdString(),
-                            static_cast<std::int64_t>(code),
-                            eventTs,
-                            &sendError);
+    queueChannelState(deviceExternalId, channelId, static_cast<std::int64_t>(code), eventTs, DeltaPriority::Interactive);
 
     if (code == v1::ButtonEventCode::LongPressRelease) {
-        m_buttonLastEventCode.remove(bindingKey);
-        m_buttonLastEventTs.remove(bindingKey);
+        state.lastEvent.remove(channelExternalId);
     } else {
-        m_buttonLastEventCode.insert(bindingKey, static_cast<int>(code));
-        m_buttonLastEventTs.insert(bindingKey, eventTs);
+        reserveEventSlot(&state.lastEvent, channelExternalId, &m_eventStateEvictions);
+        state.lastEvent.insert(channelExternalId, ButtonLastEvent{static_cast<int>(code), eventTs});
     }
 }
 
-void HueAdapterInstance::processPendingButtonAggregates(std::int64_t nowMs)
+bool HueAdapterInstance::handleSensorEvent(SensorKind kind, const QJsonObject &resourceObj, std::int64_t nowMs)
+{
+    StageTimer timer(Stage::EventSensor);
+    const QString channelId = QString::fromLatin1(channelIdForSensorKind(kind));
+    if (!m_syncFilter.channelEnabled(channelId))
+        return true;
+
+    const QString deviceExternalId = deviceExternalIdFromResource(resourceObj);
+    if (deviceExternalId.isEmpty() || !m_devices.contains(deviceExternalId))
+        return false;
+
+    std::optional<double> value;
+    if (kind == SensorKind::Temperature) {
+        value = parseTemperatureCelsius(resourceObj);
+    } else if (const std::optional<std::int64_t> lux = parseIlluminanceLux(resourceObj)) {
+        value = static_cast<double>(*lux);
+    }
+    if (!value.has_value())
+        return false;
+
+    publishSensorValue(deviceExternalId, kind, *value, nowMs);
+    return true;
+}
+
+void HueAdapterInstance::publishSensorValue(const QString &deviceExternalId,
+                                            SensorKind kind,
+                                            double value,
+                                            std::int64_t ts)
+{
+    if (m_sensorFilter.offer(deviceExternalId, kind, value, ts))
+        sendSensorState(deviceExternalId, kind, value, ts);
+}
+
+void HueAdapterInstance::sendSensorState(const QString &deviceExternalId,
+                                         SensorKind kind,
+                                         double value,
+                                         std::int64_t ts)
+{
+    const v1::ScalarValue scalar = sensorScalarValue(kind, value);
+    const std::string channelId = channelIdForSensorKind(kind);
+
+    auto it = m_devices.find(deviceExternalId);
+    if (it != m_devices.end()) {
+        for (ChannelSlot &channel : it->channels) {
+            if (channel.externalId() != channelId)
+                continue;
+            channel.hasValue = true;
+            channel.value = scalar;
+            break;
+        }
+    }
+
+    m_history.record(deviceExternalId, channelId, ts, value);
+    queueChannelState(deviceExternalId, channelId, scalar, ts, DeltaPriority::Telemetry);
+}
+
+void HueAdapterInstance::flushDeferredSensorValues(std::int64_t nowMs)
 {
-    QStringList dueKeys;
-    for (auto it = m_buttonMultiPress.cbegin(); it != m_buttonMultiPress.cend(); ++it) {
-        if (it->count > 0 && it->dueMs > 0 && nowMs >= it->dueMs)
-            dueKeys.push_back(it.key());
+    for (const SensorSample &sample : m_sensorFilter.takeDue(nowMs))
+        sendSensorState(sample.deviceExternalId, sample.kind, sample.value, nowMs);
+}
+
+void HueAdapterInstance::handleDiscoveryEvent(const QJsonObject &resourceObj, std::int64_t nowMs)
+{
+    StageTimer timer(Stage::EventDiscovery);
+    const QString id = resourceObj.value(QStringLiteral("id")).toString().trimmed();
+    if (!id.isEmpty())
+        m_discoveryResourceId = id;
+
+    const QString status = resourceObj.value(QStringLiteral("status")).toString().trimmed().toLower();
+    if (status == QLatin1String("active") && !m_discovery.active) {
+        m_discovery = DiscoverySession{};
+        m_discovery.active = true;
+        m_discovery.startedMs = nowMs;
+        m_discovery.deadlineMs = nowMs + kDiscoverySessionTimeoutMs;
+        std::cerr << "hue-ipc discovery active" << '\n';
+    } else if (status == QLatin1String("ready") && m_discovery.active) {
+        finishDiscoverySession("bridge ready");
     }
-    for (const QString &bindingKey : dueKeys)
-        finalizePendingShortPress(bindingKey);
 }
 
-void HueAdapterInstance::finalizePendingShortPress(const QString &bindingKey)
+void HueAdapterInstance::handleDiscoveredDevice(const QJsonObject &resourceObj)
 {
-    auto it = m_buttonMultiPress.find(bindingKey);
-    if (it == m_buttonMultiPress.end())
+    const QString deviceExternalId = resourceObj.value(QStringLiteral("id")).toString().trimmed();
+    if (deviceExternalId.isEmpty() || m_devices.contains(deviceExternalId)
+        || m_discovery.joinedDeviceIds.contains(deviceExternalId)) {
         return;
+    }
 
-    ButtonMultiPressTracker &tracker = it.value();
-    if (tracker.count <= 0) {
-        tracker.lastEventTs = 0;
-        tracker.lastSeenMs = 0;
-        tracker.dueMs = 0;
+    DeviceEntry entry = buildDeviceEntry(resourceObj);
+    v1::Utf8String sendError;
+    if (!sendDeviceUpdated(materializeDevice(entry), materializeChannels(entry.channels), &sendError)) {
+        std::cerr << "hue-ipc failed to publish discovered device: " << sendError << '\n';
         return;
     }
 
-    const int count = tracker.count;
-    tracker.count = 0;
-    const std::int64_t ts = tracker.lastEventTs > 0 ? tracker.lastEventTs : nowMs();
-    tracker.lastEventTs = 0;
-    tracker.lastSeenMs = 0;
-    tracker.dueMs = 0;
+    m_discovery.joinedDeviceIds.push_back(deviceExternalId);
+    std::cerr << "hue-ipc discovery found device " << entry.device.name
+              << " (" << m_discovery.joinedDeviceIds.size() << " so far)" << '\n';
+    m_devices.insert(deviceExternalId, std::move(entry));
+}
+
+void HueAdapterInstance::deferDiscoveryPoll(std::int64_t nowMs)
+{
+    // Polls once the joins have been quiet for a moment, and no later than
+    // kDiscoveryPollMaxDelayMs after the first, so a long session still
+    // publishes its devices' services as it goes.
+    if (!m_discovery.pollPending) {
+        m_discovery.pollPending = true;
+        m_discovery.firstPendingMs = nowMs;
+    }
+    m_discovery.pollDueMs =
+        std::min(nowMs + kDiscoveryPollQuietMs, m_discovery.firstPendingMs + kDiscoveryPollMaxDelayMs);
+}
+
+void HueAdapterInstance::finishDiscoverySession(const char *reason)
+{
+    if (!m_discovery.active)
+        return;
+
+    std::cerr << "hue-ipc discovery finished (" << reason << "): "
+              << m_discovery.joinedDeviceIds.size() << " new device(s) in "
+              << (nowMs() - m_discovery.startedMs) << " ms" << '\n';
+    if (m_discovery.pollPending)
+        requestPoll();
+    m_discovery = DiscoverySession{};
+}
+
+void HueAdapterInstance::processPendingButtonAggregates(std::int64_t nowMs)
+{
+    std::vector<std::pair<QString, QString>> due;
+    for (auto deviceIt = m_eventState.cbegin(); deviceIt != m_eventState.cend(); ++deviceIt) {
+        for (auto it = deviceIt->multiPress.cbegin(); it != deviceIt->multiPress.cend(); ++it) {
+            if (it->count > 0 && it->dueMs > 0 && nowMs >= it->dueMs)
+                due.emplace_back(deviceIt.key(), it.key());
+        }
+    }
+    for (const auto &[deviceExternalId, channelExternalId] : due)
+        finalizePendingShortPress(deviceExternalId, channelExternalId);
+}
+
+void HueAdapterInstance::finalizePendingShortPress(const QString &deviceExternalId,
+                                                   const QString &channelExternalId)
+{
+    auto stateIt = m_eventState.find(deviceExternalId);
+    if (stateIt == m_eventState.end())
+        return;
+    auto it = stateIt->multiPress.find(channelExternalId);
+    if (it == stateIt->multiPress.end())
+        return;
 
-    if (tracker.deviceExternalId.isEmpty() || tracker.channelExternalId.isEmpty())
+    const ButtonMultiPressTracker tracker = it.value();
+    stateIt->multiPress.erase(it);
+    if (tracker.count <= 0 || deviceExternalId.isEmpty() || channelExternalId.isEmpty())
         return;
 
+    const int count = tracker.count;
+    const std::int64_t ts = tracker.lastEventTs > 0 ? tracker.lastEventTs : nowMs();
+
     v1::ButtonEventCode code = v1::ButtonEventCode::None;
     if (count == 1) {
         code = v1::ButtonEventCode::ShortPressRelease;
@@ -1095,32 +1576,57 @@ void HueAdapterInstance::finalizePendingShortPress(const QString &bindingKey)
         code = v1::ButtonEventCode::QuintuplePress;
     }
 
-    v1::Utf8String sendError;
-    sendChannelStateUpdated(tracker.deviceExternalId.toStdString(),
-                            tracker.channelExternalId.toStdString(),
-                            static_cast<std::int64_t>(code),
-                            ts,
-                            &sendError);
+    queueChannelState(deviceExternalId,
+                      channelExternalId.toStdString(),
+                      static_cast<std::int64_t>(code),
+                      ts,
+                      DeltaPriority::Interactive);
 }
 
 void HueAdapterInstance::processPendingDialResets(std::int64_t nowMs)
 {
-    QStringList dueDevices;
-    for (auto it = m_dialResetDueMs.cbegin(); it != m_dialResetDueMs.cend(); ++it) {
-        if (nowMs >= it.value())
-            dueDevices.push_back(it.key());
+    for (auto it = m_eventState.begin(); it != m_eventState.end(); ++it) {
+        DeviceEventState &state = it.value();
+        if (state.dialResetDueMs <= 0 || nowMs < state.dialResetDueMs)
+            continue;
+        state.dialResetDueMs = 0;
+        if (state.lastDialValue == 0)
+            continue;
+        queueChannelState(it.key(), "dial", static_cast<std::int64_t>(0), nowMs, DeltaPriority::Interactive);
+        state.lastDialValue = 0;
     }
+}
 
-    for (const QString &deviceExternalId : dueDevices) {
-        if (m_lastDialValueByDevice.value(deviceExternalId, 0) == 0) {
-            m_dialResetDueMs.remove(deviceExternalId);
-            continue;
+HueAdapterInstance::DeviceEventState &HueAdapterInstance::eventStateFor(const QString &deviceExternalId,
+                                                                        std::int64_t nowMs)
+{
+    auto it = m_eventState.find(deviceExternalId);
+    if (it == m_eventState.end()) {
+        if (m_eventState.size() >= kMaxEventStateDevices) {
+            // Evict the device whose buttons or dial were used least recently.
+            auto oldest = m_eventState.begin();
+            for (auto candidate = m_eventState.begin(); candidate != m_eventState.end(); ++candidate) {
+                if (candidate->lastSeenMs < oldest->lastSeenMs)
+                    oldest = candidate;
+            }
+            const QString evicted = oldest.key();
+            dropEventState(evicted);
+            ++m_eventStateEvictions;
         }
-        v1::Utf8String sendError;
-        sendChannelStateUpdated(deviceExternalId.toStdString(), "dial", static_cast<std::int64_t>(0), nowMs, &sendError);
-        m_lastDialValueByDevice.insert(deviceExternalId, 0);
-        m_dialResetDueMs.remove(deviceExternalId);
+        it = m_eventState.insert(deviceExternalId, DeviceEventState{});
     }
+    it->lastSeenMs = nowMs;
+    return it.value();
+}
+
+void HueAdapterInstance::dropEventState(const QString &deviceExternalId)
+{
+    auto it = m_eventState.find(deviceExternalId);
+    if (it == m_eventState.end())
+        return;
+    for (const QString &resourceId : std::as_const(it->learnedButtonResources))
+        m_buttonResourceToChannel.remove(resourceId);
+    m_eventState.erase(it);
 }
 
 void HueAdapterInstance::rebuildButtonResourceMap(const QJsonArray &buttonData)
@@ -1161,138 +1667,61 @@ void HueAdapterInstance::rebuildButtonResourceMap(const QJsonArray &buttonData)
     }
 }
 
-bool HueAdapterInstance::pollBridge(QString *error)
+void HueAdapterInstance::handleBridgePoll(const BridgePoll &poll)
 {
-    if (HttpClient::effectiveHost(m_settings).isEmpty()) {
-        if (error)
-            *error = QStringLiteral("Bridge host is empty");
-        return false;
-    }
-    if (m_settings.appKey.trimmed().isEmpty()) {
-        if (error)
-            *error = QStringLiteral("Hue application key missing");
-        return false;
-    }
-
-    QJsonArray deviceData;
-    QJsonArray lightData;
-    QJsonArray motionData;
-    QJsonArray tamperData;
-    QJsonArray temperatureData;
-    QJsonArray lightLevelData;
-    QJsonArray devicePowerData;
-    QJsonArray buttonData;
-    QJsonArray relativeRotaryData;
-    QJsonArray zigbeeConnectivityData;
-    QJsonArray roomData;
-    QJsonArray zoneData;
-    QJsonArray sceneData;
-
-    if (!fetchResourceArray(QStringLiteral("device"), &deviceData, error))
-        return false;
-    if (!fetchResourceArray(QStringLiteral("light"), &lightData, error))
-        return false;
-    if (!fetchResourceArray(QStringLiteral("motion"), &motionData, nullptr))
-        motionData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("tamper"), &tamperData, nullptr))
-        tamperData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("temperature"), &temperatureData, nullptr))
-        temperatureData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("light_level"), &lightLevelData, nullptr))
-        lightLevelData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("device_power"), &devicePowerData, nullptr))
-        devicePowerData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("button"), &buttonData, nullptr))
-        buttonData = QJsonArray{};
-    rebuildButtonResourceMap(buttonData);
-    if (!fetchResourceArray(QStringLiteral("relative_rotary"), &relativeRotaryData, nullptr))
-        relativeRotaryData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("zigbee_connectivity"), &zigbeeConnectivityData, nullptr))
-        zigbeeConnectivityData = QJsonArray{};
-    if (!fetchResourceArray(QStringLiteral("room"), &roomData, error))
-        return false;
-    if (!fetchResourceArray(QStringLiteral("zone"), &zoneData, error))
-        return false;
-    if (!fetchResourceArray(QStringLiteral("scene"), &sceneData, error))
-        return false;
+    if (!m_runtimeConfigured)
+        return;
 
-    QJsonArray discoveryData;
-    QString discoveryError;
-    if (fetchResourceArray(QStringLiteral("zigbee_device_discovery"), &discoveryData, &discoveryError)) {
-        m_discoveryResourceId.clear();
-        for (const QJsonValue &entry : discoveryData) {
-            if (!entry.isObject())
-                continue;
-            const QString id = entry.toObject().value(QStringLiteral("id")).toString().trimmed();
-            if (!id.isEmpty()) {
-                m_discoveryResourceId = id;
-                break;
-            }
+    QString error = poll.error;
+    if (poll.ok && poll.snapshot) {
+        rebuildButtonResourceMap(poll.buttonData);
+        if (publishSnapshot(*poll.snapshot, &error)) {
+            setConnectionState(true);
+            return;
         }
     }
 
-    const Snapshot snapshot = buildSnapshot(deviceData,
-                                            lightData,
-                                            motionData,
-                                            tamperData,
-                                            temperatureData,
-                                            lightLevelData,
-                                            devicePowerData,
-                                            buttonData,
-                                            relativeRotaryData,
-                                            zigbeeConnectivityData,
-                                            roomData,
-                                            zoneData,
-                                            sceneData);
-    if (!publishSnapshot(snapshot, error))
-        return false;
-
-    setConnectionState(true);
-    return true;
+    setConnectionState(false);
+    if (!error.isEmpty()) {
+        std::cerr << "hue-ipc poll failed: " << error.toStdString() << '\n';
+        sendError(phi::LogCategory::Network, error.toStdString());
+    }
 }
 
-bool HueAdapterInstance::fetchResourceArray(const QString &resourceType, QJsonArray *outData, QString *error)
+Task<QString> HueAdapterInstance::resolveLightResource(QString deviceExternalId, CancelToken token)
 {
-    if (!outData)
-        return false;
-
-    const HttpResult result = m_http->get(m_settings,
-                                         QStringLiteral("/clip/v2/resource/%1").arg(resourceType),
-                                         true,
-                                         QByteArrayLiteral("application/json"),
-                                         10000);
-    if (!result.ok) {
-        QString message = extractHueError(result.payload);
-        if (message.isEmpty())
-            message = result.error;
-        if (message.isEmpty())
-            message = QStringLiteral("Failed to fetch Hue resource %1").arg(resourceType);
-        if (error)
-            *error = message;
-        return false;
-    }
-
-    const QJsonDocument doc = QJsonDocument::fromJson(result.payload);
-    if (!doc.isObject()) {
-        if (error)
-            *error = QStringLiteral("Hue %1 response is not a JSON object").arg(resourceType);
-        return false;
-    }
-
-    const QJsonObject root = doc.object();
-    const QJsonValue data = root.value(QStringLiteral("data"));
-    if (!data.isArray()) {
-        if (error)
-            *error = QStringLiteral("Hue %1 response has no data array").arg(resourceType);
-        return false;
+    const HttpResult result = co_await awaitRequest(*m_http,
+                                                    m_settings,
+                                                    QByteArrayLiteral("GET"),
+                                                    QStringLiteral("/clip/v2/resource/light"),
+                                                    {},
+                                                    true,
+                                                    0,
+                                                    token);
+    if (token.cancelled() || !result.ok)
+        co_return QString();
+
+    for (const QJsonValue &entry : resourceData(result.payload)) {
+        const QJsonObject obj = entry.toObject();
+        if (deviceExternalIdFromResource(obj) != deviceExternalId)
+            continue;
+        const QString lightId = obj.value(QStringLiteral("id")).toString().trimmed();
+        if (!lightId.isEmpty()) {
+            // The next shared poll publishes the device itself.
+            m_lightResourceByDevice.insert(deviceExternalId, lightId);
+            requestPoll();
+        }
+        co_return lightId;
     }
-
-    *outData = data.toArray();
-    return true;
+    co_return QString();
 }
 
 bool HueAdapterInstance::publishSnapshot(const Snapshot &snapshot, QString *error)
 {
+    StageTimer timer(Stage::PublishSnapshot);
+    // Queued records refer to the channel slots about to be replaced.
+    flushChannelDeltas();
+    m_deltaQueue.clear();
     v1::Utf8String sendError;
 
     for (auto it = m_devices.cbegin(); it != m_devices.cend(); ++it) {
@@ -1304,27 +1733,62 @@ bool HueAdapterInstance::publishSnapshot(const Snapshot &snapshot, QString *erro
             return false;
         }
         m_lightResourceByDevice.remove(it.key());
+        dropEventState(it.key());
+        m_sensorFilter.removeDevice(it.key());
+        m_history.removeDevice(it.key());
+        m_aggregates.removeDevice(it.key());
+        m_scenePredictor.removeDevice(it.key());
     }
 
     const std::int64_t ts = nowMs();
 
+    QHash<QString, DeviceEntry> nextDevices = snapshot.devices;
     QHash<QString, QString> nextLightByDevice;
-    for (auto it = snapshot.devices.cbegin(); it != snapshot.devices.cend(); ++it) {
+    std::vector<bool> heldBack;
+    for (auto it = nextDevices.begin(); it != nextDevices.end(); ++it) {
         const QString deviceExternalId = it.key();
-        const DeviceEntry &entry = it.value();
+        DeviceEntry &entry = it.value();
+
+        // Sensor readings that stay within their deadband (or arrive inside
+        // the minimum publish interval) keep the last published value.
+        heldBack.assign(entry.channels.size(), false);
+        for (std::size_t i = 0; i < entry.channels.size(); ++i) {
+            ChannelSlot &channel = entry.channels[i];
+            if (!channel.hasValue)
+                continue;
+            const std::optional<SensorKind> kind = sensorKindForChannel(channel.externalId());
+            if (!kind.has_value())
+                continue;
+            const std::optional<double> value = scalarAsDouble(channel.value);
+            if (!value.has_value() || m_sensorFilter.offer(deviceExternalId, *kind, *value, ts))
+                continue;
+            const std::optional<double> published = m_sensorFilter.publishedValue(deviceExternalId, *kind);
+            if (published.has_value())
+                channel.value = sensorScalarValue(*kind, *published);
+            heldBack[i] = true;
+        }
 
-        if (!sendDeviceUpdated(entry.device, entry.channels, &sendError)) {
+        // The device itself only goes out when it is new or its fields,
+        // product or channel set changed; values follow as channel updates.
+        const auto previous = m_devices.constFind(deviceExternalId);
+        if ((previous == m_devices.cend() || !sameDeviceShape(previous.value(), entry))
+            && !sendDeviceUpdated(materializeDevice(entry), materializeChannels(entry.channels), &sendError)) {
             if (error)
                 *error = QString::fromStdString(sendError);
             return false;
         }
 
-        for (const v1::Channel &channel : entry.channels) {
-            if (!channel.hasValue)
+        for (std::size_t i = 0; i < entry.channels.size(); ++i) {
+            const ChannelSlot &channel = entry.channels[i];
+            if (!channel.hasValue || heldBack[i])
                 continue;
+            if (SensorHistory::recordsChannel(channel.externalId())) {
+                if (const std::optional<double> value = scalarAsDouble(channel.value))
+                    m_history.record(deviceExternalId, channel.externalId(), ts, *value);
+            }
             if (!sendChannelStateUpdated(entry.device.externalId,
-                                         channel.externalId,
-                                         channel.lastValue,
+                                         channel.externalId(),
+                                         channel.value,
                                          ts,
                                          &sendError)) {
                 if (error)
@@ -1337,19 +1801,30 @@ bool HueAdapterInstance::publishSnapshot(const Snapshot &snapshot, QString *erro
             nextLightByDevice.insert(deviceExternalId, entry.state.lightResourceId);
     }
 
-    QSet<QString> nextRooms;
-    for (const v1::Room &room : snapshot.rooms) {
-        const QString roomId = QString::fromStdString(room.externalId);
+    // Only groups whose member lists differ are touched. Room and zone
+    // payloads take their members from the index.
+    m_aggregates.refreshGroups(m_membership.sync(snapshot.memberships));
+
+    QHash<QString, std::size_t> nextRooms;
+    for (const v1::Room &snapshotRoom : snapshot.rooms) {
+        const QString roomId = QString::fromStdString(snapshotRoom.externalId);
         if (roomId.isEmpty())
             continue;
-        nextRooms.insert(roomId);
+        const QStringList members = m_membership.members(roomId);
+        const std::size_t fingerprint = topologyFingerprint(snapshotRoom.name, snapshotRoom.metaJson, members);
+        nextRooms.insert(roomId, fingerprint);
+        if (m_knownRooms.value(roomId, ~fingerprint) == fingerprint)
+            continue;
+        v1::Room room = snapshotRoom;
+        room.deviceExternalIds = toStdStrings(members);
         if (!sendRoomUpdated(room, &sendError)) {
             if (error)
                 *error = QString::fromStdString(sendError);
             return false;
         }
     }
-    for (const QString &oldRoom : std::as_const(m_knownRooms)) {
+    for (auto known = m_knownRooms.cbegin(); known != m_knownRooms.cend(); ++known) {
+        const QString &oldRoom = known.key();
         if (nextRooms.contains(oldRoom))
             continue;
         if (!sendRoomRemoved(oldRoom.toStdString(), &sendError)) {
@@ -1359,19 +1834,26 @@ bool HueAdapterInstance::publishSnapshot(const Snapshot &snapshot, QString *erro
         }
     }
 
-    QSet<QString> nextGroups;
-    for (const v1::Group &group : snapshot.groups) {
-        const QString groupId = QString::fromStdString(group.externalId);
+    QHash<QString, std::size_t> nextGroups;
+    for (const v1::Group &snapshotGroup : snapshot.groups) {
+        const QString groupId = QString::fromStdString(snapshotGroup.externalId);
         if (groupId.isEmpty())
             continue;
-        nextGroups.insert(groupId);
+        const QStringList members = m_membership.members(groupId);
+        const std::size_t fingerprint = topologyFingerprint(snapshotGroup.name, snapshotGroup.metaJson, members);
+        nextGroups.insert(groupId, fingerprint);
+        if (m_knownGroups.value(groupId, ~fingerprint) == fingerprint)
+            continue;
+        v1::Group group = snapshotGroup;
+        group.deviceExternalIds = toStdStrings(members);
         if (!sendGroupUpdated(group, &sendError)) {
             if (error)
                 *error = QString::fromStdString(sendError);
             return false;
         }
     }
-    for (const QString &oldGroup : std::as_const(m_knownGroups)) {
+    for (auto known = m_knownGroups.cbegin(); known != m_knownGroups.cend(); ++known) {
+        const QString &oldGroup = known.key();
         if (nextGroups.contains(oldGroup))
             continue;
         if (!sendGroupRemoved(oldGroup.toStdString(), &sendError)) {
@@ -1381,19 +1863,23 @@ bool HueAdapterInstance::publishSnapshot(const Snapshot &snapshot, QString *erro
         }
     }
 
-    QSet<QString> nextScenes;
+    QHash<QString, std::size_t> nextScenes;
     for (const v1::Scene &scene : snapshot.scenes) {
         const QString sceneId = QString::fromStdString(scene.externalId);
         if (sceneId.isEmpty())
             continue;
-        nextScenes.insert(sceneId);
+        const std::size_t fingerprint = topologyFingerprint(scene.name, scene.metaJson, {});
+        nextScenes.insert(sceneId, fingerprint);
+        if (m_knownScenes.value(sceneId, ~fingerprint) == fingerprint)
+            continue;
         if (!sendSceneUpdated(scene, &sendError)) {
             if (error)
                 *error = QString::fromStdString(sendError);
             return false;
         }
     }
-    for (const QString &oldScene : std::as_const(m_knownScenes)) {
+    for (auto known = m_knownScenes.cbegin(); known != m_knownScenes.cend(); ++known) {
+        const QString &oldScene = known.key();
         if (nextScenes.contains(oldScene))
             continue;
         if (!sendSceneRemoved(oldScene.toStdString(), &sendError)) {
@@ -1403,14 +1889,380 @@ bool HueAdapterInstance::publishSnapshot(const Snapshot &snapshot, QString *erro
         }
     }
 
-    m_devices = snapshot.devices;
+    if (!publishGroupAggregates(snapshot, nextDevices, ts, error))
+        return false;
+
+    m_devices = std::move(nextDevices);
     m_lightResourceByDevice = nextLightByDevice;
+    m_serviceOwners = snapshot.serviceOwners;
+    m_groupedLightByGroup = snapshot.groupedLights;
+    m_scenePredictor.setScenes(snapshot.sceneTargets);
+
+    // Event state of devices that never made it into a snapshot.
+    QStringList orphanedEventState;
+    for (auto it = m_eventState.cbegin(); it != m_eventState.cend(); ++it) {
+        if (!m_devices.contains(it.key()))
+            orphanedEventState.push_back(it.key());
+    }
+    for (const QString &deviceExternalId : std::as_const(orphanedEventState))
+        dropEventState(deviceExternalId);
     m_knownRooms = nextRooms;
     m_knownGroups = nextGroups;
     m_knownScenes = nextScenes;
     return true;
 }
 
+bool HueAdapterInstance::publishGroupAggregates(const Snapshot &snapshot,
+                                                const QHash<QString, DeviceEntry> &devices,
+                                                std::int64_t ts,
+                                                QString *error)
+{
+    v1::Utf8String sendError;
+
+    QHash<QString, QString> groupNames;
+    QHash<QString, QString> groupTypes;
+    if (m_roomAggregatesEnabled) {
+        auto collect = [&](const std::string &externalId, const std::string &name, const QString &groupType) {
+            const QString groupId = QString::fromStdString(externalId);
+            if (groupId.isEmpty())
+                return;
+            groupNames.insert(groupId, QString::fromStdString(name));
+            groupTypes.insert(groupId, groupType);
+        };
+        for (const v1::Room &room : snapshot.rooms)
+            collect(room.externalId, room.name, QStringLiteral("room"));
+        for (const v1::Group &group : snapshot.groups)
+            collect(group.externalId, group.name, QStringLiteral("zone"));
+    }
+
+    // The snapshot replaces each device's contribution, so a channel that
+    // was filtered out or vanished stops counting.
+    std::vector<std::pair<std::string_view, double>> channelValues;
+    for (auto it = devices.cbegin(); it != devices.cend(); ++it) {
+        channelValues.clear();
+        for (const ChannelSlot &channel : it->channels) {
+            if (!channel.hasValue)
+                continue;
+            const std::string &channelId = channel.externalId();
+            if (!m_aggregates.tracksChannel(channelId))
+                continue;
+            if (const std::optional<double> value = scalarAsDouble(channel.value))
+                channelValues.emplace_back(channelId, *value);
+        }
+        m_aggregates.replaceDevice(it.key(), channelValues);
+    }
+
+    for (auto it = groupNames.cbegin(); it != groupNames.cend(); ++it) {
+        const QString &groupId = it.key();
+        const AggregateValues values = m_aggregates.values(groupId);
+
+        QJsonObject meta;
+        meta.insert(QStringLiteral("aggregateOf"), groupId);
+        meta.insert(QStringLiteral("groupType"), groupTypes.value(groupId));
+        const QString groupedLight = snapshot.groupedLights.value(groupId);
+        if (!groupedLight.isEmpty())
+            meta.insert(QStringLiteral("groupedLight"), groupedLight);
+
+        // Values go out as channel updates; the device itself is only
+        // re-sent when its name, meta or channel set changed.
+        const QByteArray metaJson = QJsonDocument(meta).toJson(QJsonDocument::Compact);
+        const QByteArray descriptor = it.value().toUtf8() + '\n' + metaJson + '\n'
+            + (values.hasLights ? 'L' : '-') + (values.hasMotionSensors ? 'M' : '-');
+        if (m_aggregateDescriptors.value(groupId) != descriptor) {
+            v1::Device device;
+            device.externalId = aggregateDeviceExternalId(groupId).toStdString();
+            device.name = it.value().toStdString();
+            device.deviceClass = v1::DeviceClass::Unknown;
+            device.metaJson = metaJson.toStdString();
+            if (!sendDeviceUpdated(device, aggregateChannels(values, !groupedLight.isEmpty()), &sendError)) {
+                if (error)
+                    *error = QString::fromStdString(sendError);
+                return false;
+            }
+            m_aggregateDescriptors.insert(groupId, descriptor);
+        }
+        publishAggregateValues(groupId, ts);
+    }
+
+    const QList<QString> publishedGroups = m_publishedAggregates.keys();
+    for (const QString &groupId : publishedGroups) {
+        if (groupNames.contains(groupId))
+            continue;
+        m_publishedAggregates.remove(groupId);
+        m_aggregateDescriptors.remove(groupId);
+        if (!sendDeviceRemoved(aggregateDeviceExternalId(groupId).toStdString(), &sendError)) {
+            if (error)
+                *error = QString::fromStdString(sendError);
+            return false;
+        }
+    }
+    return true;
+}
+
+void HueAdapterInstance::publishAggregateValues(const QString &groupExternalId, std::int64_t ts)
+{
+    const AggregateValues values = m_aggregates.values(groupExternalId);
+    const auto previousIt = m_publishedAggregates.constFind(groupExternalId);
+    const bool known = previousIt != m_publishedAggregates.cend();
+    const AggregateValues previous = known ? previousIt.value() : AggregateValues{};
+    if (known && previous == values)
+        return;
+
+    const std::string deviceExternalId = aggregateDeviceExternalId(groupExternalId).toStdString();
+    v1::Utf8String sendError;
+    if (values.hasLights && (!known || previous.anyOn != values.anyOn))
+        sendChannelStateUpdated(deviceExternalId, "any_on", values.anyOn, ts, &sendError);
+    if (values.hasLights && (!known || previous.averageBrightness != values.averageBrightness))
+        sendChannelStateUpdated(deviceExternalId, "avg_bri", values.averageBrightness, ts, &sendError);
+    if (values.hasMotionSensors && (!known || previous.motion != values.motion))
+        sendChannelStateUpdated(deviceExternalId, "motion", values.motion, ts, &sendError);
+    m_publishedAggregates.insert(groupExternalId, values);
+}
+
+void HueAdapterInstance::publishScenePrediction(const QString &sceneExternalId, std::int64_t ts)
+{
+    const std::vector<SceneLightTarget> &targets = m_scenePredictor.targets(sceneExternalId);
+    if (targets.empty())
+        return;
+    m_scenePredictor.noteRecall();
+    for (const SceneLightTarget &target : targets) {
+        const QString deviceExternalId = m_serviceOwners.value(target.lightId);
+        if (!m_devices.contains(deviceExternalId))
+            continue;
+        const bool changed = applyLightState(deviceExternalId, target.state, ts);
+        m_scenePredictor.expect(target.lightId, deviceExternalId, target.state, changed, ts + kScenePredictionWindowMs);
+    }
+    flushChannelDeltas();
+}
+
+bool HueAdapterInstance::applyLightState(const QString &deviceExternalId, const LightState &state, std::int64_t ts)
+{
+    auto deviceIt = m_devices.find(deviceExternalId);
+    if (deviceIt == m_devices.end())
+        return false;
+
+    bool changed = false;
+    for (ChannelSlot &channel : deviceIt->channels) {
+        const std::string &channelId = channel.externalId();
+        v1::ScalarValue value;
+        double numeric = 0.0;
+        if (channelId == "on" && state.on) {
+            value = *state.on;
+            numeric = *state.on ? 1.0 : 0.0;
+        } else if (channelId == "bri" && state.brightness) {
+            value = *state.brightness;
+            numeric = *state.brightness;
+        } else if (channelId == "ct" && state.mirek) {
+            value = static_cast<std::int64_t>(*state.mirek);
+            numeric = *state.mirek;
+        } else {
+            continue;
+        }
+        if (channel.hasValue && channel.value == value)
+            continue;
+
+        channel.hasValue = true;
+        channel.value = value;
+        changed = true;
+        queueChannelState(deviceExternalId, channelId, value, ts, DeltaPriority::Interactive);
+        noteChannelValue(deviceExternalId, channelId, numeric, ts);
+    }
+    return changed;
+}
+
+void HueAdapterInstance::applyMembershipDelta(const QString &groupExternalId,
+                                              const QStringList &deviceExternalIds,
+                                              std::int64_t ts)
+{
+    StageTimer timer(Stage::EventMembership);
+    if (!m_membership.setMembers(groupExternalId, deviceExternalIds))
+        return;
+    m_aggregates.refreshGroups({groupExternalId});
+    if (m_roomAggregatesEnabled && m_publishedAggregates.contains(groupExternalId))
+        publishAggregateValues(groupExternalId, ts);
+}
+
+void HueAdapterInstance::noteChannelValue(const QString &deviceExternalId,
+                                          std::string_view channelExternalId,
+                                          double value,
+                                          std::int64_t ts)
+{
+    if (!m_roomAggregatesEnabled)
+        return;
+    const QStringList groups = m_aggregates.updateDevice(deviceExternalId, channelExternalId, value);
+    for (const QString &groupId : groups) {
+        if (m_publishedAggregates.contains(groupId))
+            publishAggregateValues(groupId, ts);
+    }
+}
+
+void HueAdapterInstance::queueChannelState(const QString &deviceExternalId,
+                                           std::string_view channelExternalId,
+                                           const v1::ScalarValue &value,
+                                           std::int64_t ts,
+                                           DeltaPriority priority)
+{
+    ChannelDelta delta;
+    bool queued = false;
+    const auto deviceIt = m_devices.constFind(deviceExternalId);
+    if (deviceIt != m_devices.cend()) {
+        const ChannelSlots &channels = deviceIt->channels;
+        for (std::size_t i = 0; i < channels.size() && !queued; ++i) {
+            if (channels[i].externalId() != channelExternalId)
+                continue;
+            if (const auto *b = std::get_if<bool>(&value)) {
+                delta.kind = ChannelDelta::Bool;
+                delta.integer = *b ? 1 : 0;
+            } else if (const auto *n = std::get_if<std::int64_t>(&value)) {
+                delta.kind = ChannelDelta::Integer;
+                delta.integer = *n;
+            } else if (const auto *d = std::get_if<double>(&value)) {
+                delta.kind = ChannelDelta::Number;
+                delta.number = *d;
+            } else {
+                break;
+            }
+            delta.channelSlot = static_cast<std::uint16_t>(i);
+            queued = true;
+        }
+    }
+
+    if (!queued) {
+        // Strings and channels outside the device's slots skip the queue.
+        v1::Utf8String sendError;
+        sendChannelStateUpdated(deviceExternalId.toStdString(), std::string(channelExternalId), value, ts, &sendError);
+        return;
+    }
+
+    delta.deviceHandle = m_deltaQueue.handleFor(deviceExternalId);
+    delta.priority = priority;
+    delta.eventTs = ts;
+    delta.enqueuedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (!m_deltaQueue.push(delta)) {
+        // Sender and applier share this thread, so backpressure means
+        // draining right here.
+        flushChannelDeltas();
+        m_deltaQueue.push(delta);
+    }
+}
+
+void HueAdapterInstance::flushChannelDeltas()
+{
+    ChannelDelta delta;
+    v1::Utf8String sendError;
+    while (m_deltaQueue.pop(&delta)) {
+        const QString &deviceExternalId = m_deltaQueue.deviceFor(delta.deviceHandle);
+        const auto deviceIt = m_devices.constFind(deviceExternalId);
+        if (deviceIt == m_devices.cend() || delta.channelSlot >= deviceIt->channels.size())
+            continue;
+        v1::ScalarValue value;
+        if (delta.kind == ChannelDelta::Bool)
+            value = delta.integer != 0;
+        else if (delta.kind == ChannelDelta::Integer)
+            value = delta.integer;
+        else
+            value = delta.number;
+        sendChannelStateUpdated(deviceExternalId.toStdString(),
+                                deviceIt->channels[delta.channelSlot].externalId(),
+                                value,
+                                delta.eventTs,
+                                &sendError);
+        const std::int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                       std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_deltaLatencyUs.record(nowUs - delta.enqueuedUs);
+    }
+}
+
+bool HueAdapterInstance::sendLightCommand(const QString &path, const QByteArray &payload, QString *error)
+{
+    const int windowMs = m_session ? m_session->loadShedder().coalesceMs() : 0;
+    auto pending = m_pendingCommands.find(path);
+    if (windowMs <= 0 && pending == m_pendingCommands.end())
+        return m_http->putJsonAsync(m_settings, path, payload, true, error);
+
+    const QJsonObject fields = QJsonDocument::fromJson(payload).object();
+    if (pending == m_pendingCommands.end()) {
+        m_pendingCommands.insert(path, PendingCommand{fields, nowMs() + windowMs});
+        return true;
+    }
+    // Later commands win per top-level field (on, dimming, color_temperature).
+    for (auto it = fields.constBegin(); it != fields.constEnd(); ++it)
+        pending->payload.insert(it.key(), it.value());
+    if (m_session)
+        m_session->loadShedder().noteCoalescedCommand();
+    return true;
+}
+
+void HueAdapterInstance::flushPendingCommands(std::int64_t nowMs)
+{
+    for (auto it = m_pendingCommands.begin(); it != m_pendingCommands.end();) {
+        if (it->dueMs > nowMs) {
+            ++it;
+            continue;
+        }
+        QString error;
+        if (!m_http
+            || !m_http->putJsonAsync(m_settings,
+                                     it.key(),
+                                     QJsonDocument(it->payload).toJson(QJsonDocument::Compact),
+                                     true,
+                                     &error)) {
+            std::cerr << "hue-ipc coalesced command failed: " << it.key().toStdString() << ' '
+                      << error.toStdString() << '\n';
+        }
+        it = m_pendingCommands.erase(it);
+    }
+}
+
+void HueAdapterInstance::releaseDeferredWork(std::int64_t nowMs)
+{
+    if (!m_session || !m_http || m_session->loadShedder().active())
+        return;
+    LoadShedder &shedder = m_session->loadShedder();
+
+    for (auto it = m_deferredRenames.cbegin(); it != m_deferredRenames.cend(); ++it) {
+        const QString deviceExternalId = it.key();
+        const std::string name = it.value().toStdString();
+        QString error;
+        const QNetworkReply *reply = m_http->requestAsync(
+            m_settings,
+            QByteArrayLiteral("PUT"),
+            QStringLiteral("/clip/v2/resource/device/%1").arg(deviceExternalId),
+            renamePayload(it.value()),
+            true,
+            0,
+            [this, deviceExternalId, name](const HttpResult &result) {
+                if (result.ok) {
+                    applyDeviceName(deviceExternalId, name);
+                    return;
+                }
+                QString resultError = extractHueError(result.payload);
+                if (resultError.isEmpty())
+                    resultError = result.error;
+                std::cerr << "hue-ipc deferred rename failed: " << deviceExternalId.toStdString() << ' '
+                          << resultError.toStdString() << '\n';
+            },
+            m_sessionContext.get(),
+            &error);
+        if (!reply) {
+            std::cerr << "hue-ipc deferred rename failed: " << deviceExternalId.toStdString() << ' '
+                      << error.toStdString() << '\n';
+        }
+        shedder.noteReleased("releaseRename", nowMs);
+    }
+    m_deferredRenames.clear();
+
+    if (m_discoveryDeferred) {
+        m_discoveryDeferred = false;
+        shedder.noteReleased("releaseDiscovery", nowMs);
+        startDeviceDiscovery(0, m_taskToken).start(m_sessionContext.get(), [](ActionResponse response) {
+            if (response.status != CmdStatus::Success)
+                std::cerr << "hue-ipc deferred discovery failed: " << response.error << '\n';
+        });
+    }
+}
+
 void HueAdapterInstance::setConnectionState(bool connected)
 {
     if (m_connected == connected)
@@ -1422,16 +2274,46 @@ void HueAdapterInstance::setConnectionState(bool connected)
     }
 }
 
-phicore::adapter::v1::ActionResponse HueAdapterInstance::invokeStartDeviceDiscovery(const phi::AdapterActionInvokeRequest &request)
+Task<phicore::adapter::v1::ActionResponse> HueAdapterInstance::startDeviceDiscovery(std::uint64_t cmdId,
+                                                                                   CancelToken token)
 {
     ActionResponse response;
-    response.id = request.cmdId;
+    response.id = cmdId;
     response.tsMs = nowMs();
 
     if (m_discoveryResourceId.isEmpty()) {
-        response.status = CmdStatus::Failure;
-        response.error = "Discovery resource not ready yet";
-        return response;
+        const HttpResult result = co_await awaitRequest(*m_http,
+                                                        m_settings,
+                                                        QByteArrayLiteral("GET"),
+                                                        QStringLiteral("/clip/v2/resource/zigbee_device_discovery"),
+                                                        {},
+                                                        true,
+                                                        0,
+                                                        token);
+        if (token.cancelled()) {
+            response.status = CmdStatus::TemporarilyOffline;
+            response.error = "Adapter stopped";
+            co_return response;
+        }
+
+        for (const QJsonValue &entry : resourceData(result.payload)) {
+            const QString id = entry.toObject().value(QStringLiteral("id")).toString().trimmed();
+            if (!id.isEmpty()) {
+                m_discoveryResourceId = id;
+                break;
+            }
+        }
+
+        if (m_discoveryResourceId.isEmpty()) {
+            QString message = result.ok ? QString() : extractHueError(result.payload);
+            if (message.isEmpty() && !result.ok)
+                message = result.error;
+            response.status = CmdStatus::Failure;
+            response.error = message.isEmpty()
+                ? std::string("Hue bridge has no zigbee_device_discovery resource")
+                : message.toStdString();
+            co_return response;
+        }
     }
 
     QJsonObject actionObj;
@@ -1453,12 +2335,273 @@ phicore::adapter::v1::ActionResponse HueAdapterInstance::invokeStartDeviceDiscov
             : sendError;
         response.status = CmdStatus::Failure;
         response.error = message.toStdString();
-        return response;
+        co_return response;
+    }
+
+    if (!m_discovery.active) {
+        m_discovery = DiscoverySession{};
+        m_discovery.active = true;
+        m_discovery.startedMs = response.tsMs;
+        m_discovery.deadlineMs = response.tsMs + kDiscoverySessionTimeoutMs;
     }
 
     response.status = CmdStatus::Success;
     response.resultType = v1::ActionResultType::String;
     response.resultValue = std::string("Hue Zigbee discovery started");
+    co_return response;
+}
+
+phicore::adapter::v1::ActionResponse HueAdapterInstance::invokeQueryHistory(const phi::AdapterActionInvokeRequest &request)
+{
+    ActionResponse response;
+    response.id = request.cmdId;
+    response.tsMs = nowMs();
+
+    const QJsonObject params = parseJsonObject(request.paramsJson);
+    const QString deviceExternalId = params.value(QStringLiteral("deviceExternalId")).toString().trimmed();
+    const QString channelExternalId = params.value(QStringLiteral("channelExternalId")).toString().trimmed();
+    if (deviceExternalId.isEmpty() || !SensorHistory::recordsChannel(channelExternalId.toStdString())) {
+        response.status = CmdStatus::InvalidArgument;
+        response.error = "deviceExternalId and a motion, temperature or illuminance channelExternalId are required";
+        return response;
+    }
+
+    const std::int64_t fromMs = params.value(QStringLiteral("fromMs")).toInteger(0);
+    const std::int64_t toMs = params.value(QStringLiteral("toMs")).toInteger(response.tsMs);
+    const int limit = std::max(1, readInt(params, QStringLiteral("limit"), kHistoryQueryDefaultLimit));
+
+    const std::vector<HistorySample> samples =
+        m_history.query(deviceExternalId, channelExternalId.toStdString(), fromMs, toMs);
+    const std::size_t first = samples.size() > static_cast<std::size_t>(limit)
+        ? samples.size() - static_cast<std::size_t>(limit)
+        : 0;
+
+    // Compact form: base timestamp plus per-sample deltas (first delta is 0).
+    QJsonArray deltas;
+    QJsonArray values;
+    std::int64_t prevTs = first < samples.size() ? samples[first].tsMs : 0;
+    for (std::size_t i = first; i < samples.size(); ++i) {
+        deltas.append(static_cast<qint64>(samples[i].tsMs - prevTs));
+        values.append(samples[i].value);
+        prevTs = samples[i].tsMs;
+    }
+
+    QJsonObject result;
+    result.insert(QStringLiteral("deviceExternalId"), deviceExternalId);
+    result.insert(QStringLiteral("channelExternalId"), channelExternalId);
+    result.insert(QStringLiteral("t0"), static_cast<qint64>(first < samples.size() ? samples[first].tsMs : 0));
+    result.insert(QStringLiteral("dt"), deltas);
+    result.insert(QStringLiteral("v"), values);
+
+    response.status = CmdStatus::Success;
+    response.resultType = v1::ActionResultType::String;
+    response.resultValue = QJsonDocument(result).toJson(QJsonDocument::Compact).toStdString();
+    return response;
+}
+
+QHash<QString, std::size_t> HueAdapterInstance::structureSizes() const
+{
+    QHash<QString, std::size_t> sizes;
+    sizes.insert(QStringLiteral("devices"), static_cast<std::size_t>(m_devices.size()));
+    sizes.insert(QStringLiteral("lightResourceByDevice"), static_cast<std::size_t>(m_lightResourceByDevice.size()));
+    sizes.insert(QStringLiteral("buttonResourceToChannel"), static_cast<std::size_t>(m_buttonResourceToChannel.size()));
+    sizes.insert(QStringLiteral("eventState"), static_cast<std::size_t>(m_eventState.size()));
+    sizes.insert(QStringLiteral("httpInFlight"), m_http ? m_http->inFlightCount() : 0);
+    sizes.insert(QStringLiteral("sensorFilter"), m_sensorFilter.size());
+    sizes.insert(QStringLiteral("history"), m_history.deviceCount());
+    sizes.insert(QStringLiteral("membership"), m_membership.size());
+    sizes.insert(QStringLiteral("aggregates"), static_cast<std::size_t>(m_publishedAggregates.size()));
+    return sizes;
+}
+
+void HueAdapterInstance::sampleStructureSizes(std::int64_t nowMs)
+{
+    if (nowMs < m_nextStructureSampleMs)
+        return;
+    m_nextStructureSampleMs = nowMs + kStructureSampleIntervalMs;
+
+    const QHash<QString, std::size_t> sizes = structureSizes();
+    for (auto it = sizes.cbegin(); it != sizes.cend(); ++it) {
+        std::size_t &highWater = m_structureHighWater[it.key()];
+        highWater = std::max(highWater, it.value());
+    }
+}
+
+QJsonObject HueAdapterInstance::memoryFootprint() const
+{
+    FootprintReport report;
+
+    std::size_t deviceBytes = static_cast<std::size_t>(m_devices.capacity());
+    std::size_t metaJsonBytes = 0;
+    for (auto it = m_devices.cbegin(); it != m_devices.cend(); ++it)
+        deviceBytes += heapBytes(it.key()) + kHashNodeOverheadBytes + deviceEntryBytes(it.value(), &metaJsonBytes);
+    report.add(QStringLiteral("devices"), static_cast<std::size_t>(m_devices.size()), deviceBytes);
+    report.addDetail(QStringLiteral("devices"), QStringLiteral("metaJsonBytes"), metaJsonBytes);
+
+    const std::size_t eventStateBytes = hashBytes(m_eventState);
+
+    report.add(QStringLiteral("lightResourceByDevice"),
+               static_cast<std::size_t>(m_lightResourceByDevice.size()),
+               hashBytes(m_lightResourceByDevice));
+    report.add(QStringLiteral("buttonResourceToChannel"),
+               static_cast<std::size_t>(m_buttonResourceToChannel.size()),
+               hashBytes(m_buttonResourceToChannel));
+    report.add(QStringLiteral("eventState"), static_cast<std::size_t>(m_eventState.size()), eventStateBytes);
+    report.addDetail(QStringLiteral("eventState"), QStringLiteral("evictions"), m_eventStateEvictions);
+    report.add(QStringLiteral("httpInFlight"), m_http ? m_http->inFlightCount() : 0, 0);
+    report.add(QStringLiteral("eventStreamBuffers"), 2, m_session ? m_session->bufferBytes() : 0, true);
+    report.add(QStringLiteral("knownTopology"),
+               static_cast<std::size_t>(m_knownRooms.size() + m_knownGroups.size() + m_knownScenes.size()),
+               hashBytes(m_knownRooms) + hashBytes(m_knownGroups) + hashBytes(m_knownScenes));
+    report.add(QStringLiteral("sensorFilter"), m_sensorFilter.size(), m_sensorFilter.bytes());
+    report.add(QStringLiteral("history"), m_history.deviceCount(), m_history.bytes());
+    report.add(QStringLiteral("membership"),
+               m_membership.size(),
+               m_membership.bytes() + hashBytes(m_serviceOwners) + hashBytes(m_groupedLightByGroup));
+    report.add(QStringLiteral("scenePredictions"), m_scenePredictor.size(), m_scenePredictor.bytes());
+    report.add(QStringLiteral("deltaQueue"), m_deltaQueue.handleCount(), m_deltaQueue.bytes());
+    report.add(QStringLiteral("aggregates"),
+               static_cast<std::size_t>(m_publishedAggregates.size()),
+               hashBytes(m_publishedAggregates) + hashBytes(m_aggregateDescriptors));
+
+    const ModelPoolStats pools = modelPoolStats();
+    report.add(QStringLiteral("channelDescriptorPool"), pools.channelDescriptors, pools.channelDescriptorBytes, true);
+    report.add(QStringLiteral("productPool"), pools.productRecords, pools.productRecordBytes, true);
+    report.applyHighWater(m_structureHighWater);
+
+    QJsonObject latency;
+    latency.insert(QStringLiteral("count"), static_cast<qint64>(m_eventLatencyUs.count()));
+    latency.insert(QStringLiteral("p50"), static_cast<qint64>(m_eventLatencyUs.quantile(0.5)));
+    latency.insert(QStringLiteral("p99"), static_cast<qint64>(m_eventLatencyUs.quantile(0.99)));
+    latency.insert(QStringLiteral("max"), static_cast<qint64>(m_eventLatencyUs.max()));
+
+    QJsonObject result = report.toJson();
+    result.insert(QStringLiteral("eventLatencyUs"), latency);
+
+    const ScenePredictor::Stats &predictions = m_scenePredictor.stats();
+    QJsonObject scenePrediction;
+    scenePrediction.insert(QStringLiteral("recalls"), static_cast<qint64>(predictions.recalls));
+    scenePrediction.insert(QStringLiteral("predicted"), static_cast<qint64>(predictions.predicted));
+    scenePrediction.insert(QStringLiteral("confirmed"), static_cast<qint64>(predictions.confirmed));
+    scenePrediction.insert(QStringLiteral("corrected"), static_cast<qint64>(predictions.corrected));
+    scenePrediction.insert(QStringLiteral("expired"), static_cast<qint64>(predictions.expired));
+    result.insert(QStringLiteral("scenePrediction"), scenePrediction);
+
+    QJsonObject deltaQueue;
+    for (const DeltaPriority priority : {DeltaPriority::Interactive, DeltaPriority::Telemetry}) {
+        const ChannelDeltaQueue::Stats &stats = m_deltaQueue.stats(priority);
+        QJsonObject item;
+        item.insert(QStringLiteral("depth"), static_cast<qint64>(m_deltaQueue.size(priority)));
+        item.insert(QStringLiteral("highWater"), static_cast<qint64>(stats.highWater));
+        item.insert(QStringLiteral("pushed"), static_cast<qint64>(stats.pushed));
+        item.insert(QStringLiteral("delivered"), static_cast<qint64>(stats.delivered));
+        item.insert(QStringLiteral("backpressured"), static_cast<qint64>(stats.backpressured));
+        deltaQueue.insert(priority == DeltaPriority::Interactive ? QStringLiteral("interactive")
+                                                                 : QStringLiteral("telemetry"),
+                          item);
+    }
+    QJsonObject deltaLatency;
+    deltaLatency.insert(QStringLiteral("p50"), static_cast<qint64>(m_deltaLatencyUs.quantile(0.5)));
+    deltaLatency.insert(QStringLiteral("p99"), static_cast<qint64>(m_deltaLatencyUs.quantile(0.99)));
+    deltaLatency.insert(QStringLiteral("max"), static_cast<qint64>(m_deltaLatencyUs.max()));
+    deltaQueue.insert(QStringLiteral("latencyUs"), deltaLatency);
+    result.insert(QStringLiteral("deltaQueue"), deltaQueue);
+
+    QJsonObject stageTiming;
+    stageTiming.insert(QStringLiteral("enabled"), stageTimingEnabled());
+    const std::array<StageTotals, kStageCount> totals = stageTotals();
+    QJsonObject stages;
+    for (std::size_t i = 0; i < kStageCount; ++i) {
+        const StageTotals &entry = totals[i];
+        if (entry.count == 0)
+            continue;
+        QJsonObject item;
+        item.insert(QStringLiteral("count"), static_cast<qint64>(entry.count));
+        item.insert(QStringLiteral("totalUs"), static_cast<qint64>(entry.totalNs / 1000));
+        item.insert(QStringLiteral("avgUs"), static_cast<qint64>(entry.totalNs / entry.count / 1000));
+        item.insert(QStringLiteral("maxUs"), static_cast<qint64>(entry.maxNs / 1000));
+        stages.insert(QString::fromLatin1(stageName(static_cast<Stage>(i))), item);
+    }
+    stageTiming.insert(QStringLiteral("stages"), stages);
+    result.insert(QStringLiteral("stageTiming"), stageTiming);
+
+    if (m_http) {
+        QJsonArray endpoints;
+        for (const EndpointLatency &endpoint : m_http->endpointLatency()) {
+            QJsonObject item;
+            item.insert(QStringLiteral("endpoint"), endpoint.endpoint);
+            item.insert(QStringLiteral("samples"), static_cast<qint64>(endpoint.samples));
+            item.insert(QStringLiteral("ewmaMs"), endpoint.ewmaMs);
+            item.insert(QStringLiteral("baselineMs"), endpoint.baselineMs);
+            item.insert(QStringLiteral("p99Ms"), static_cast<qint64>(endpoint.p99Ms));
+            item.insert(QStringLiteral("timeoutMs"), endpoint.timeoutMs);
+            endpoints.append(item);
+        }
+        result.insert(QStringLiteral("httpEndpoints"), endpoints);
+
+        const TransportStats stats = m_http->transportStats();
+        QJsonObject transport;
+        transport.insert(QStringLiteral("http2Allowed"), stats.http2Allowed);
+        transport.insert(QStringLiteral("http2FellBack"), stats.http2FellBack);
+        transport.insert(QStringLiteral("http2Replies"), static_cast<qint64>(stats.http2Replies));
+        transport.insert(QStringLiteral("http1Replies"), static_cast<qint64>(stats.http1Replies));
+        transport.insert(QStringLiteral("maxConcurrentStreams"), static_cast<qint64>(stats.maxConcurrentStreams));
+        transport.insert(QStringLiteral("eventStreamShared"), m_session && m_session->eventStreamShared());
+        transport.insert(QStringLiteral("sessionSubscribers"),
+                         static_cast<qint64>(m_session ? m_session->subscriberCount() : 0));
+        transport.insert(QStringLiteral("peakResponseElementBytes"),
+                         static_cast<qint64>(m_session ? m_session->peakResponseElementBytes() : 0));
+        transport.insert(QStringLiteral("optionalFetchFailures"),
+                         static_cast<qint64>(m_session ? m_session->optionalFetchFailures() : 0));
+        result.insert(QStringLiteral("transport"), transport);
+    }
+
+    if (m_session) {
+        const LoadShedder &shedder = m_session->loadShedder();
+        const LoadShedder::Stats &stats = shedder.stats();
+        const std::int64_t now = nowMs();
+        QJsonObject shedding;
+        shedding.insert(QStringLiteral("enabled"), shedder.policy().enabled);
+        shedding.insert(QStringLiteral("active"), shedder.active());
+        shedding.insert(QStringLiteral("loadRatio"), shedder.ratio());
+        shedding.insert(QStringLiteral("samples"), static_cast<qint64>(shedder.samples()));
+        shedding.insert(QStringLiteral("activeSinceMs"), static_cast<qint64>(shedder.activeSinceMs()));
+        shedding.insert(QStringLiteral("pollIntervalMs"), m_session->effectivePollIntervalMs());
+        shedding.insert(QStringLiteral("coalesceMs"), shedder.coalesceMs());
+        shedding.insert(QStringLiteral("activations"), static_cast<qint64>(stats.activations));
+        shedding.insert(QStringLiteral("recoveries"), static_cast<qint64>(stats.recoveries));
+        shedding.insert(QStringLiteral("shedMs"), static_cast<qint64>(shedder.shedMs(now)));
+        shedding.insert(QStringLiteral("stretchedPolls"), static_cast<qint64>(stats.stretchedPolls));
+        shedding.insert(QStringLiteral("throttledPollRequests"), static_cast<qint64>(stats.throttledPollRequests));
+        shedding.insert(QStringLiteral("coalescedCommands"), static_cast<qint64>(stats.coalescedCommands));
+        shedding.insert(QStringLiteral("deferredRenames"), static_cast<qint64>(stats.deferredRenames));
+        shedding.insert(QStringLiteral("deferredDiscoveries"), static_cast<qint64>(stats.deferredDiscoveries));
+        shedding.insert(QStringLiteral("pendingCommands"), static_cast<qint64>(m_pendingCommands.size()));
+        shedding.insert(QStringLiteral("pendingRenames"), static_cast<qint64>(m_deferredRenames.size()));
+        shedding.insert(QStringLiteral("discoveryDeferred"), m_discoveryDeferred);
+        QJsonArray decisions;
+        for (const LoadShedder::Decision &decision : shedder.decisions()) {
+            QJsonObject item;
+            item.insert(QStringLiteral("tsMs"), static_cast<qint64>(decision.tsMs));
+            item.insert(QStringLiteral("action"), QString::fromLatin1(decision.action));
+            item.insert(QStringLiteral("loadRatio"), decision.ratio);
+            decisions.append(item);
+        }
+        shedding.insert(QStringLiteral("decisions"), decisions);
+        result.insert(QStringLiteral("loadShedding"), shedding);
+    }
+    return result;
+}
+
+phicore::adapter::v1::ActionResponse HueAdapterInstance::invokeMemoryFootprint(
+    const phi::AdapterActionInvokeRequest &request)
+{
+    ActionResponse response;
+    response.id = request.cmdId;
+    response.tsMs = nowMs();
+    response.status = CmdStatus::Success;
+    response.resultType = v1::ActionResultType::String;
+    response.resultValue = QJsonDocument(memoryFootprint()).toJson(QJsonDocument::Compact).toStdString();
     return response;
 }
 
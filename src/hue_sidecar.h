@@ -2,26 +2,47 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include <QByteArray>
 #include <QHash>
+#include <QJsonArray>
 #include <QJsonObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QObject>
 #include <QSet>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
 
+#include "hue_aggregates.h"
+#include "hue_bridge_session.h"
+#include "hue_delta_queue.h"
+#include "hue_footprint.h"
+#include "hue_history.h"
 #include "hue_http.h"
+#include "hue_latency.h"
+#include "hue_membership.h"
 #include "hue_model.h"
+#include "hue_scene_prediction.h"
+#include "hue_sensor_filter.h"
+#include "hue_task.h"
 #include "phi/adapter/sdk/sidecar.h"
 
 namespace phicore::hue::ipc {
 
+#ifdef PHI_ADAPTER_HUE_TESTING
+namespace testing {
+class InstanceDriver;
+}
+#endif
+
 class HueAdapterInstance final : public phicore::adapter::sdk::AdapterInstance
 {
 public:
     HueAdapterInstance();
+    ~HueAdapterInstance() override;
 
 protected:
     bool start() override;
@@ -37,6 +58,10 @@ protected:
     void onSceneInvoke(const phicore::adapter::sdk::SceneInvokeRequest &request) override;
 
 private:
+#ifdef PHI_ADAPTER_HUE_TESTING
+    friend class testing::InstanceDriver;
+#endif
+
     using CmdResponse = phicore::adapter::v1::CmdResponse;
     using ActionResponse = phicore::adapter::v1::ActionResponse;
     using CmdStatus = phicore::adapter::v1::CmdStatus;
@@ -47,20 +72,52 @@ private:
     void applyRuntimeConfig(const phicore::adapter::sdk::ConfigChangedRequest &request);
     void readIntervalsFromMeta();
 
-    bool pollBridge(QString *error = nullptr);
-    bool fetchResourceArray(const QString &resourceType, QJsonArray *outData, QString *error = nullptr);
+    void attachSession();
+    void configureSession();
+    void detachSession();
+    void requestPoll();
+    void handleBridgePoll(const BridgePoll &poll);
+    Task<QString> resolveLightResource(QString deviceExternalId, CancelToken token);
     bool publishSnapshot(const Snapshot &snapshot, QString *error = nullptr);
+    bool publishGroupAggregates(const Snapshot &snapshot,
+                                const QHash<QString, DeviceEntry> &devices,
+                                std::int64_t ts,
+                                QString *error = nullptr);
+    void publishAggregateValues(const QString &groupExternalId, std::int64_t ts);
+    void publishScenePrediction(const QString &sceneExternalId, std::int64_t ts);
+    bool applyLightState(const QString &deviceExternalId, const LightState &state, std::int64_t ts);
+    void applyMembershipDelta(const QString &groupExternalId, const QStringList &deviceExternalIds, std::int64_t ts);
+    void noteChannelValue(const QString &deviceExternalId,
+                          std::string_view channelExternalId,
+                          double value,
+                          std::int64_t ts);
+    void queueChannelState(const QString &deviceExternalId,
+                           std::string_view channelExternalId,
+                           const phicore::adapter::v1::ScalarValue &value,
+                           std::int64_t ts,
+                           DeltaPriority priority);
+    void flushChannelDeltas();
+    bool sendLightCommand(const QString &path, const QByteArray &payload, QString *error);
+    void flushPendingCommands(std::int64_t nowMs);
+    void releaseDeferredWork(std::int64_t nowMs);
     void setConnectionState(bool connected);
-    void startEventStream();
-    void stopEventStream();
-    void pumpEventStream(std::int64_t nowMs);
-    void processEventStreamPayload(const QByteArray &jsonData, std::int64_t nowMs);
+    void processEventStreamEvents(const QJsonArray &events, std::int64_t nowMs);
     void processEventStreamEventObject(const QJsonObject &eventObj, std::int64_t nowMs);
     void handleRelativeRotaryEvent(const QJsonObject &resourceObj, std::int64_t nowMs);
     void handleButtonEvent(const QJsonObject &resourceObj, std::int64_t nowMs);
+    bool handleSensorEvent(SensorKind kind, const QJsonObject &resourceObj, std::int64_t nowMs);
+    void publishSensorValue(const QString &deviceExternalId, SensorKind kind, double value, std::int64_t ts);
+    void sendSensorState(const QString &deviceExternalId, SensorKind kind, double value, std::int64_t ts);
+    void flushDeferredSensorValues(std::int64_t nowMs);
+    void handleDiscoveryEvent(const QJsonObject &resourceObj, std::int64_t nowMs);
+    void handleDiscoveredDevice(const QJsonObject &resourceObj);
+    void deferDiscoveryPoll(std::int64_t nowMs);
+    void finishDiscoverySession(const char *reason);
     void processPendingButtonAggregates(std::int64_t nowMs);
-    void finalizePendingShortPress(const QString &bindingKey);
+    void finalizePendingShortPress(const QString &deviceExternalId, const QString &channelExternalId);
     void processPendingDialResets(std::int64_t nowMs);
+    DeviceEventState &eventStateFor(const QString &deviceExternalId, std::int64_t nowMs);
+    void dropEventState(const QString &deviceExternalId);
     QString deviceExternalIdFromResource(const QJsonObject &resourceObj) const;
     QString resolveButtonChannel(const QString &deviceExternalId,
                                  const QString &buttonResourceId,
@@ -68,11 +125,19 @@ private:
     void rebuildButtonResourceMap(const QJsonArray &buttonData);
 
     CmdResponse handleChannelInvoke(const phicore::adapter::sdk::ChannelInvokeRequest &request);
+    CmdResponse handleGroupedLightInvoke(const phicore::adapter::sdk::ChannelInvokeRequest &request,
+                                         const QString &groupExternalId);
     ActionResponse handleAdapterActionInvoke(const phicore::adapter::sdk::AdapterActionInvokeRequest &request);
-    CmdResponse handleDeviceNameUpdate(const phicore::adapter::sdk::DeviceNameUpdateRequest &request);
+    Task<CmdResponse> handleDeviceNameUpdate(phicore::adapter::sdk::DeviceNameUpdateRequest request, CancelToken token);
+    void applyDeviceName(const QString &deviceExternalId, const std::string &name);
     CmdResponse handleDeviceEffectInvoke(const phicore::adapter::sdk::DeviceEffectInvokeRequest &request);
-    CmdResponse handleSceneInvoke(const phicore::adapter::sdk::SceneInvokeRequest &request);
-    ActionResponse invokeStartDeviceDiscovery(const phicore::adapter::sdk::AdapterActionInvokeRequest &request);
+    Task<CmdResponse> handleSceneInvoke(phicore::adapter::sdk::SceneInvokeRequest request, CancelToken token);
+    Task<ActionResponse> startDeviceDiscovery(std::uint64_t cmdId, CancelToken token);
+    ActionResponse invokeQueryHistory(const phicore::adapter::sdk::AdapterActionInvokeRequest &request);
+    ActionResponse invokeMemoryFootprint(const phicore::adapter::sdk::AdapterActionInvokeRequest &request);
+    QJsonObject memoryFootprint() const;
+    QHash<QString, std::size_t> structureSizes() const;
+    void sampleStructureSizes(std::int64_t nowMs);
 
     void submitCmdResult(CmdResponse response, const char *context);
     void submitActionResult(ActionResponse response, const char *context);
@@ -80,49 +145,174 @@ private:
     CmdResponse failureResponse(std::uint64_t cmdId, CmdStatus status, const QString &error) const;
     CmdResponse successResponse(std::uint64_t cmdId) const;
 
-    std::unique_ptr<QNetworkAccessManager> m_requestNetwork;
-    std::unique_ptr<QNetworkAccessManager> m_eventStreamNetwork;
-    std::unique_ptr<HttpClient> m_http;
+#ifdef PHI_ADAPTER_HUE_TESTING
+    // Without a host (soak test, PGO training) outbound messages are counted
+    // and dropped instead of failing, so the instance builds up the same
+    // state it would with a host attached. These hide the SDK senders and
+    // exist only in phi_adapter_hue_core_testing.
+    bool dropHostless()
+    {
+        if (!m_hostless)
+            return false;
+        ++m_hostlessMessages;
+        return true;
+    }
+    template <typename... Args>
+    bool sendDeviceUpdated(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendDeviceUpdated(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendDeviceRemoved(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendDeviceRemoved(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendChannelStateUpdated(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendChannelStateUpdated(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendRoomUpdated(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendRoomUpdated(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendRoomRemoved(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendRoomRemoved(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendGroupUpdated(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendGroupUpdated(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendGroupRemoved(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendGroupRemoved(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendSceneUpdated(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendSceneUpdated(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendSceneRemoved(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendSceneRemoved(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendConnectionStateChanged(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendConnectionStateChanged(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool sendResult(Args &&...args)
+    {
+        return dropHostless() || AdapterInstance::sendResult(std::forward<Args>(args)...);
+    }
+#endif
+
+    std::shared_ptr<BridgeSession> m_session;
+    std::unique_ptr<QObject> m_sessionContext;
+    std::uint64_t m_subscriptionId = 0;
+    HttpClient *m_http = nullptr;
+    CancelToken m_taskToken;
+    // Requests whose result waits on a task; failed when the session goes.
+    QSet<std::uint64_t> m_taskCmdIds;
+    QSet<std::uint64_t> m_taskActionIds;
 
     phicore::adapter::v1::Adapter m_adapterInfo;
     ConnectionSettings m_settings;
     QJsonObject m_meta;
+    SyncFilter m_syncFilter;
+    SensorDeadbandFilter m_sensorFilter;
+    SensorHistory m_history;
 
     bool m_connected = false;
     bool m_runtimeConfigured = false;
-    bool m_eventStreamActive = false;
 
+    bool m_roomAggregatesEnabled = true;
+    bool m_stageTimingHeld = false;
     int m_pollIntervalMs = 5000;
     int m_retryIntervalMs = 10000;
-    std::int64_t m_nextPollDueMs = 0;
-    std::int64_t m_nextEventStreamRetryDueMs = 0;
-    int m_eventStreamRetryCount = 0;
-    QNetworkReply *m_eventStreamReply = nullptr;
-    QByteArray m_eventStreamLineBuffer;
-    QByteArray m_eventStreamDataBuffer;
 
     struct ButtonMultiPressTracker {
         int count = 0;
         std::int64_t lastEventTs = 0;
+        std::int64_t dueMs = 0;
+    };
+
+    struct ButtonLastEvent {
+        int code = 0;
+        std::int64_t ts = 0;
+    };
+
+    // Transient button/dial state of one device. It lives exactly as long as
+    // the device is part of the bridge snapshot.
+    struct DeviceEventState {
+        QHash<QString, ButtonMultiPressTracker> multiPress;
+        QHash<QString, ButtonLastEvent> lastEvent;
+        QStringList learnedButtonResources;
+        int lastDialValue = 0;
+        std::int64_t dialResetDueMs = 0;
         std::int64_t lastSeenMs = 0;
+
+        friend std::size_t heapBytes(const DeviceEventState &state)
+        {
+            return hashBytes(state.multiPress) + hashBytes(state.lastEvent) + heapBytes(state.learnedButtonResources);
+        }
+    };
+
+    struct DiscoverySession {
+        bool active = false;
+        bool pollPending = false;
+        std::int64_t pollDueMs = 0;
+        std::int64_t firstPendingMs = 0;
+        std::int64_t startedMs = 0;
+        std::int64_t deadlineMs = 0;
+        QStringList joinedDeviceIds;
+    };
+
+    // Light state PUTs merged per resource path while the bridge sheds load.
+    struct PendingCommand {
+        QJsonObject payload;
         std::int64_t dueMs = 0;
-        QString deviceExternalId;
-        QString channelExternalId;
     };
 
     QHash<QString, DeviceEntry> m_devices;
     QHash<QString, QString> m_lightResourceByDevice;
     QHash<QString, QString> m_buttonResourceToChannel;
-    QHash<QString, ButtonMultiPressTracker> m_buttonMultiPress;
-    QHash<QString, int> m_buttonLastEventCode;
-    QHash<QString, std::int64_t> m_buttonLastEventTs;
-    QHash<QString, int> m_lastDialValueByDevice;
-    QHash<QString, std::int64_t> m_dialResetDueMs;
+    QHash<QString, DeviceEventState> m_eventState;
+    std::uint64_t m_eventStateEvictions = 0;
     QString m_discoveryResourceId;
-    QSet<QString> m_knownRooms;
-    QSet<QString> m_knownGroups;
-    QSet<QString> m_knownScenes;
+    DiscoverySession m_discovery;
+    // Published rooms, zones and scenes with the fingerprint last sent.
+    QHash<QString, std::size_t> m_knownRooms;
+    QHash<QString, std::size_t> m_knownGroups;
+    QHash<QString, std::size_t> m_knownScenes;
+    MembershipIndex m_membership;
+    QHash<QString, QString> m_serviceOwners;
+    QHash<QString, QString> m_groupedLightByGroup;
+    GroupAggregator m_aggregates{m_membership};
+    QHash<QString, AggregateValues> m_publishedAggregates;
+    // Name, meta and channel set last sent per aggregate device.
+    QHash<QString, QByteArray> m_aggregateDescriptors;
+    ScenePredictor m_scenePredictor;
+    QHash<QString, PendingCommand> m_pendingCommands;
+    QHash<QString, QString> m_deferredRenames;
+    bool m_discoveryDeferred = false;
+    QHash<QString, std::size_t> m_structureHighWater;
+    std::int64_t m_nextStructureSampleMs = 0;
+    LatencyHistogram m_eventLatencyUs;
+    ChannelDeltaQueue m_deltaQueue;
+    LatencyHistogram m_deltaLatencyUs;
     std::unique_ptr<QTimer> m_tickTimer;
+#ifdef PHI_ADAPTER_HUE_TESTING
+    bool m_hostless = false;
+    std::uint64_t m_hostlessMessages = 0;
+#endif
 };
 
 } // namespace phicore::hue::ipc
@@ -0,0 +1,147 @@
+#include "hue_stage_timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace phicore::hue::ipc {
+
+namespace {
+
+std::atomic<int> g_holders{0};
+
+// Written only by the owning thread; relaxed atomics keep reads from the
+// reporting thread well defined without fences on the hot path.
+struct Accumulator {
+    std::array<std::atomic<std::uint64_t>, kStageCount> count{};
+    std::array<std::atomic<std::uint64_t>, kStageCount> totalNs{};
+    std::array<std::atomic<std::uint64_t>, kStageCount> maxNs{};
+
+    Accumulator();
+    ~Accumulator();
+
+    void add(std::size_t index, std::uint64_t ns)
+    {
+        count[index].store(count[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        totalNs[index].store(totalNs[index].load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > maxNs[index].load(std::memory_order_relaxed))
+            maxNs[index].store(ns, std::memory_order_relaxed);
+    }
+
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Accumulator *> live;
+    std::array<StageTotals, kStageCount> retired{};
+};
+
+Registry &registry()
+{
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+void fold(std::array<StageTotals, kStageCount> *totals, const Accumulator &accumulator)
+{
+    for (std::size_t i = 0; i < kStageCount; ++i) {
+        StageTotals &entry = (*totals)[i];
+        entry.count += accumulator.count[i].load(std::memory_order_relaxed);
+        entry.totalNs += accumulator.totalNs[i].load(std::memory_order_relaxed);
+        entry.maxNs = std::max(entry.maxNs, accumulator.maxNs[i].load(std::memory_order_relaxed));
+    }
+}
+
+Accumulator::Accumulator()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.live.push_back(this);
+}
+
+Accumulator::~Accumulator()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    fold(&reg.retired, *this);
+    reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), this), reg.live.end());
+}
+
+Accumulator &localAccumulator()
+{
+    thread_local Accumulator accumulator;
+    return accumulator;
+}
+
+} // namespace
+
+const char *stageName(Stage stage)
+{
+    switch (stage) {
+    case Stage::FetchWall: return "fetchWall";
+    case Stage::JsonParse: return "jsonParse";
+    case Stage::BuildDevices: return "buildDevices";
+    case Stage::BuildLights: return "buildLights";
+    case Stage::BuildSensors: return "buildSensors";
+    case Stage::BuildButtons: return "buildButtons";
+    case Stage::BuildMemberships: return "buildMemberships";
+    case Stage::BuildScenes: return "buildScenes";
+    case Stage::PublishSnapshot: return "publishSnapshot";
+    case Stage::SseParse: return "sseParse";
+    case Stage::EventParse: return "eventParse";
+    case Stage::EventLight: return "eventLight";
+    case Stage::EventButton: return "eventButton";
+    case Stage::EventRotary: return "eventRotary";
+    case Stage::EventSensor: return "eventSensor";
+    case Stage::EventMembership: return "eventMembership";
+    case Stage::EventDiscovery: return "eventDiscovery";
+    case Stage::Count: break;
+    }
+    return "unknown";
+}
+
+void holdStageTiming()
+{
+    g_holders.fetch_add(1, std::memory_order_relaxed);
+}
+
+void releaseStageTiming()
+{
+    g_holders.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool stageTimingEnabled()
+{
+    return g_holders.load(std::memory_order_relaxed) > 0;
+}
+
+std::array<StageTotals, kStageCount> stageTotals()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::array<StageTotals, kStageCount> totals = reg.retired;
+    for (const Accumulator *accumulator : reg.live)
+        fold(&totals, *accumulator);
+    return totals;
+}
+
+StageTimer::StageTimer(Stage stage)
+    : m_stage(stage)
+    , m_running(stageTimingEnabled())
+{
+    if (m_running)
+        m_start = std::chrono::steady_clock::now();
+}
+
+void StageTimer::stop()
+{
+    if (!m_running)
+        return;
+    m_running = false;
+    const auto elapsed = std::chrono::steady_clock::now() - m_start;
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    localAccumulator().add(static_cast<std::size_t>(m_stage), static_cast<std::uint64_t>(std::max<std::int64_t>(0, ns)));
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace phicore::hue::ipc {
+
+enum class Stage : int {
+    // Wall time of a resource GET. The request runs a nested event loop, so
+    // this includes the wait for the bridge and any other work the thread did
+    // meanwhile, not just this fetch's own processing.
+    FetchWall,
+    JsonParse,
+    BuildDevices,
+    BuildLights,
+    BuildSensors,
+    BuildButtons,
+    BuildMemberships,
+    BuildScenes,
+    PublishSnapshot,
+    SseParse,
+    EventParse,
+    EventLight,
+    EventButton,
+    EventRotary,
+    EventSensor,
+    EventMembership,
+    EventDiscovery,
+    Count
+};
+
+constexpr std::size_t kStageCount = static_cast<std::size_t>(Stage::Count);
+
+struct StageTotals {
+    std::uint64_t count = 0;
+    std::uint64_t totalNs = 0;
+    std::uint64_t maxNs = 0;
+};
+
+const char *stageName(Stage stage);
+
+// Process-wide and on while anyone holds it; every instance whose config
+// enables stageTiming holds it once. While it is off a StageTimer costs one
+// relaxed load.
+void holdStageTiming();
+void releaseStageTiming();
+bool stageTimingEnabled();
+
+// Sums the per-thread accumulators, including those of finished threads.
+// Totals accumulate for the life of the process; compare two readings to
+// time an interval.
+std::array<StageTotals, kStageCount> stageTotals();
+
+// Adds the wall time between construction and stop() (or destruction) to
+// the calling thread's accumulator for stage. Nested timers are inclusive.
+class StageTimer
+{
+public:
+    explicit StageTimer(Stage stage);
+    ~StageTimer() { stop(); }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    void stop();
+
+private:
+    Stage m_stage;
+    bool m_running = false;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,219 @@
+#include "hue_task.h"
+
+#include <algorithm>
+
+#include <QNetworkReply>
+#include <QTimer>
+
+namespace phicore::hue::ipc {
+
+struct CancelToken::State {
+    bool cancelled = false;
+    bool deadlineExpired = false;
+    std::uint64_t nextHookId = 1;
+    std::map<std::uint64_t, std::function<void()>> hooks;
+    std::unique_ptr<QTimer> deadline;
+
+    ~State()
+    {
+        // The last reference may go away inside the deadline's own timeout.
+        if (deadline)
+            deadline.release()->deleteLater();
+    }
+};
+
+CancelToken::CancelToken()
+    : m_state(std::make_shared<State>())
+{
+}
+
+void CancelToken::cancel()
+{
+    if (m_state->cancelled)
+        return;
+    m_state->cancelled = true;
+    if (m_state->deadline)
+        m_state->deadline->stop();
+
+    // Hooks resume coroutines, which may register or remove hooks themselves.
+    std::map<std::uint64_t, std::function<void()>> hooks;
+    hooks.swap(m_state->hooks);
+    for (auto &[id, hook] : hooks)
+        hook();
+}
+
+bool CancelToken::cancelled() const
+{
+    return m_state->cancelled;
+}
+
+void CancelToken::setDeadline(int timeoutMs)
+{
+    if (m_state->cancelled)
+        return;
+    if (!m_state->deadline) {
+        m_state->deadline = std::make_unique<QTimer>();
+        m_state->deadline->setSingleShot(true);
+        m_state->deadline->setTimerType(Qt::PreciseTimer);
+        std::weak_ptr<State> weak = m_state;
+        QObject::connect(m_state->deadline.get(), &QTimer::timeout, m_state->deadline.get(), [weak]() {
+            if (std::shared_ptr<State> state = weak.lock()) {
+                state->deadlineExpired = true;
+                CancelToken token;
+                token.m_state = std::move(state);
+                token.cancel();
+            }
+        });
+    }
+    m_state->deadline->start(std::max(0, timeoutMs));
+}
+
+bool CancelToken::deadlineExpired() const
+{
+    return m_state->deadlineExpired;
+}
+
+int CancelToken::remainingMs() const
+{
+    if (m_state->cancelled)
+        return 0;
+    if (!m_state->deadline || !m_state->deadline->isActive())
+        return -1;
+    return std::max(0, m_state->deadline->remainingTime());
+}
+
+std::uint64_t CancelToken::addHook(std::function<void()> hook) const
+{
+    const std::uint64_t id = m_state->nextHookId++;
+    m_state->hooks.emplace(id, std::move(hook));
+    return id;
+}
+
+void CancelToken::removeHook(std::uint64_t id) const
+{
+    m_state->hooks.erase(id);
+}
+
+HttpAwaiter::HttpAwaiter(const HttpClient &http,
+                         ConnectionSettings settings,
+                         QByteArray method,
+                         QString path,
+                         QByteArray payload,
+                         bool includeAppKey,
+                         int timeoutMs,
+                         CancelToken token)
+    : m_http(http)
+    , m_settings(std::move(settings))
+    , m_method(std::move(method))
+    , m_path(std::move(path))
+    , m_payload(std::move(payload))
+    , m_includeAppKey(includeAppKey)
+    , m_timeoutMs(timeoutMs)
+    , m_token(std::move(token))
+{
+}
+
+HttpAwaiter::~HttpAwaiter()
+{
+    if (m_hookId)
+        m_token.removeHook(m_hookId);
+}
+
+bool HttpAwaiter::await_ready()
+{
+    if (!m_token.cancelled())
+        return false;
+    m_result.error = QStringLiteral("Cancelled");
+    return true;
+}
+
+bool HttpAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    QString error;
+    QNetworkReply *reply = m_http.requestAsync(
+        m_settings,
+        m_method,
+        m_path,
+        m_payload,
+        m_includeAppKey,
+        m_timeoutMs,
+        [this, handle, alive = std::weak_ptr<bool>(m_alive)](const HttpResult &result) {
+            // The frame holding this awaiter may be gone if its task was dropped.
+            if (alive.expired())
+                return;
+            m_result = result;
+            handle.resume();
+        },
+        nullptr,
+        &error);
+    if (!reply) {
+        m_result.error = error;
+        return false;
+    }
+
+    QPointer<QNetworkReply> guard(reply);
+    m_hookId = m_token.addHook([guard]() {
+        // Aborting finishes the reply synchronously and resumes the await.
+        if (guard)
+            guard->abort();
+    });
+    return true;
+}
+
+HttpResult HttpAwaiter::await_resume()
+{
+    if (m_token.cancelled() && !m_result.ok)
+        m_result.error = QStringLiteral("Cancelled");
+    return std::move(m_result);
+}
+
+DelayAwaiter::DelayAwaiter(int timeoutMs, CancelToken token)
+    : m_timeoutMs(timeoutMs)
+    , m_token(std::move(token))
+{
+}
+
+DelayAwaiter::~DelayAwaiter()
+{
+    if (m_hookId)
+        m_token.removeHook(m_hookId);
+    // Usually destroyed from inside the timer's own timeout signal.
+    if (m_timer) {
+        m_timer->stop();
+        m_timer.release()->deleteLater();
+    }
+}
+
+bool DelayAwaiter::await_ready() const
+{
+    return m_timeoutMs <= 0 || m_token.cancelled();
+}
+
+void DelayAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_timer = std::make_unique<QTimer>();
+    m_timer->setSingleShot(true);
+    QObject::connect(m_timer.get(), &QTimer::timeout, m_timer.get(), [this]() {
+        wake();
+    });
+    m_hookId = m_token.addHook([this]() {
+        wake();
+    });
+    m_timer->start(m_timeoutMs);
+}
+
+void DelayAwaiter::await_resume()
+{
+}
+
+void DelayAwaiter::wake()
+{
+    if (!m_handle)
+        return;
+    m_timer->stop();
+    std::coroutine_handle<> handle = std::exchange(m_handle, {});
+    handle.resume();
+}
+
+} // namespace phicore::hue::ipc
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <QByteArray>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include "hue_http.h"
+
+class QTimer;
+
+namespace phicore::hue::ipc {
+
+// Shared cancellation flag for a group of coroutine steps. Cancelling wakes
+// every pending await of the group immediately; a deadline cancels on its own.
+class CancelToken
+{
+public:
+    CancelToken();
+
+    void cancel();
+    bool cancelled() const;
+    void setDeadline(int timeoutMs);
+    // True once the deadline, not cancel(), has cancelled the token.
+    bool deadlineExpired() const;
+    // Time left until the deadline; 0 once cancelled, -1 without a deadline.
+    int remainingMs() const;
+
+    std::uint64_t addHook(std::function<void()> hook) const;
+    void removeHook(std::uint64_t id) const;
+
+private:
+    struct State;
+    std::shared_ptr<State> m_state;
+};
+
+// Lazily started coroutine yielding T. A Task is either awaited by another
+// Task or detached with start(); a detached frame frees itself when done.
+template <typename T>
+class Task
+{
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::coroutine_handle<> continuation;
+        std::function<void(T)> done;
+        QPointer<QObject> doneContext;
+        bool detached = false;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+            {
+                promise_type &promise = handle.promise();
+                if (promise.continuation)
+                    return promise.continuation;
+                if (promise.detached) {
+                    std::function<void(T)> done = std::move(promise.done);
+                    const bool deliver = done && promise.doneContext;
+                    std::optional<T> value = std::move(promise.value);
+                    handle.destroy();
+                    if (deliver && value)
+                        done(std::move(*value));
+                }
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(T result) { value = std::move(result); }
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    Task() = default;
+    Task(Task &&other) noexcept
+        : m_handle(std::exchange(other.m_handle, {}))
+    {
+    }
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() { reset(); }
+
+    // Runs the task without an awaiting parent. done is skipped once context
+    // has been destroyed, so it may safely capture the context's owner.
+    void start(QObject *context, std::function<void(T)> done)
+    {
+        if (!m_handle)
+            return;
+        std::coroutine_handle<promise_type> handle = std::exchange(m_handle, {});
+        handle.promise().detached = true;
+        handle.promise().done = std::move(done);
+        handle.promise().doneContext = context;
+        handle.resume();
+    }
+
+    bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        m_handle.promise().continuation = continuation;
+        return m_handle;
+    }
+    T await_resume() { return std::move(*m_handle.promise().value); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : m_handle(handle)
+    {
+    }
+
+    void reset()
+    {
+        if (m_handle)
+            m_handle.destroy();
+        m_handle = {};
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Awaits one bridge request. Cancellation aborts the reply and resumes with
+// an error result.
+class HttpAwaiter
+{
+public:
+    HttpAwaiter(const HttpClient &http,
+                ConnectionSettings settings,
+                QByteArray method,
+                QString path,
+                QByteArray payload,
+                bool includeAppKey,
+                int timeoutMs,
+                CancelToken token);
+    ~HttpAwaiter();
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> handle);
+    HttpResult await_resume();
+
+private:
+    const HttpClient &m_http;
+    ConnectionSettings m_settings;
+    QByteArray m_method;
+    QString m_path;
+    QByteArray m_payload;
+    bool m_includeAppKey = true;
+    int m_timeoutMs = 0;
+    CancelToken m_token;
+    HttpResult m_result;
+    std::shared_ptr<bool> m_alive = std::make_shared<bool>(true);
+    std::uint64_t m_hookId = 0;
+};
+
+// Suspends for timeoutMs on the event loop, or until the token is cancelled.
+class DelayAwaiter
+{
+public:
+    DelayAwaiter(int timeoutMs, CancelToken token);
+    ~DelayAwaiter();
+
+    bool await_ready() const;
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume();
+
+private:
+    void wake();
+
+    int m_timeoutMs = 0;
+    CancelToken m_token;
+    std::unique_ptr<QTimer> m_timer;
+    std::coroutine_handle<> m_handle;
+    std::uint64_t m_hookId = 0;
+};
+
+inline HttpAwaiter awaitRequest(const HttpClient &http,
+                                const ConnectionSettings &settings,
+                                const QByteArray &method,
+                                const QString &path,
+                                const QByteArray &payload,
+                                bool includeAppKey,
+                                int timeoutMs,
+                                const CancelToken &token)
+{
+    return HttpAwaiter(http, settings, method, path, payload, includeAppKey, timeoutMs, token);
+}
+
+inline DelayAwaiter awaitDelay(int timeoutMs, const CancelToken &token)
+{
+    return DelayAwaiter(timeoutMs, token);
+}
+
+} // namespace phicore::hue::ipc
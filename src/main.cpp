@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <csignal>
 #include <cstdlib>
 #include <iostream>
+#include <map>
 #include <memory>
 
 #include <QCoreApplication>
@@ -24,6 +26,8 @@ namespace v1 = phicore::adapter::v1;
 using phicore::hue::ipc::ConnectionSettings;
 using phicore::hue::ipc::HttpClient;
 
+constexpr int kMaxPairingWindowMs = 120000;
+
 std::atomic_bool g_running{true};
 
 void handleSignal(int)
@@ -117,7 +121,7 @@ protected:
 
     void onFactoryActionInvoke(const phi::AdapterActionInvokeRequest &request) override
     {
-        submitFactoryActionResult(handleFactoryAction(request), "factory.action.invoke");
+        handleFactoryAction(request);
     }
 
     v1::Utf8String pluginType() const override
@@ -147,7 +151,8 @@ protected:
 
     int timeoutMs() const override
     {
-        return 10000;
+        // Covers the longest pairing window plus one request timeout.
+        return kMaxPairingWindowMs + 10000;
     }
 
     int maxInstances() const override
@@ -179,7 +184,7 @@ protected:
     }
 
 private:
-    v1::ActionResponse handleFactoryAction(const phi::AdapterActionInvokeRequest &request)
+    void handleFactoryAction(const phi::AdapterActionInvokeRequest &request)
     {
         v1::ActionResponse response;
         response.id = request.cmdId;
@@ -188,17 +193,52 @@ private:
         if (request.actionId != "probe") {
             response.status = v1::CmdStatus::NotSupported;
             response.error = "Unsupported factory action";
-            return response;
+            submitFactoryActionResult(std::move(response), "factory.action.invoke");
+            return;
         }
 
         ConnectionSettings settings = m_factorySettings;
+        phicore::hue::ipc::ProbeOptions options;
         if (!request.paramsJson.empty()) {
             const QJsonDocument doc = QJsonDocument::fromJson(QByteArray::fromStdString(request.paramsJson));
-            if (doc.isObject())
-                applyProbeParams(doc.object(), &settings);
+            if (doc.isObject()) {
+                const QJsonObject params = doc.object();
+                applyProbeParams(params, &settings);
+                options.pairingWindowMs = std::clamp(
+                    params.value(QStringLiteral("pairingWindowMs")).toInt(options.pairingWindowMs),
+                    0,
+                    kMaxPairingWindowMs);
+                options.pairingIntervalMs = std::clamp(
+                    params.value(QStringLiteral("pairingIntervalMs")).toInt(options.pairingIntervalMs),
+                    250,
+                    10000);
+            }
         }
 
-        const phicore::hue::ipc::ProbeResult probe = phicore::hue::ipc::runProbe(m_http, settings, 10000);
+        const std::uint64_t cmdId = request.cmdId;
+        auto session = std::make_unique<phicore::hue::ipc::ProbeSession>(m_http, settings, options);
+        phicore::hue::ipc::ProbeSession *raw = session.get();
+        m_probes[cmdId] = std::move(session);
+
+        raw->start(
+            [this, cmdId](const phicore::hue::ipc::ProbeResult &probe) {
+                submitFactoryActionResult(probeResponse(cmdId, probe), "factory.action.invoke");
+                // The session is still on the stack; release it on the next turn.
+                QTimer::singleShot(0, &m_probeNetwork, [this, cmdId]() {
+                    m_probes.erase(cmdId);
+                });
+            },
+            [this, cmdId](const QString &state, int remainingMs) {
+                reportPairingProgress(cmdId, state, remainingMs);
+            });
+    }
+
+    v1::ActionResponse probeResponse(std::uint64_t cmdId, const phicore::hue::ipc::ProbeResult &probe)
+    {
+        v1::ActionResponse response;
+        response.id = cmdId;
+        response.tsMs = nowMs();
+
         if (!probe.ok) {
             response.status = v1::CmdStatus::Failure;
             response.error = probe.error.toStdString();
@@ -226,6 +266,15 @@ private:
         return response;
     }
 
+    // Progress is transient, so it goes to the log only; adapter meta is
+    // persisted and would keep the last state after pairing ended. The
+    // outcome is the action result.
+    void reportPairingProgress(std::uint64_t cmdId, const QString &state, int remainingMs)
+    {
+        std::cerr << "hue-ipc probe cmdId=" << cmdId << " state=" << state.toStdString()
+                  << " remainingMs=" << remainingMs << '\n';
+    }
+
     void submitFactoryActionResult(v1::ActionResponse response, const char *context)
     {
         v1::Utf8String error;
@@ -236,6 +285,7 @@ private:
     QNetworkAccessManager m_probeNetwork;
     HttpClient m_http{&m_probeNetwork};
     ConnectionSettings m_factorySettings;
+    std::map<std::uint64_t, std::unique_ptr<phicore::hue::ipc::ProbeSession>> m_probes;
 };
 
 } // namespace
@@ -0,0 +1,216 @@
+// Days of bridge traffic in minutes: a mock bridge streams randomized button,
+// dial, sensor and light events while commands, renames, scene recalls,
+// host reconnects, bridge connection drops and device churn run against one
+// adapter instance. The wall clock advances stepMinutes per step. Resident
+// memory, the entries of every tracked structure and the p99 event latency
+// of each window of simulated time are compared with the first window after
+// warm-up; any of them creeping up fails the test.
+//
+//   hue_soak_test [--days=7] [--step-minutes=5] [--window-hours=12]
+//                 [--devices=200] [--events=40] [--seed=1]
+//                 [--rss-tolerance=0.10] [--latency-factor=2.0]
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "bench_options.h"
+#include "bridge_traffic.h"
+#include "hue_clock.h"
+#include "hue_fixture.h"
+#include "instance_driver.h"
+#include "memory_probe.h"
+#include "mock_bridge.h"
+
+namespace {
+
+using namespace phicore::hue::ipc;
+using namespace phicore::hue::ipc::testing;
+
+// Real time per step; covers at least one tick of the instance and session.
+constexpr int kStepRealMs = 300;
+constexpr int kSettleTimeoutMs = 10000;
+// Slack on top of the relative tolerances, for structures that hold a
+// handful of in-flight entries at any moment.
+constexpr double kStructureSlackEntries = 16.0;
+constexpr double kRssSlackBytes = 4.0 * 1024.0 * 1024.0;
+constexpr double kLatencySlackUs = 500.0;
+
+void pumpEvents(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+bool settle(const InstanceDriver &driver)
+{
+    for (int waited = 0; waited < kSettleTimeoutMs; waited += kStepRealMs) {
+        if (driver.connected() && driver.deviceCount() > 0)
+            return true;
+        pumpEvents(kStepRealMs);
+    }
+    return false;
+}
+
+struct Window {
+    double rssBytes = 0.0;
+    double instanceBytes = 0.0;
+    std::int64_t p99Us = 0;
+    std::uint64_t events = 0;
+    QJsonObject entries;
+
+    QJsonObject toJson() const
+    {
+        QJsonObject result;
+        result.insert(QStringLiteral("rssBytes"), rssBytes);
+        result.insert(QStringLiteral("instanceBytes"), instanceBytes);
+        result.insert(QStringLiteral("p99EventLatencyUs"), static_cast<qint64>(p99Us));
+        result.insert(QStringLiteral("events"), static_cast<qint64>(events));
+        result.insert(QStringLiteral("entries"), entries);
+        return result;
+    }
+};
+
+Window sampleWindow(InstanceDriver &driver)
+{
+    Window window;
+    const LatencyHistogram latency = driver.takeEventLatency();
+    window.p99Us = latency.quantile(0.99);
+    window.events = latency.count();
+
+    releaseFreeMemory();
+    window.rssBytes = static_cast<double>(residentBytes());
+
+    const QJsonObject footprint = driver.memoryFootprint();
+    window.instanceBytes = footprint.value(QStringLiteral("instanceBytes")).toDouble();
+    const QJsonObject structures = footprint.value(QStringLiteral("structures")).toObject();
+    for (auto it = structures.constBegin(); it != structures.constEnd(); ++it)
+        window.entries.insert(it.key(), it.value().toObject().value(QStringLiteral("entries")));
+    return window;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const BenchOptions options(argc, argv);
+    const int days = std::max(1, options.intValue("days", 7));
+    const int stepMinutes = std::clamp(options.intValue("step-minutes", 5), 1, 60);
+    const int windowHours = std::clamp(options.intValue("window-hours", 12), 1, 24 * days);
+    const int devices = std::max(20, options.intValue("devices", 200));
+    const int eventsPerStep = std::max(0, options.intValue("events", 40));
+    const auto seed = static_cast<std::uint32_t>(options.intValue("seed", 1));
+    const double rssTolerance = std::max(0.0, options.doubleValue("rss-tolerance", 0.10));
+    const double latencyFactor = std::max(1.0, options.doubleValue("latency-factor", 2.0));
+
+    const int steps = days * 24 * 60 / stepMinutes;
+    const int stepsPerWindow = std::max(1, windowHours * 60 / stepMinutes);
+    if (steps / stepsPerWindow < 3) {
+        std::cerr << "hue-soak needs at least three windows; raise --days or lower --window-hours" << '\n';
+        return 2;
+    }
+
+    BridgeFixture fixture(buildingOptions(devices, seed));
+    MockBridge bridge(fixture);
+    QString error;
+    if (!bridge.listen(&error)) {
+        std::cerr << "hue-soak mock bridge: " << error.toStdString() << '\n';
+        return 2;
+    }
+
+    // Polls stay on their default schedule; the eventstream carries the load.
+    const QJsonObject meta = bridge.meta();
+    InstanceDriver driver;
+    driver.start();
+    driver.configure(meta);
+    if (!settle(driver)) {
+        std::cerr << "hue-soak instance never synced with the mock bridge" << '\n';
+        return 2;
+    }
+
+    BridgeTraffic soak(fixture, bridge, driver, seed);
+    const double stepMs = static_cast<double>(stepMinutes) * 60000.0;
+    // Hours between disruptions, on average.
+    const double hostReconnectProbability = stepMs / (6.0 * 3600000.0);
+    const double bridgeDropProbability = stepMs / (8.0 * 3600000.0);
+    const double churnProbability = stepMs / (2.0 * 3600000.0);
+    std::uint64_t hostReconnects = 0;
+
+    std::vector<Window> windows;
+    for (int step = 1; step <= steps; ++step) {
+        advanceWallClock(static_cast<std::int64_t>(stepMs) - kStepRealMs);
+        soak.step(eventsPerStep);
+        if (soak.chance(churnProbability))
+            soak.churn();
+        if (soak.chance(bridgeDropProbability))
+            bridge.dropConnections();
+        if (soak.chance(hostReconnectProbability)) {
+            driver.reconnectHost(meta);
+            ++hostReconnects;
+        }
+        pumpEvents(kStepRealMs);
+
+        if (step % stepsPerWindow == 0) {
+            if (!settle(driver)) {
+                std::cerr << "hue-soak instance did not recover after step " << step << '\n';
+                return 1;
+            }
+            windows.push_back(sampleWindow(driver));
+        }
+    }
+
+    // The first window is warm-up: pools, histograms and hash tables find
+    // their working size there.
+    const Window &baseline = windows.at(1);
+    const Window &last = windows.back();
+    QJsonArray failures;
+    if (last.rssBytes > baseline.rssBytes * (1.0 + rssTolerance) + kRssSlackBytes)
+        failures.append(QStringLiteral("rssBytes grew from %1 to %2").arg(baseline.rssBytes).arg(last.rssBytes));
+    if (last.instanceBytes > baseline.instanceBytes * (1.0 + rssTolerance) + kRssSlackBytes)
+        failures.append(QStringLiteral("instanceBytes grew from %1 to %2").arg(baseline.instanceBytes).arg(last.instanceBytes));
+    if (static_cast<double>(last.p99Us) > static_cast<double>(baseline.p99Us) * latencyFactor + kLatencySlackUs)
+        failures.append(QStringLiteral("p99 event latency grew from %1 us to %2 us").arg(baseline.p99Us).arg(last.p99Us));
+    for (auto it = last.entries.constBegin(); it != last.entries.constEnd(); ++it) {
+        const double before = baseline.entries.value(it.key()).toDouble();
+        const double after = it.value().toDouble();
+        if (after > before * (1.0 + rssTolerance) + kStructureSlackEntries)
+            failures.append(QStringLiteral("%1 grew from %2 to %3 entries").arg(it.key()).arg(before).arg(after));
+    }
+
+    QJsonArray windowReports;
+    for (const Window &window : windows)
+        windowReports.append(window.toJson());
+
+    const MockBridgeStats &stats = bridge.stats();
+    QJsonObject traffic;
+    traffic.insert(QStringLiteral("requests"), static_cast<qint64>(stats.requests));
+    traffic.insert(QStringLiteral("puts"), static_cast<qint64>(stats.puts));
+    traffic.insert(QStringLiteral("eventStreams"), static_cast<qint64>(stats.eventStreams));
+    traffic.insert(QStringLiteral("eventsSent"), static_cast<qint64>(stats.eventsSent));
+    traffic.insert(QStringLiteral("bridgeDrops"), static_cast<qint64>(stats.drops));
+    traffic.insert(QStringLiteral("hostReconnects"), static_cast<qint64>(hostReconnects));
+    traffic.insert(QStringLiteral("devicesChurned"), static_cast<qint64>(soak.churned()));
+    traffic.insert(QStringLiteral("hostMessages"), static_cast<qint64>(driver.droppedMessages()));
+
+    QJsonObject report;
+    report.insert(QStringLiteral("test"), QStringLiteral("soak"));
+    report.insert(QStringLiteral("simulatedDays"), days);
+    report.insert(QStringLiteral("devices"), static_cast<qint64>(fixture.deviceCount()));
+    report.insert(QStringLiteral("traffic"), traffic);
+    report.insert(QStringLiteral("windows"), windowReports);
+    report.insert(QStringLiteral("failures"), failures);
+    report.insert(QStringLiteral("passed"), failures.isEmpty());
+    printReport(report);
+    return failures.isEmpty() ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#include "bench_options.h"
+
+#include <cstdio>
+
+#include <QJsonDocument>
+
+namespace phicore::hue::ipc::testing {
+
+BenchOptions::BenchOptions(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const QString arg = QString::fromLocal8Bit(argv[i]);
+        if (!arg.startsWith(QLatin1String("--")))
+            continue;
+        const int eq = arg.indexOf(QLatin1Char('='));
+        if (eq < 0)
+            m_values.insert(arg.mid(2), QString());
+        else
+            m_values.insert(arg.mid(2, eq - 2), arg.mid(eq + 1));
+    }
+}
+
+int BenchOptions::intValue(const char *name, int fallback) const
+{
+    bool ok = false;
+    const int value = m_values.value(QString::fromLatin1(name)).toInt(&ok);
+    return ok ? value : fallback;
+}
+
+double BenchOptions::doubleValue(const char *name, double fallback) const
+{
+    bool ok = false;
+    const double value = m_values.value(QString::fromLatin1(name)).toDouble(&ok);
+    return ok ? value : fallback;
+}
+
+QString BenchOptions::stringValue(const char *name, const QString &fallback) const
+{
+    const auto it = m_values.constFind(QString::fromLatin1(name));
+    return it != m_values.cend() && !it->isEmpty() ? it.value() : fallback;
+}
+
+bool BenchOptions::flag(const char *name) const
+{
+    return m_values.contains(QString::fromLatin1(name));
+}
+
+void printReport(const QJsonObject &report)
+{
+    const QByteArray text = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    std::fwrite(text.constData(), 1, static_cast<std::size_t>(text.size()), stdout);
+    std::fflush(stdout);
+}
+
+} // namespace phicore::hue::ipc::testing
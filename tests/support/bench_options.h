@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+
+namespace phicore::hue::ipc::testing {
+
+// "--name=value" and "--flag" arguments of the benchmark and test drivers.
+class BenchOptions
+{
+public:
+    BenchOptions(int argc, char **argv);
+
+    int intValue(const char *name, int fallback) const;
+    double doubleValue(const char *name, double fallback) const;
+    QString stringValue(const char *name, const QString &fallback = {}) const;
+    bool flag(const char *name) const;
+
+private:
+    QHash<QString, QString> m_values;
+};
+
+// Reports go to stdout as indented JSON so runs can be diffed and compared.
+void printReport(const QJsonObject &report);
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,219 @@
+#include "bridge_traffic.h"
+
+#include <iterator>
+
+#include <QDateTime>
+#include <QJsonArray>
+
+#include "hue_clock.h"
+
+namespace phicore::hue::ipc::testing {
+
+namespace {
+
+QString isoNow()
+{
+    return QDateTime::fromMSecsSinceEpoch(wallClockMs(), Qt::UTC).toString(Qt::ISODateWithMs);
+}
+
+QString ownerOf(const QJsonObject &resource)
+{
+    return resource.value(QStringLiteral("owner")).toObject().value(QStringLiteral("rid")).toString();
+}
+
+} // namespace
+
+BridgeTraffic::BridgeTraffic(BridgeFixture &fixture, MockBridge &bridge, InstanceDriver &driver, std::uint32_t seed)
+    : m_fixture(fixture)
+    , m_bridge(bridge)
+    , m_driver(driver)
+    , m_random(seed)
+{
+}
+
+void BridgeTraffic::step(int events)
+{
+    QJsonArray batch;
+    for (int i = 0; i < events; ++i) {
+        const QJsonObject event = randomEvent();
+        if (!event.isEmpty())
+            batch.append(event);
+    }
+    m_bridge.emitEvents(batch);
+
+    const int commands = static_cast<int>(m_random() % 3U);
+    for (int i = 0; i < commands; ++i) {
+        const QString light = pick(lights());
+        if (chance(0.5))
+            m_driver.setOn(light, chance(0.5));
+        else
+            m_driver.setChannel(light, "bri", static_cast<double>(m_random() % 101U));
+    }
+    if (chance(0.1))
+        m_driver.rename(pick(lights()), QStringLiteral("Light %1").arg(++m_renames));
+    if (chance(0.1))
+        m_driver.invokeScene(pick(m_fixture.ids(QStringLiteral("scene"))));
+    if (chance(0.05))
+        m_driver.invokeEffect(pick(lights()), chance(0.5) ? "candle" : "no_effect");
+    if (chance(0.02))
+        m_driver.invokeAction("memoryFootprint");
+}
+
+void BridgeTraffic::commandStorm(int commands)
+{
+    const QStringList scenes = m_fixture.ids(QStringLiteral("scene"));
+    QStringList groups = m_fixture.ids(QStringLiteral("room"));
+    groups.append(m_fixture.ids(QStringLiteral("zone")));
+    for (int i = 0; i < commands; ++i) {
+        if (chance(0.5) && !scenes.isEmpty()) {
+            m_driver.invokeScene(pick(scenes));
+        } else if (!groups.isEmpty()) {
+            const QString aggregate = QStringLiteral("aggregate:") + pick(groups);
+            if (chance(0.5))
+                m_driver.setChannel(aggregate, "any_on", chance(0.5) ? 1.0 : 0.0);
+            else
+                m_driver.setChannel(aggregate, "avg_bri", static_cast<double>(m_random() % 101U));
+        }
+    }
+}
+
+void BridgeTraffic::churn()
+{
+    const QString deviceId = pick(m_fixture.ids(QStringLiteral("device")));
+    const QString model = m_fixture.resource(QStringLiteral("device"), deviceId)
+                              .value(QStringLiteral("product_data")).toObject()
+                              .value(QStringLiteral("model_id")).toString();
+    const QJsonArray removed = m_fixture.removeDevice(deviceId);
+
+    QString added;
+    if (model == QLatin1String("SML001"))
+        added = m_fixture.addMotionSensor();
+    else if (model == QLatin1String("RWL022"))
+        added = m_fixture.addSwitch();
+    else if (model == QLatin1String("RDM002"))
+        added = m_fixture.addDial();
+    else
+        added = m_fixture.addLight();
+
+    QJsonArray deleted;
+    for (const QJsonValue &ref : removed) {
+        const QJsonObject refObj = ref.toObject();
+        deleted.append(QJsonObject{{QStringLiteral("id"), refObj.value(QStringLiteral("rid"))},
+                                   {QStringLiteral("type"), refObj.value(QStringLiteral("rtype"))}});
+    }
+    m_bridge.emitEvents(QJsonArray{
+        m_bridge.event(QStringLiteral("delete"), deleted),
+        m_bridge.event(QStringLiteral("add"), QJsonArray{m_fixture.resource(QStringLiteral("device"), added)}),
+    });
+    ++m_churned;
+}
+
+bool BridgeTraffic::chance(double probability)
+{
+    return std::uniform_real_distribution<double>(0.0, 1.0)(m_random) < probability;
+}
+
+QStringList BridgeTraffic::lights() const
+{
+    QStringList devices;
+    for (const QString &lightId : m_fixture.ids(QStringLiteral("light")))
+        devices.push_back(ownerOf(m_fixture.resource(QStringLiteral("light"), lightId)));
+    return devices;
+}
+
+QString BridgeTraffic::pick(const QStringList &items)
+{
+    return items.isEmpty() ? QString{} : items.at(static_cast<qsizetype>(m_random() % items.size()));
+}
+
+QJsonObject BridgeTraffic::update(const QString &type, const QString &id, const QJsonObject &fields)
+{
+    const QJsonObject resource = m_fixture.updateResource(type, id, fields);
+    if (resource.isEmpty())
+        return {};
+    QJsonObject data = fields;
+    data.insert(QStringLiteral("id"), id);
+    data.insert(QStringLiteral("type"), type);
+    data.insert(QStringLiteral("owner"), resource.value(QStringLiteral("owner")));
+    return m_bridge.event(QStringLiteral("update"), QJsonArray{data});
+}
+
+QJsonObject BridgeTraffic::randomEvent()
+{
+    static const char *const kButtonEvents[] = {
+        "initial_press", "short_release", "short_release", "long_press", "repeat", "long_release",
+    };
+    const double roll = std::uniform_real_distribution<double>(0.0, 1.0)(m_random);
+    if (roll < 0.30) {
+        const QString id = pick(m_fixture.ids(QStringLiteral("button")));
+        const QString name = QString::fromLatin1(kButtonEvents[m_random() % std::size(kButtonEvents)]);
+        return update(QStringLiteral("button"), id, QJsonObject{
+            {QStringLiteral("button"),
+             QJsonObject{{QStringLiteral("button_report"),
+                          QJsonObject{{QStringLiteral("event"), name}, {QStringLiteral("updated"), isoNow()}}},
+                         {QStringLiteral("last_event"), name}}},
+        });
+    }
+    if (roll < 0.45) {
+        const QString id = pick(m_fixture.ids(QStringLiteral("relative_rotary")));
+        const QJsonObject rotation{
+            {QStringLiteral("direction"), chance(0.5) ? QStringLiteral("clock_wise") : QStringLiteral("counter_clock_wise")},
+            {QStringLiteral("steps"), 1 + static_cast<int>(m_random() % 120U)},
+            {QStringLiteral("duration"), 400},
+        };
+        return update(QStringLiteral("relative_rotary"), id, QJsonObject{
+            {QStringLiteral("relative_rotary"),
+             QJsonObject{{QStringLiteral("rotary_report"),
+                          QJsonObject{{QStringLiteral("action"), chance(0.5) ? QStringLiteral("start") : QStringLiteral("repeat")},
+                                      {QStringLiteral("rotation"), rotation},
+                                      {QStringLiteral("updated"), isoNow()}}}}},
+        });
+    }
+    if (roll < 0.60) {
+        const QString id = pick(m_fixture.ids(QStringLiteral("temperature")));
+        const double celsius = 18.0 + static_cast<double>(m_random() % 80U) / 10.0;
+        return update(QStringLiteral("temperature"), id, QJsonObject{
+            {QStringLiteral("temperature"),
+             QJsonObject{{QStringLiteral("temperature"), celsius},
+                         {QStringLiteral("temperature_valid"), true},
+                         {QStringLiteral("temperature_report"),
+                          QJsonObject{{QStringLiteral("changed"), isoNow()}, {QStringLiteral("temperature"), celsius}}}}},
+        });
+    }
+    if (roll < 0.70) {
+        const QString id = pick(m_fixture.ids(QStringLiteral("light_level")));
+        const int level = 5000 + static_cast<int>(m_random() % 25000U);
+        return update(QStringLiteral("light_level"), id, QJsonObject{
+            {QStringLiteral("light"),
+             QJsonObject{{QStringLiteral("light_level"), level},
+                         {QStringLiteral("light_level_valid"), true},
+                         {QStringLiteral("light_level_report"),
+                          QJsonObject{{QStringLiteral("changed"), isoNow()}, {QStringLiteral("light_level"), level}}}}},
+        });
+    }
+    if (roll < 0.85) {
+        const QString id = pick(m_fixture.ids(QStringLiteral("motion")));
+        const bool motion = chance(0.5);
+        return update(QStringLiteral("motion"), id, QJsonObject{
+            {QStringLiteral("motion"),
+             QJsonObject{{QStringLiteral("motion"), motion},
+                         {QStringLiteral("motion_valid"), true},
+                         {QStringLiteral("motion_report"),
+                          QJsonObject{{QStringLiteral("changed"), isoNow()}, {QStringLiteral("motion"), motion}}}}},
+        });
+    }
+    if (roll < 0.95) {
+        // Someone used a wall switch or another app.
+        const QString id = pick(m_fixture.ids(QStringLiteral("light")));
+        return update(QStringLiteral("light"), id, QJsonObject{
+            {QStringLiteral("on"), QJsonObject{{QStringLiteral("on"), chance(0.5)}}},
+            {QStringLiteral("dimming"), QJsonObject{{QStringLiteral("brightness"), static_cast<double>(1 + m_random() % 100U)}}},
+        });
+    }
+    const QString id = pick(m_fixture.ids(QStringLiteral("zigbee_connectivity")));
+    return update(QStringLiteral("zigbee_connectivity"), id, QJsonObject{
+        {QStringLiteral("status"), chance(0.8) ? QStringLiteral("connected") : QStringLiteral("connectivity_issue")},
+    });
+}
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "hue_fixture.h"
+#include "instance_driver.h"
+#include "mock_bridge.h"
+
+namespace phicore::hue::ipc::testing {
+
+// Randomized activity of a busy home against one instance: eventstream
+// updates from buttons, dials, sensors and lights, host commands, and
+// devices being replaced.
+class BridgeTraffic
+{
+public:
+    BridgeTraffic(BridgeFixture &fixture, MockBridge &bridge, InstanceDriver &driver, std::uint32_t seed);
+
+    // One batch of events followed by a few commands.
+    void step(int events);
+    // Scene recalls and room switches back to back, as an automation or a
+    // wall panel produces them.
+    void commandStorm(int commands);
+    // Replaces one device with a new one of the same kind, announced the
+    // way the bridge does it.
+    void churn();
+
+    bool chance(double probability);
+    std::uint64_t churned() const { return m_churned; }
+
+private:
+    QStringList lights() const;
+    QString pick(const QStringList &items);
+    QJsonObject update(const QString &type, const QString &id, const QJsonObject &fields);
+    QJsonObject randomEvent();
+
+    BridgeFixture &m_fixture;
+    MockBridge &m_bridge;
+    InstanceDriver &m_driver;
+    std::mt19937 m_random;
+    int m_renames = 0;
+    std::uint64_t m_churned = 0;
+};
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,467 @@
+#include "hue_fixture.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <QSet>
+
+namespace phicore::hue::ipc::testing {
+
+namespace {
+
+struct ProductVariant {
+    const char *modelId;
+    const char *productName;
+    const char *firmware;
+    const char *archetype;
+    bool color;
+    bool ambiance;
+};
+
+// Mostly identical bulbs, as in the buildings the pools are sized for.
+constexpr ProductVariant kLightVariants[] = {
+    {"LCA006", "Hue color lamp", "1.116.3", "sultan_bulb", true, true},
+    {"LTA004", "Hue white ambiance bulb", "1.116.3", "sultan_bulb", false, true},
+    {"LWA017", "Hue white lamp", "1.104.2", "classic_bulb", false, false},
+    {"LCA006", "Hue color lamp", "1.108.7", "sultan_bulb", true, true},
+    {"LCG002", "Hue color spot", "1.116.3", "spot_bulb", true, true},
+    {"LTG002", "Hue ambiance spot", "1.101.5", "spot_bulb", false, true},
+};
+
+constexpr const char *kManufacturer = "Signify Netherlands B.V.";
+
+QJsonObject reference(const QString &id, const QString &type)
+{
+    return QJsonObject{{QStringLiteral("rid"), id}, {QStringLiteral("rtype"), type}};
+}
+
+QJsonObject product(const char *modelId, const char *productName, const char *firmware, const char *archetype)
+{
+    return QJsonObject{
+        {QStringLiteral("model_id"), QString::fromLatin1(modelId)},
+        {QStringLiteral("manufacturer_name"), QString::fromLatin1(kManufacturer)},
+        {QStringLiteral("product_name"), QString::fromLatin1(productName)},
+        {QStringLiteral("product_archetype"), QString::fromLatin1(archetype)},
+        {QStringLiteral("certified"), true},
+        {QStringLiteral("software_version"), QString::fromLatin1(firmware)},
+    };
+}
+
+QJsonObject gamutC()
+{
+    auto point = [](double x, double y) { return QJsonObject{{QStringLiteral("x"), x}, {QStringLiteral("y"), y}}; };
+    return QJsonObject{
+        {QStringLiteral("red"), point(0.6915, 0.3083)},
+        {QStringLiteral("green"), point(0.17, 0.7)},
+        {QStringLiteral("blue"), point(0.1532, 0.0475)},
+    };
+}
+
+} // namespace
+
+FixtureOptions buildingOptions(int devices, std::uint32_t seed)
+{
+    FixtureOptions options;
+    options.seed = seed;
+    options.motionSensors = devices / 10;
+    options.switches = devices / 20;
+    options.dials = devices / 20;
+    options.lights = devices - options.motionSensors - options.switches - options.dials;
+    options.rooms = std::max(1, devices / 10);
+    options.zones = devices / 25;
+    options.scenesPerRoom = 3;
+    return options;
+}
+
+BridgeFixture::BridgeFixture(const FixtureOptions &options)
+    : m_options(options)
+    , m_random(options.seed)
+{
+    m_options.productVariants =
+        std::clamp(m_options.productVariants, 1, static_cast<int>(std::size(kLightVariants)));
+
+    for (int i = 0; i < m_options.rooms; ++i) {
+        const QString id = nextId();
+        const QString groupedLight = nextId();
+        m_resources[QStringLiteral("room")][id] = QJsonObject{
+            {QStringLiteral("id"), id},
+            {QStringLiteral("type"), QStringLiteral("room")},
+            {QStringLiteral("metadata"),
+             QJsonObject{{QStringLiteral("name"), QStringLiteral("Room %1").arg(i + 1)},
+                         {QStringLiteral("archetype"), QStringLiteral("living_room")}}},
+            {QStringLiteral("children"), QJsonArray{}},
+            {QStringLiteral("services"), QJsonArray{reference(groupedLight, QStringLiteral("grouped_light"))}},
+        };
+        m_rooms.push_back(id);
+    }
+    for (int i = 0; i < m_options.zones; ++i) {
+        const QString id = nextId();
+        const QString groupedLight = nextId();
+        m_resources[QStringLiteral("zone")][id] = QJsonObject{
+            {QStringLiteral("id"), id},
+            {QStringLiteral("type"), QStringLiteral("zone")},
+            {QStringLiteral("metadata"),
+             QJsonObject{{QStringLiteral("name"), QStringLiteral("Zone %1").arg(i + 1)},
+                         {QStringLiteral("archetype"), QStringLiteral("home")}}},
+            {QStringLiteral("children"), QJsonArray{}},
+            {QStringLiteral("services"), QJsonArray{reference(groupedLight, QStringLiteral("grouped_light"))}},
+        };
+        m_zones.push_back(id);
+    }
+
+    for (int i = 0; i < m_options.lights; ++i)
+        addLight();
+    for (int i = 0; i < m_options.motionSensors; ++i)
+        addMotionSensor();
+    for (int i = 0; i < m_options.switches; ++i)
+        addSwitch();
+    for (int i = 0; i < m_options.dials; ++i)
+        addDial();
+
+    for (const QString &roomId : m_rooms) {
+        for (int i = 0; i < m_options.scenesPerRoom; ++i)
+            addScene(roomId, i);
+    }
+}
+
+QJsonArray BridgeFixture::resources(const QString &type) const
+{
+    QJsonArray items;
+    const auto it = m_resources.constFind(type);
+    if (it == m_resources.cend())
+        return items;
+    for (const auto &[id, resource] : it.value())
+        items.append(resource);
+    return items;
+}
+
+QJsonObject BridgeFixture::resource(const QString &type, const QString &id) const
+{
+    const auto it = m_resources.constFind(type);
+    if (it == m_resources.cend())
+        return {};
+    const auto found = it->find(id);
+    return found != it->end() ? found->second : QJsonObject{};
+}
+
+QStringList BridgeFixture::ids(const QString &type) const
+{
+    QStringList result;
+    const auto it = m_resources.constFind(type);
+    if (it == m_resources.cend())
+        return result;
+    for (const auto &[id, resource] : it.value())
+        result.push_back(id);
+    return result;
+}
+
+Snapshot BridgeFixture::snapshot(const SyncFilter &filter) const
+{
+    return buildSnapshot(resources(QStringLiteral("device")),
+                         resources(QStringLiteral("light")),
+                         resources(QStringLiteral("motion")),
+                         resources(QStringLiteral("tamper")),
+                         resources(QStringLiteral("temperature")),
+                         resources(QStringLiteral("light_level")),
+                         resources(QStringLiteral("device_power")),
+                         resources(QStringLiteral("button")),
+                         resources(QStringLiteral("relative_rotary")),
+                         resources(QStringLiteral("zigbee_connectivity")),
+                         resources(QStringLiteral("room")),
+                         resources(QStringLiteral("zone")),
+                         resources(QStringLiteral("scene")),
+                         filter);
+}
+
+QString BridgeFixture::addLight()
+{
+    const int index = m_lightCount++;
+    const ProductVariant &variant = kLightVariants[index % m_options.productVariants];
+    const QString lightId = nextId();
+    const QString connectivityId = nextId();
+    const QString deviceId = addDevice(QStringLiteral("Light %1").arg(index + 1),
+                                       product(variant.modelId, variant.productName, variant.firmware, variant.archetype),
+                                       QJsonArray{reference(lightId, QStringLiteral("light")),
+                                                  reference(connectivityId, QStringLiteral("zigbee_connectivity"))});
+
+    std::uniform_real_distribution<double> brightness(1.0, 100.0);
+    QJsonObject light = ownedBy(QStringLiteral("light"), lightId, deviceId);
+    light.insert(QStringLiteral("metadata"),
+                 QJsonObject{{QStringLiteral("name"), QStringLiteral("Light %1").arg(index + 1)},
+                             {QStringLiteral("archetype"), QString::fromLatin1(variant.archetype)}});
+    light.insert(QStringLiteral("on"), QJsonObject{{QStringLiteral("on"), (m_random() & 1U) != 0}});
+    light.insert(QStringLiteral("dimming"),
+                 QJsonObject{{QStringLiteral("brightness"), brightness(m_random)},
+                             {QStringLiteral("min_dim_level"), 0.2}});
+    QJsonArray effects{QStringLiteral("no_effect")};
+    if (variant.ambiance) {
+        light.insert(QStringLiteral("color_temperature"),
+                     QJsonObject{{QStringLiteral("mirek"), 153 + static_cast<int>(m_random() % 348U)},
+                                 {QStringLiteral("mirek_valid"), true},
+                                 {QStringLiteral("mirek_schema"),
+                                  QJsonObject{{QStringLiteral("mirek_minimum"), 153},
+                                              {QStringLiteral("mirek_maximum"), 500}}}});
+        effects.append(QStringLiteral("candle"));
+        effects.append(QStringLiteral("fire"));
+    }
+    if (variant.color) {
+        light.insert(QStringLiteral("color"),
+                     QJsonObject{{QStringLiteral("xy"), QJsonObject{{QStringLiteral("x"), 0.4573}, {QStringLiteral("y"), 0.41}}},
+                                 {QStringLiteral("gamut"), gamutC()},
+                                 {QStringLiteral("gamut_type"), QStringLiteral("C")}});
+        for (const char *effect : {"prism", "sparkle", "opal", "glisten"})
+            effects.append(QString::fromLatin1(effect));
+    }
+    if (effects.size() > 1) {
+        light.insert(QStringLiteral("effects"),
+                     QJsonObject{{QStringLiteral("effect_values"), effects},
+                                 {QStringLiteral("status"), QStringLiteral("no_effect")},
+                                 {QStringLiteral("status_values"), effects}});
+    }
+    m_resources[QStringLiteral("light")][lightId] = light;
+
+    QJsonObject connectivity = ownedBy(QStringLiteral("zigbee_connectivity"), connectivityId, deviceId);
+    connectivity.insert(QStringLiteral("status"), QStringLiteral("connected"));
+    m_resources[QStringLiteral("zigbee_connectivity")][connectivityId] = connectivity;
+
+    if (!m_rooms.isEmpty()) {
+        QJsonObject &room = m_resources[QStringLiteral("room")][m_rooms.at(index % m_rooms.size())];
+        QJsonArray children = room.value(QStringLiteral("children")).toArray();
+        children.append(reference(deviceId, QStringLiteral("device")));
+        room.insert(QStringLiteral("children"), children);
+    }
+    if (!m_zones.isEmpty()) {
+        QJsonObject &zone = m_resources[QStringLiteral("zone")][m_zones.at(index % m_zones.size())];
+        QJsonArray children = zone.value(QStringLiteral("children")).toArray();
+        children.append(reference(lightId, QStringLiteral("light")));
+        zone.insert(QStringLiteral("children"), children);
+    }
+    return deviceId;
+}
+
+QString BridgeFixture::addMotionSensor()
+{
+    const QString motionId = nextId();
+    const QString temperatureId = nextId();
+    const QString lightLevelId = nextId();
+    const QString powerId = nextId();
+    const QString connectivityId = nextId();
+    const QString deviceId = addDevice(QStringLiteral("Motion %1").arg(m_resources[QStringLiteral("motion")].size() + 1),
+                                       product("SML001", "Hue motion sensor", "1.1.28573", "unknown_archetype"),
+                                       QJsonArray{reference(motionId, QStringLiteral("motion")),
+                                                  reference(temperatureId, QStringLiteral("temperature")),
+                                                  reference(lightLevelId, QStringLiteral("light_level")),
+                                                  reference(powerId, QStringLiteral("device_power")),
+                                                  reference(connectivityId, QStringLiteral("zigbee_connectivity"))});
+
+    QJsonObject motion = ownedBy(QStringLiteral("motion"), motionId, deviceId);
+    motion.insert(QStringLiteral("motion"),
+                  QJsonObject{{QStringLiteral("motion"), false}, {QStringLiteral("motion_valid"), true}});
+    motion.insert(QStringLiteral("sensitivity"),
+                  QJsonObject{{QStringLiteral("sensitivity"), 2}, {QStringLiteral("sensitivity_max"), 4}});
+    m_resources[QStringLiteral("motion")][motionId] = motion;
+
+    QJsonObject temperature = ownedBy(QStringLiteral("temperature"), temperatureId, deviceId);
+    temperature.insert(QStringLiteral("temperature"),
+                       QJsonObject{{QStringLiteral("temperature"), 20.0 + static_cast<double>(m_random() % 50U) / 10.0},
+                                   {QStringLiteral("temperature_valid"), true}});
+    m_resources[QStringLiteral("temperature")][temperatureId] = temperature;
+
+    QJsonObject lightLevel = ownedBy(QStringLiteral("light_level"), lightLevelId, deviceId);
+    lightLevel.insert(QStringLiteral("light"),
+                      QJsonObject{{QStringLiteral("light_level"), 10000 + static_cast<int>(m_random() % 20000U)},
+                                  {QStringLiteral("light_level_valid"), true}});
+    m_resources[QStringLiteral("light_level")][lightLevelId] = lightLevel;
+
+    QJsonObject power = ownedBy(QStringLiteral("device_power"), powerId, deviceId);
+    power.insert(QStringLiteral("power_state"),
+                 QJsonObject{{QStringLiteral("battery_state"), QStringLiteral("normal")},
+                             {QStringLiteral("battery_level"), 50 + static_cast<int>(m_random() % 50U)}});
+    m_resources[QStringLiteral("device_power")][powerId] = power;
+
+    QJsonObject connectivity = ownedBy(QStringLiteral("zigbee_connectivity"), connectivityId, deviceId);
+    connectivity.insert(QStringLiteral("status"), QStringLiteral("connected"));
+    m_resources[QStringLiteral("zigbee_connectivity")][connectivityId] = connectivity;
+    return deviceId;
+}
+
+QString BridgeFixture::addSwitch()
+{
+    const QString deviceId = nextId();
+    const QString powerId = nextId();
+    QJsonArray services = addButtons(deviceId, 4);
+    services.append(reference(powerId, QStringLiteral("device_power")));
+    m_resources[QStringLiteral("device")][deviceId] = QJsonObject{
+        {QStringLiteral("id"), deviceId},
+        {QStringLiteral("type"), QStringLiteral("device")},
+        {QStringLiteral("product_data"), product("RWL022", "Hue dimmer switch", "2.45.2_hF4400CA", "unknown_archetype")},
+        {QStringLiteral("metadata"),
+         QJsonObject{{QStringLiteral("name"), QStringLiteral("Switch %1").arg(++m_switchCount)},
+                     {QStringLiteral("archetype"), QStringLiteral("unknown_archetype")}}},
+        {QStringLiteral("services"), services},
+    };
+
+    QJsonObject power = ownedBy(QStringLiteral("device_power"), powerId, deviceId);
+    power.insert(QStringLiteral("power_state"),
+                 QJsonObject{{QStringLiteral("battery_state"), QStringLiteral("normal")},
+                             {QStringLiteral("battery_level"), 90}});
+    m_resources[QStringLiteral("device_power")][powerId] = power;
+    return deviceId;
+}
+
+QString BridgeFixture::addDial()
+{
+    const QString deviceId = nextId();
+    const QString rotaryId = nextId();
+    QJsonArray services = addButtons(deviceId, 4);
+    services.append(reference(rotaryId, QStringLiteral("relative_rotary")));
+    m_resources[QStringLiteral("device")][deviceId] = QJsonObject{
+        {QStringLiteral("id"), deviceId},
+        {QStringLiteral("type"), QStringLiteral("device")},
+        {QStringLiteral("product_data"), product("RDM002", "Hue tap dial switch", "2.59.25", "unknown_archetype")},
+        {QStringLiteral("metadata"),
+         QJsonObject{{QStringLiteral("name"), QStringLiteral("Dial %1").arg(m_resources[QStringLiteral("relative_rotary")].size() + 1)},
+                     {QStringLiteral("archetype"), QStringLiteral("unknown_archetype")}}},
+        {QStringLiteral("services"), services},
+    };
+
+    m_resources[QStringLiteral("relative_rotary")][rotaryId] =
+        ownedBy(QStringLiteral("relative_rotary"), rotaryId, deviceId);
+    return deviceId;
+}
+
+QJsonArray BridgeFixture::removeDevice(const QString &deviceId)
+{
+    QJsonArray removed;
+    const QJsonObject device = resource(QStringLiteral("device"), deviceId);
+    if (device.isEmpty())
+        return removed;
+
+    QSet<QString> removedIds{deviceId};
+    for (const QJsonValue &service : device.value(QStringLiteral("services")).toArray()) {
+        const QJsonObject serviceObj = service.toObject();
+        const QString id = serviceObj.value(QStringLiteral("rid")).toString();
+        if (m_resources[serviceObj.value(QStringLiteral("rtype")).toString()].erase(id) > 0) {
+            removedIds.insert(id);
+            removed.append(serviceObj);
+        }
+    }
+    m_resources[QStringLiteral("device")].erase(deviceId);
+    removed.append(reference(deviceId, QStringLiteral("device")));
+
+    auto keep = [&removedIds](const QJsonArray &items, const QString &key) {
+        QJsonArray kept;
+        for (const QJsonValue &item : items) {
+            const QJsonObject ref = key.isEmpty() ? item.toObject() : item.toObject().value(key).toObject();
+            if (!removedIds.contains(ref.value(QStringLiteral("rid")).toString()))
+                kept.append(item);
+        }
+        return kept;
+    };
+    for (const char *groupType : {"room", "zone"}) {
+        for (auto &[id, group] : m_resources[QString::fromLatin1(groupType)])
+            group.insert(QStringLiteral("children"), keep(group.value(QStringLiteral("children")).toArray(), {}));
+    }
+    for (auto &[id, scene] : m_resources[QStringLiteral("scene")])
+        scene.insert(QStringLiteral("actions"), keep(scene.value(QStringLiteral("actions")).toArray(), QStringLiteral("target")));
+    return removed;
+}
+
+QJsonObject BridgeFixture::updateResource(const QString &type, const QString &id, const QJsonObject &patch)
+{
+    auto typeIt = m_resources.find(type);
+    if (typeIt == m_resources.end())
+        return {};
+    const auto found = typeIt->find(id);
+    if (found == typeIt->end())
+        return {};
+
+    QJsonObject &resource = found->second;
+    for (auto it = patch.constBegin(); it != patch.constEnd(); ++it) {
+        const QJsonValue current = resource.value(it.key());
+        if (!it.value().isObject() || !current.isObject()) {
+            resource.insert(it.key(), it.value());
+            continue;
+        }
+        QJsonObject merged = current.toObject();
+        const QJsonObject fields = it.value().toObject();
+        for (auto field = fields.constBegin(); field != fields.constEnd(); ++field)
+            merged.insert(field.key(), field.value());
+        resource.insert(it.key(), merged);
+    }
+    return resource;
+}
+
+QString BridgeFixture::nextId()
+{
+    return QString::asprintf("%08x-0000-4000-8000-%012x", m_options.seed, ++m_serial);
+}
+
+QString BridgeFixture::addDevice(const QString &name, const QJsonObject &product, const QJsonArray &services)
+{
+    const QString deviceId = nextId();
+    m_resources[QStringLiteral("device")][deviceId] = QJsonObject{
+        {QStringLiteral("id"), deviceId},
+        {QStringLiteral("type"), QStringLiteral("device")},
+        {QStringLiteral("product_data"), product},
+        {QStringLiteral("metadata"),
+         QJsonObject{{QStringLiteral("name"), name},
+                     {QStringLiteral("archetype"), product.value(QStringLiteral("product_archetype"))}}},
+        {QStringLiteral("services"), services},
+    };
+    return deviceId;
+}
+
+QJsonObject BridgeFixture::ownedBy(const QString &type, const QString &id, const QString &deviceId) const
+{
+    return QJsonObject{
+        {QStringLiteral("id"), id},
+        {QStringLiteral("type"), type},
+        {QStringLiteral("owner"), reference(deviceId, QStringLiteral("device"))},
+    };
+}
+
+QJsonArray BridgeFixture::addButtons(const QString &deviceId, int count)
+{
+    QJsonArray services;
+    for (int control = 1; control <= count; ++control) {
+        const QString buttonId = nextId();
+        QJsonObject button = ownedBy(QStringLiteral("button"), buttonId, deviceId);
+        button.insert(QStringLiteral("metadata"), QJsonObject{{QStringLiteral("control_id"), control}});
+        m_resources[QStringLiteral("button")][buttonId] = button;
+        services.append(reference(buttonId, QStringLiteral("button")));
+    }
+    return services;
+}
+
+void BridgeFixture::addScene(const QString &roomId, int index)
+{
+    const QJsonObject room = resource(QStringLiteral("room"), roomId);
+    QJsonArray actions;
+    for (const QJsonValue &child : room.value(QStringLiteral("children")).toArray()) {
+        const QJsonObject device = resource(QStringLiteral("device"), child.toObject().value(QStringLiteral("rid")).toString());
+        for (const QJsonValue &service : device.value(QStringLiteral("services")).toArray()) {
+            const QJsonObject serviceObj = service.toObject();
+            if (serviceObj.value(QStringLiteral("rtype")).toString() != QLatin1String("light"))
+                continue;
+            actions.append(QJsonObject{
+                {QStringLiteral("target"), serviceObj},
+                {QStringLiteral("action"),
+                 QJsonObject{{QStringLiteral("on"), QJsonObject{{QStringLiteral("on"), index % 3 != 2}}},
+                             {QStringLiteral("dimming"),
+                              QJsonObject{{QStringLiteral("brightness"), 20.0 + 30.0 * (index % 3)}}}}},
+            });
+        }
+    }
+
+    const QString id = nextId();
+    m_resources[QStringLiteral("scene")][id] = QJsonObject{
+        {QStringLiteral("id"), id},
+        {QStringLiteral("type"), QStringLiteral("scene")},
+        {QStringLiteral("metadata"), QJsonObject{{QStringLiteral("name"), QStringLiteral("Scene %1").arg(index + 1)}}},
+        {QStringLiteral("group"), reference(roomId, QStringLiteral("room"))},
+        {QStringLiteral("actions"), actions},
+    };
+}
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "hue_model.h"
+
+namespace phicore::hue::ipc::testing {
+
+struct FixtureOptions {
+    int lights = 0;
+    // Distinct model/firmware combinations the lights are spread over.
+    int productVariants = 4;
+    int motionSensors = 0;
+    int switches = 0;
+    int dials = 0;
+    int rooms = 0;
+    int zones = 0;
+    int scenesPerRoom = 0;
+    std::uint32_t seed = 1;
+};
+
+// Mostly lights, with the sensors, switches, rooms and scenes a building of
+// that many devices has.
+FixtureOptions buildingOptions(int devices, std::uint32_t seed = 1);
+
+// Deterministic CLIP v2 resource set shaped like the responses of a real
+// bridge. Lights are spread round-robin over rooms and zones.
+class BridgeFixture
+{
+public:
+    explicit BridgeFixture(const FixtureOptions &options);
+
+    QJsonArray resources(const QString &type) const;
+    QJsonObject resource(const QString &type, const QString &id) const;
+    QStringList ids(const QString &type) const;
+    std::size_t deviceCount() const { return ids(QStringLiteral("device")).size(); }
+
+    // Parsed the same way a poll does.
+    Snapshot snapshot(const SyncFilter &filter = {}) const;
+
+    QString addLight();
+    QString addMotionSensor();
+    QString addSwitch();
+    QString addDial();
+    // Drops the device and the services it owns from every room, zone and
+    // scene. Returns references to all removed resources.
+    QJsonArray removeDevice(const QString &deviceId);
+    // Applies a PUT body: objects are merged one level deep, everything
+    // else is replaced. Returns the updated resource, or {} if unknown.
+    QJsonObject updateResource(const QString &type, const QString &id, const QJsonObject &patch);
+
+private:
+    QString nextId();
+    QString addDevice(const QString &name, const QJsonObject &product, const QJsonArray &services);
+    QJsonObject ownedBy(const QString &type, const QString &id, const QString &deviceId) const;
+    QJsonArray addButtons(const QString &deviceId, int count);
+    void addScene(const QString &roomId, int index);
+
+    FixtureOptions m_options;
+    std::mt19937 m_random;
+    std::uint32_t m_serial = 0;
+    int m_lightCount = 0;
+    int m_switchCount = 0;
+    // Type -> id -> resource, ordered for stable output.
+    QHash<QString, std::map<QString, QJsonObject>> m_resources;
+    QStringList m_rooms;
+    QStringList m_zones;
+};
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,126 @@
+#include "instance_driver.h"
+
+#include <QJsonDocument>
+
+namespace phicore::hue::ipc::testing {
+
+namespace {
+namespace phi = phicore::adapter::sdk;
+}
+
+InstanceDriver::InstanceDriver()
+    : m_instance(std::make_unique<HueAdapterInstance>())
+{
+    m_instance->m_hostless = true;
+}
+
+InstanceDriver::~InstanceDriver()
+{
+    m_instance->stop();
+}
+
+bool InstanceDriver::start()
+{
+    return m_instance->start();
+}
+
+void InstanceDriver::configure(const QJsonObject &meta)
+{
+    phi::ConfigChangedRequest request;
+    request.adapter.metaJson = QJsonDocument(meta).toJson(QJsonDocument::Compact).toStdString();
+    m_instance->onConfigChanged(request);
+}
+
+void InstanceDriver::reconnectHost(const QJsonObject &meta)
+{
+    m_instance->onDisconnected();
+    m_instance->onConnected();
+    configure(meta);
+}
+
+void InstanceDriver::setChannel(const QString &deviceExternalId, const std::string &channelExternalId, double value)
+{
+    phi::ChannelInvokeRequest request;
+    request.cmdId = m_nextCmdId++;
+    request.deviceExternalId = deviceExternalId.toStdString();
+    request.channelExternalId = channelExternalId;
+    request.value = value;
+    request.hasScalarValue = true;
+    m_instance->onChannelInvoke(request);
+}
+
+void InstanceDriver::setOn(const QString &deviceExternalId, bool on)
+{
+    phi::ChannelInvokeRequest request;
+    request.cmdId = m_nextCmdId++;
+    request.deviceExternalId = deviceExternalId.toStdString();
+    request.channelExternalId = "on";
+    request.value = on;
+    request.hasScalarValue = true;
+    m_instance->onChannelInvoke(request);
+}
+
+void InstanceDriver::rename(const QString &deviceExternalId, const QString &name)
+{
+    phi::DeviceNameUpdateRequest request;
+    request.cmdId = m_nextCmdId++;
+    request.deviceExternalId = deviceExternalId.toStdString();
+    request.name = name.toStdString();
+    m_instance->onDeviceNameUpdate(request);
+}
+
+void InstanceDriver::invokeEffect(const QString &deviceExternalId, const std::string &effectId)
+{
+    phi::DeviceEffectInvokeRequest request;
+    request.cmdId = m_nextCmdId++;
+    request.deviceExternalId = deviceExternalId.toStdString();
+    request.effectId = effectId;
+    m_instance->onDeviceEffectInvoke(request);
+}
+
+void InstanceDriver::invokeScene(const QString &sceneExternalId)
+{
+    phi::SceneInvokeRequest request;
+    request.cmdId = m_nextCmdId++;
+    request.sceneExternalId = sceneExternalId.toStdString();
+    request.action = "activate";
+    m_instance->onSceneInvoke(request);
+}
+
+void InstanceDriver::invokeAction(const std::string &actionId, const std::string &paramsJson)
+{
+    phi::AdapterActionInvokeRequest request;
+    request.cmdId = m_nextCmdId++;
+    request.actionId = actionId;
+    request.paramsJson = paramsJson;
+    m_instance->onAdapterActionInvoke(request);
+}
+
+std::size_t InstanceDriver::deviceCount() const
+{
+    return static_cast<std::size_t>(m_instance->m_devices.size());
+}
+
+bool InstanceDriver::connected() const
+{
+    return m_instance->m_connected;
+}
+
+QJsonObject InstanceDriver::memoryFootprint() const
+{
+    return m_instance->memoryFootprint();
+}
+
+std::uint64_t InstanceDriver::droppedMessages() const
+{
+    return m_instance->m_hostlessMessages;
+}
+
+LatencyHistogram InstanceDriver::takeEventLatency()
+{
+    LatencyHistogram latency = m_instance->m_eventLatencyUs;
+    m_instance->m_eventLatencyUs.clear();
+    return latency;
+}
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <QJsonObject>
+#include <QString>
+
+#include "hue_latency.h"
+#include "hue_sidecar.h"
+
+namespace phicore::hue::ipc::testing {
+
+// Runs a HueAdapterInstance without a host: requests go straight to the
+// instance's handlers and outbound messages are dropped. Needs the hooks of
+// phi_adapter_hue_core_testing (PHI_ADAPTER_HUE_TESTING). Everything else,
+// including the bridge session and its timers, runs as in the sidecar.
+class InstanceDriver
+{
+public:
+    InstanceDriver();
+    ~InstanceDriver();
+
+    bool start();
+    void configure(const QJsonObject &meta);
+    // Host link lost and re-established; the host re-sends the config.
+    void reconnectHost(const QJsonObject &meta);
+
+    void setChannel(const QString &deviceExternalId, const std::string &channelExternalId, double value);
+    void setOn(const QString &deviceExternalId, bool on);
+    void rename(const QString &deviceExternalId, const QString &name);
+    void invokeEffect(const QString &deviceExternalId, const std::string &effectId);
+    void invokeScene(const QString &sceneExternalId);
+    void invokeAction(const std::string &actionId, const std::string &paramsJson = {});
+
+    std::size_t deviceCount() const;
+    bool connected() const;
+    QJsonObject memoryFootprint() const;
+    std::uint64_t droppedMessages() const;
+    // Per-batch event processing time since the last call, in microseconds.
+    LatencyHistogram takeEventLatency();
+
+private:
+    std::unique_ptr<HueAdapterInstance> m_instance;
+    std::uint64_t m_nextCmdId = 1;
+};
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,142 @@
+#include "memory_probe.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+
+#include <malloc.h>
+#include <unistd.h>
+
+// glibc exports its allocator under these names as well; the definitions
+// below take precedence over libc's malloc for the whole process.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void *ptr);
+}
+
+namespace phicore::hue::ipc::testing {
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{0};
+std::atomic<std::uint64_t> g_frees{0};
+std::atomic<std::uint64_t> g_allocatedBytes{0};
+std::atomic<std::int64_t> g_liveBytes{0};
+
+void *noteAllocated(void *ptr)
+{
+    if (!ptr)
+        return ptr;
+    const std::size_t usable = malloc_usable_size(ptr);
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(usable, std::memory_order_relaxed);
+    g_liveBytes.fetch_add(static_cast<std::int64_t>(usable), std::memory_order_relaxed);
+    return ptr;
+}
+
+void noteFreed(void *ptr)
+{
+    if (!ptr)
+        return;
+    g_frees.fetch_add(1, std::memory_order_relaxed);
+    g_liveBytes.fetch_sub(static_cast<std::int64_t>(malloc_usable_size(ptr)), std::memory_order_relaxed);
+}
+
+} // namespace
+
+HeapCounters heapCounters()
+{
+    HeapCounters counters;
+    counters.allocations = g_allocations.load(std::memory_order_relaxed);
+    counters.frees = g_frees.load(std::memory_order_relaxed);
+    counters.allocatedBytes = g_allocatedBytes.load(std::memory_order_relaxed);
+    counters.liveBytes = g_liveBytes.load(std::memory_order_relaxed);
+    return counters;
+}
+
+HeapCounters heapDelta(const HeapCounters &before, const HeapCounters &after)
+{
+    HeapCounters delta;
+    delta.allocations = after.allocations - before.allocations;
+    delta.frees = after.frees - before.frees;
+    delta.allocatedBytes = after.allocatedBytes - before.allocatedBytes;
+    delta.liveBytes = after.liveBytes - before.liveBytes;
+    return delta;
+}
+
+std::size_t residentBytes()
+{
+    std::FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    const int read = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    if (read != 2)
+        return 0;
+    return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void releaseFreeMemory()
+{
+    malloc_trim(0);
+}
+
+} // namespace phicore::hue::ipc::testing
+
+namespace probe = phicore::hue::ipc::testing;
+
+extern "C" {
+
+void *malloc(std::size_t size) noexcept
+{
+    return probe::noteAllocated(__libc_malloc(size));
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    return probe::noteAllocated(__libc_calloc(count, size));
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept
+{
+    probe::noteFreed(ptr);
+    void *moved = __libc_realloc(ptr, size);
+    if (!moved && ptr && size != 0) {
+        // The old block is still valid.
+        probe::noteAllocated(ptr);
+        return moved;
+    }
+    return probe::noteAllocated(moved);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) noexcept
+{
+    return probe::noteAllocated(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+    return probe::noteAllocated(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void **out, std::size_t alignment, std::size_t size) noexcept
+{
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr)
+        return ENOMEM;
+    *out = probe::noteAllocated(ptr);
+    return 0;
+}
+
+void free(void *ptr) noexcept
+{
+    probe::noteFreed(ptr);
+    __libc_free(ptr);
+}
+
+} // extern "C"
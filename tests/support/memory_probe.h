@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace phicore::hue::ipc::testing {
+
+// Process-wide counters of the interposed malloc family, so Qt's own
+// allocations are included along with operator new. Sizes are the usable
+// sizes reported by glibc, i.e. what the heap actually holds.
+struct HeapCounters {
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t allocatedBytes = 0;
+    std::int64_t liveBytes = 0;
+};
+
+HeapCounters heapCounters();
+
+// Difference of two readings, for measuring one phase of a benchmark.
+HeapCounters heapDelta(const HeapCounters &before, const HeapCounters &after);
+
+// Resident set size of the process, from /proc/self/statm.
+std::size_t residentBytes();
+
+// Returns free heap pages to the system so that RSS readings reflect
+// what is still allocated.
+void releaseFreeMemory();
+
+} // namespace phicore::hue::ipc::testing
@@ -0,0 +1,304 @@
+#include "mock_bridge.h"
+
+#include <QDateTime>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QList>
+#include <QTcpSocket>
+
+#include "hue_clock.h"
+
+namespace phicore::hue::ipc::testing {
+
+namespace {
+
+constexpr char kResourcePrefix[] = "/clip/v2/resource/";
+constexpr char kEventStreamPath[] = "/eventstream/clip/v2";
+
+QByteArray statusLine(int status)
+{
+    switch (status) {
+    case 200:
+        return QByteArrayLiteral("HTTP/1.1 200 OK\r\n");
+    case 403:
+        return QByteArrayLiteral("HTTP/1.1 403 Forbidden\r\n");
+    case 404:
+        return QByteArrayLiteral("HTTP/1.1 404 Not Found\r\n");
+    case 405:
+        return QByteArrayLiteral("HTTP/1.1 405 Method Not Allowed\r\n");
+    default:
+        return QByteArrayLiteral("HTTP/1.1 400 Bad Request\r\n");
+    }
+}
+
+QJsonObject errorBody(const QString &description)
+{
+    return QJsonObject{
+        {QStringLiteral("data"), QJsonArray{}},
+        {QStringLiteral("errors"), QJsonArray{QJsonObject{{QStringLiteral("description"), description}}}},
+    };
+}
+
+QJsonObject dataBody(const QJsonArray &data)
+{
+    return QJsonObject{{QStringLiteral("data"), data}, {QStringLiteral("errors"), QJsonArray{}}};
+}
+
+QString isoNow()
+{
+    return QDateTime::fromMSecsSinceEpoch(wallClockMs(), Qt::UTC).toString(Qt::ISODateWithMs);
+}
+
+} // namespace
+
+MockBridge::MockBridge(BridgeFixture &fixture, const QString &appKey)
+    : m_fixture(fixture)
+    , m_appKey(appKey)
+{
+    QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this]() { accept(); });
+}
+
+MockBridge::~MockBridge()
+{
+    dropConnections();
+    m_server.close();
+}
+
+bool MockBridge::listen(QString *error)
+{
+    if (m_server.listen(QHostAddress::LocalHost, 0))
+        return true;
+    if (error)
+        *error = m_server.errorString();
+    return false;
+}
+
+ConnectionSettings MockBridge::settings() const
+{
+    ConnectionSettings settings;
+    settings.ip = QStringLiteral("127.0.0.1");
+    settings.port = m_server.serverPort();
+    settings.useTls = false;
+    settings.appKey = m_appKey;
+    return settings;
+}
+
+QJsonObject MockBridge::meta() const
+{
+    return QJsonObject{
+        {QStringLiteral("ip"), QStringLiteral("127.0.0.1")},
+        {QStringLiteral("port"), static_cast<int>(m_server.serverPort())},
+        {QStringLiteral("useTls"), false},
+        {QStringLiteral("appKey"), m_appKey},
+    };
+}
+
+QJsonObject MockBridge::event(const QString &type, const QJsonArray &data)
+{
+    return QJsonObject{
+        {QStringLiteral("creationtime"), isoNow()},
+        {QStringLiteral("data"), data},
+        {QStringLiteral("id"), QString::asprintf("ffffffff-0000-4000-8000-%012llx",
+                                                 static_cast<unsigned long long>(++m_eventSerial))},
+        {QStringLiteral("type"), type},
+    };
+}
+
+void MockBridge::emitEvents(const QJsonArray &events)
+{
+    if (events.isEmpty())
+        return;
+    const QByteArray message = QByteArrayLiteral("id: ") + QByteArray::number(wallClockMs() / 1000)
+        + QByteArrayLiteral(":0\ndata: ") + QJsonDocument(events).toJson(QJsonDocument::Compact)
+        + QByteArrayLiteral("\n\n");
+    for (auto it = m_connections.cbegin(); it != m_connections.cend(); ++it) {
+        if (!it->eventStream)
+            continue;
+        it.key()->write(message);
+        m_stats.eventsSent += static_cast<std::uint64_t>(events.size());
+    }
+}
+
+void MockBridge::dropConnections()
+{
+    const QList<QTcpSocket *> sockets = m_connections.keys();
+    m_connections.clear();
+    for (QTcpSocket *socket : sockets) {
+        socket->disconnect();
+        socket->abort();
+        socket->deleteLater();
+    }
+    if (!sockets.isEmpty())
+        ++m_stats.drops;
+}
+
+void MockBridge::accept()
+{
+    while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+        m_connections.insert(socket, Connection{});
+        QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { read(socket); });
+        QObject::connect(socket, &QTcpSocket::disconnected, socket, [this, socket]() {
+            m_connections.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockBridge::read(QTcpSocket *socket)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+    it->buffer.append(socket->readAll());
+
+    // Requests may be pipelined; an eventstream takes over the connection.
+    while (!it->eventStream) {
+        const qsizetype headerEnd = it->buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0)
+            return;
+
+        const QList<QByteArray> lines = it->buffer.left(headerEnd).split('\n');
+        const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+        QHash<QByteArray, QByteArray> headers;
+        for (qsizetype i = 1; i < lines.size(); ++i) {
+            const qsizetype colon = lines.at(i).indexOf(':');
+            if (colon > 0)
+                headers.insert(lines.at(i).left(colon).trimmed().toLower(), lines.at(i).mid(colon + 1).trimmed());
+        }
+        const qsizetype bodyBytes = headers.value(QByteArrayLiteral("content-length")).toLongLong();
+        if (it->buffer.size() < headerEnd + 4 + bodyBytes)
+            return;
+
+        const QByteArray body = it->buffer.mid(headerEnd + 4, bodyBytes);
+        it->buffer.remove(0, headerEnd + 4 + bodyBytes);
+        const QString target = QString::fromLatin1(requestLine.value(1));
+        handle(socket, requestLine.value(0), target.section(QLatin1Char('?'), 0, 0), headers, body);
+
+        // handle() may have dropped the connection.
+        it = m_connections.find(socket);
+        if (it == m_connections.end())
+            return;
+    }
+}
+
+void MockBridge::handle(QTcpSocket *socket,
+                        const QByteArray &method,
+                        const QString &path,
+                        const QHash<QByteArray, QByteArray> &headers,
+                        const QByteArray &body)
+{
+    ++m_stats.requests;
+    if (QString::fromUtf8(headers.value(QByteArrayLiteral("hue-application-key"))) != m_appKey) {
+        ++m_stats.rejected;
+        respond(socket, 403, errorBody(QStringLiteral("unauthorized user")));
+        return;
+    }
+
+    if (path == QLatin1String(kEventStreamPath) && method == "GET") {
+        openEventStream(socket);
+        return;
+    }
+    if (!path.startsWith(QLatin1String(kResourcePrefix))) {
+        respond(socket, 404, errorBody(QStringLiteral("resource not found")));
+        return;
+    }
+
+    const QStringList parts = path.mid(static_cast<qsizetype>(sizeof(kResourcePrefix) - 1)).split(QLatin1Char('/'));
+    const QString type = parts.value(0);
+    const QString id = parts.value(1);
+    if (method == "GET" && id.isEmpty()) {
+        respond(socket, 200, dataBody(m_fixture.resources(type)));
+    } else if (method == "GET") {
+        const QJsonObject resource = m_fixture.resource(type, id);
+        if (resource.isEmpty())
+            respond(socket, 404, errorBody(QStringLiteral("Not Found")));
+        else
+            respond(socket, 200, dataBody(QJsonArray{resource}));
+    } else if (method == "PUT" && !id.isEmpty()) {
+        handlePut(socket, type, id, body);
+    } else {
+        respond(socket, 405, errorBody(QStringLiteral("method not available for resource")));
+    }
+}
+
+void MockBridge::handlePut(QTcpSocket *socket, const QString &type, const QString &id, const QByteArray &body)
+{
+    ++m_stats.puts;
+    const QJsonDocument doc = QJsonDocument::fromJson(body);
+    if (!doc.isObject()) {
+        respond(socket, 400, errorBody(QStringLiteral("body contains invalid JSON")));
+        return;
+    }
+    QJsonObject patch = doc.object();
+
+    // A recall changes the scene's lights, not the scene record.
+    QJsonArray changed;
+    if (type == QLatin1String("scene")) {
+        const QJsonObject scene = m_fixture.resource(type, id);
+        const bool activate = patch.value(QStringLiteral("recall")).toObject().value(QStringLiteral("action"))
+                                  .toString() != QLatin1String("inactive");
+        if (activate) {
+            for (const QJsonValue &action : scene.value(QStringLiteral("actions")).toArray()) {
+                const QJsonObject actionObj = action.toObject();
+                const QString lightId = actionObj.value(QStringLiteral("target")).toObject()
+                                            .value(QStringLiteral("rid")).toString();
+                const QJsonObject state = actionObj.value(QStringLiteral("action")).toObject();
+                const QJsonObject light = m_fixture.updateResource(QStringLiteral("light"), lightId, state);
+                if (light.isEmpty())
+                    continue;
+                QJsonObject data = state;
+                data.insert(QStringLiteral("id"), lightId);
+                data.insert(QStringLiteral("owner"), light.value(QStringLiteral("owner")));
+                data.insert(QStringLiteral("type"), QStringLiteral("light"));
+                changed.append(data);
+            }
+        }
+        patch.remove(QStringLiteral("recall"));
+    }
+
+    const QJsonObject resource = m_fixture.updateResource(type, id, patch);
+    if (resource.isEmpty()) {
+        respond(socket, 404, errorBody(QStringLiteral("Not Found")));
+        return;
+    }
+    respond(socket, 200, dataBody(QJsonArray{QJsonObject{{QStringLiteral("rid"), id}, {QStringLiteral("rtype"), type}}}));
+
+    if (!patch.isEmpty()) {
+        patch.insert(QStringLiteral("id"), id);
+        patch.insert(QStringLiteral("type"), type);
+        if (resource.contains(QStringLiteral("owner")))
+            patch.insert(QStringLiteral("owner"), resource.value(QStringLiteral("owner")));
+        changed.append(patch);
+    }
+    if (!changed.isEmpty())
+        emitEvents(QJsonArray{event(QStringLiteral("update"), changed)});
+}
+
+void MockBridge::respond(QTcpSocket *socket, int status, const QJsonObject &body)
+{
+    const QByteArray payload = QJsonDocument(body).toJson(QJsonDocument::Compact);
+    QByteArray response = statusLine(status);
+    response += QByteArrayLiteral("Content-Type: application/json\r\nContent-Length: ");
+    response += QByteArray::number(payload.size());
+    response += QByteArrayLiteral("\r\nConnection: keep-alive\r\n\r\n");
+    response += payload;
+    socket->write(response);
+}
+
+void MockBridge::openEventStream(QTcpSocket *socket)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+    it->eventStream = true;
+    it->buffer.clear();
+    ++m_stats.eventStreams;
+    // No length: the stream runs until one side closes the connection.
+    socket->write(QByteArrayLiteral("HTTP/1.1 200 OK\r\n"
+                                    "Content-Type: text/event-stream\r\n"
+                                    "Cache-Control: no-cache\r\n"
+                                    "Connection: close\r\n\r\n"
+                                    ": hi\n\n"));
+}
+
+} // namespace phicore::hue::ipc::testing
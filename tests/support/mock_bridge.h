@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QTcpServer>
+
+#include "hue_fixture.h"
+#include "hue_http.h"
+
+class QTcpSocket;
+
+namespace phicore::hue::ipc::testing {
+
+struct MockBridgeStats {
+    std::uint64_t requests = 0;
+    std::uint64_t puts = 0;
+    std::uint64_t rejected = 0;
+    std::uint64_t eventStreams = 0;
+    std::uint64_t eventsSent = 0;
+    std::uint64_t drops = 0;
+};
+
+// Plain HTTP/1.1 stand-in for a bridge on 127.0.0.1, serving the CLIP v2
+// resources of a fixture and its eventstream. PUTs are applied to the
+// fixture and echoed as update events, like the bridge does. Runs on the
+// thread that created it; the adapter's nested event loops serve it too.
+class MockBridge
+{
+public:
+    explicit MockBridge(BridgeFixture &fixture, const QString &appKey = QStringLiteral("mock-bridge-key"));
+    ~MockBridge();
+
+    bool listen(QString *error = nullptr);
+    // Connection settings for the adapter's meta config.
+    ConnectionSettings settings() const;
+    QJsonObject meta() const;
+
+    // Event object ("add", "update" or "delete") as the bridge streams it.
+    QJsonObject event(const QString &type, const QJsonArray &data);
+    // One eventstream message with these events to every open stream.
+    void emitEvents(const QJsonArray &events);
+    // Closes every client connection, as a bridge reboot or a Wi-Fi drop does.
+    void dropConnections();
+
+    const MockBridgeStats &stats() const { return m_stats; }
+    std::size_t openConnections() const { return static_cast<std::size_t>(m_connections.size()); }
+
+private:
+    struct Connection {
+        QByteArray buffer;
+        bool eventStream = false;
+    };
+
+    void accept();
+    void read(QTcpSocket *socket);
+    void handle(QTcpSocket *socket,
+                const QByteArray &method,
+                const QString &path,
+                const QHash<QByteArray, QByteArray> &headers,
+                const QByteArray &body);
+    void handlePut(QTcpSocket *socket, const QString &type, const QString &id, const QByteArray &body);
+    void respond(QTcpSocket *socket, int status, const QJsonObject &body);
+    void openEventStream(QTcpSocket *socket);
+
+    BridgeFixture &m_fixture;
+    QString m_appKey;
+    QTcpServer m_server;
+    QHash<QTcpSocket *, Connection> m_connections;
+    MockBridgeStats m_stats;
+    std::uint64_t m_eventSerial = 0;
+};
+
+} // namespace phicore::hue::ipc::testing